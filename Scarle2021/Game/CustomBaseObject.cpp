@@ -182,10 +182,6 @@ bool CustomBaseObject::checkAndPlace(const bool place)
     //intersecting other blocks
     materialize();
 
-    //Creates an AABB object
-    q3AABB AABB_object;
-    //Creates a new collision report object to work with the query function
-    auto* collision_report = new CollisionReport;
     //Creates a vector to check the surroundings
     const q3Vec3 dummy_extents_x =
         {object_extents.x + extents_offset, object_extents.y, object_extents.z};
@@ -194,20 +190,30 @@ bool CustomBaseObject::checkAndPlace(const bool place)
     const q3Vec3 dummy_extents_z =
         {object_extents.x, object_extents.y, object_extents.z + extents_offset};
 
+    //AABB of the object itself followed by the three slightly extended probes
+    q3AABB AABB_objects[4];
+    block_self->ComputeAABB(composite_body->GetTransform(), &AABB_objects[0]);
+    computeProbeAABB(AABB_objects[1], dummy_extents_x);
+    computeProbeAABB(AABB_objects[2], dummy_extents_y);
+    computeProbeAABB(AABB_objects[3], dummy_extents_z);
+
+    //Queries the scene once for all four volumes. The object always finds itself,
+    //so counting stops at 2 as that's all that is needed to take a decision
+    int collision_counts[4];
+    physic_scene->CountAABBs(AABB_objects, 4, collision_counts, 2);
+
     //Saves result
     bool colliding = true;
-    
-    //check inside and outside collisions
-    if(checkInsideCollisions(AABB_object, collision_report))
+
+    //The object must not overlap anything but itself, and at least one of the probes
+    //must find another block to snap to
+    if(collision_counts[0] <= 1)
     {
-        if (checkOutsideCollisions(AABB_object, collision_report, dummy_extents_x) ||
-            checkOutsideCollisions(AABB_object, collision_report, dummy_extents_y) ||
-            checkOutsideCollisions(AABB_object, collision_report, dummy_extents_z))
+        if(collision_counts[1] > 1 || collision_counts[2] > 1 || collision_counts[3] > 1)
         {
             colliding = false;
         }
     }
-    delete collision_report;
 
     //Block is placed only if place value is true. this is to use this
     //function also for the only purpose to check collisions
@@ -231,62 +237,23 @@ bool CustomBaseObject::checkAndPlace(const bool place)
 // Collision Check -----------------------------------------------------------------------------------------------------
 
 /**
- * Checks for collisions with the current object in the physics world
- */
-bool CustomBaseObject::checkInsideCollisions(q3AABB& AABB_object, CollisionReport* collision_report) const
-{
-    //Find AABB of the object that needs to be placed
-    block_self->ComputeAABB(composite_body->GetTransform(), &AABB_object);
-    //Sets the colliding object count to 0
-    collision_report->i = 0;
-    //Searches the physic scene for collisions
-    physic_scene->QueryAABB(collision_report, AABB_object);
-
-    //The first collision is not taken into account as it is with itself
-    if(collision_report->i > 1)
-    {
-        //More than one?
-        return false;
-    }
-    return true;
-}
-
-/**
- * Checks collisions in a small area on each of the face of the block.
- * The main use for this is sorting out if a block is facing another one in order to be placed
+ * Computes the AABB of a box in the same position of the actual hit box of the object,
+ * but with slightly extended extents. Used to sort out if a block is facing another one
+ * in order to be placed
  */
-bool CustomBaseObject::checkOutsideCollisions(q3AABB& AABB_object, CollisionReport* collision_report,
-                                              const q3Vec3& dummy_extents) const
+void CustomBaseObject::computeProbeAABB(q3AABB& AABB_object, const q3Vec3& dummy_extents) const
 {
-    //Creates a dummy physic box
-    q3BoxDef dummy_hitbox;
-    q3Transform dummy_transform;
-    q3Identity(dummy_transform);
+    //Creates a dummy box, it is never added to the physic world
+    q3Box dummy_box;
+    q3Identity(dummy_box.local);
 
-    //Puts it in the same position of the actual hit box of the object 
-    dummy_transform.position = position_offset;
+    //Puts it in the same position of the actual hit box of the object
+    dummy_box.local.position = position_offset;
     //Extends the extents slightly
-    dummy_hitbox.Set(dummy_transform, dummy_extents);
-
-    //Adds the dummy box to the physic world
-    const q3Box* dummy_box = composite_body->AddBox(dummy_hitbox);
-    //and gets its AABB 
-    dummy_box->ComputeAABB(composite_body->GetTransform(), &AABB_object);
-
-    //resets collision report
-    collision_report->i = 0;
-    //Queries the scene for collision with this object
-    physic_scene->QueryAABB(collision_report, AABB_object);
-    //then deletes it
-    composite_body->RemoveBox(dummy_box);
-    dummy_box = nullptr;
-
-    //For each collision greater than 2 means that we have a object that can be snapped to nearby
-    if(collision_report->i <= 2)
-    {
-        return false;
-    }
-    return true;
+    dummy_box.e = dummy_extents * 0.5f;
+
+    //and gets its AABB
+    dummy_box.ComputeAABB(composite_body->GetTransform(), &AABB_object);
 }
 
 // Force handling ------------------------------------------------------------------------------------------------------
@@ -369,8 +336,8 @@ void CustomBaseObject::applyForces(const Vector3& force) const
     const Vector3 force_rot_DX = XMVector3Rotate(force, block_rot_DX);
     const auto force_rotated = q3Vec3(force_rot_DX.x, force_rot_DX.y, force_rot_DX.z);
         
-    //Gets the position of where the force should be applied
-    const auto force_pos = q3Vec3(m_pos.x, m_pos.y, m_pos.z);
+    //Gets the position of where the force should be applied, from the body as m_pos is interpolated
+    const auto force_pos = block_self->body->GetWorldPoint(position_offset);
 
     //Applies force
     block_self->body->ApplyLinearImpulseAtWorldPoint(force_rotated, force_pos);
@@ -408,13 +375,18 @@ void CustomBaseObject::Tick(GameData* _GD)
 {
     if(created)
     {
-        //Gets position and rotation from the physic scene
-        auto obj_pos = block_self->body->GetWorldPoint(position_offset);
-        const auto& obj_rot= block_self->body->GetQuaternion();
+        //Gets position and rotation from the physic scene, before and after the last physics step
+        const auto prev_pos = q3Mul(block_self->body->GetPreviousTransform(), position_offset);
+        const auto curr_pos = block_self->body->GetWorldPoint(position_offset);
+        const auto& prev_rot = block_self->body->GetPreviousQuaternion();
+        const auto& curr_rot = block_self->body->GetQuaternion();
         
-        //applies them accordingly
-        m_pos = Vector3(obj_pos.x, obj_pos.y, obj_pos.z);
-        m_rotQuat = Quaternion(obj_rot.x, obj_rot.y, obj_rot.z, obj_rot.w);
+        //Physics runs at a fixed step, so blends between the two by how far into the next step the frame is
+        const float alpha = physic_scene->GetInterpolationAlpha();
+        m_pos = Vector3::Lerp(Vector3(prev_pos.x, prev_pos.y, prev_pos.z),
+                              Vector3(curr_pos.x, curr_pos.y, curr_pos.z), alpha);
+        m_rotQuat = Quaternion::Slerp(Quaternion(prev_rot.x, prev_rot.y, prev_rot.z, prev_rot.w),
+                                      Quaternion(curr_rot.x, curr_rot.y, curr_rot.z, curr_rot.w), alpha);
     }
     CMOGO::Tick(_GD);
 }
@@ -42,9 +42,7 @@ public:
     
 protected:
     //Collisions Check
-    bool checkInsideCollisions(q3AABB& AABB_object, CollisionReport* collision_report) const;
-    bool checkOutsideCollisions(q3AABB& AABB_object, CollisionReport* collision_report,
-                                const q3Vec3& dummy_extents) const;
+    void computeProbeAABB(q3AABB& AABB_object, const q3Vec3& dummy_extents) const;
     
     //Force Handling
     void applyForces(const Vector3& force) const;
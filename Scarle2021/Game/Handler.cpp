@@ -18,9 +18,8 @@ LEGO::Handler::Handler(float _AR, GameData* _GD, DrawData* _DD, DrawData2D* _DD2
                        ID3D11DeviceContext1* _d3dContext, IEffectFactory* _fxFactory) : AR(_AR), GD(_GD), DD(_DD),
 					   DD2D(_DD2D), d3dDevice(_d3dDevice), d3dContext(_d3dContext), fxFactory(_fxFactory)
 {
-	//Sets the physic library to calculate steps with a 16.6667ms interval
-	//(as game is locked to 60fps, an accumulator is not needed)
-	physic_scene = new q3Scene(1.f / 60.f);
+	//Sets the physic library to calculate steps with a fixed interval, update() advances it by the real frame time
+	physic_scene = new q3Scene(physics_step);
 	physic_scene->SetAllowSleep(true);
 	physic_scene->SetEnableFriction(true);
 	//Unrealistic gravity but feels better
@@ -78,6 +77,9 @@ void LEGO::Handler::initialize(const Vector2& resolution)
 	const int mid_point_x = ((platform_x - 1) * platform_size_x) * 0.5f;
 	const int mid_point_y = ((platform_y - 1) * platform_size_y) * 0.5f;
 
+	//Defers mass and broadphase updates of the platforms body until all of them are added
+	platform->BeginShapeEdit();
+
 	//Places platforms in a grid, centers it to world origin
 	for (int i = 0; i < platform_x; ++i)
 	{
@@ -92,6 +94,8 @@ void LEGO::Handler::initialize(const Vector2& resolution)
 			scene_platforms.push_back(current_platform);
 		}
 	}
+	platform->EndShapeEdit();
+
 	//Ticks all the newly created platforms at least once
 	for (auto platform : scene_platforms)
 	{
@@ -112,16 +116,29 @@ void LEGO::Handler::initialize(const Vector2& resolution)
 	//Gives a cube as a starter building object
 	holding_obj = new LEGOCube(d3dDevice, fxFactory, physic_scene, composite_body);
 	holding_obj->setID(id_LEGOCube);
+
+	//Platforms were added one at a time, rebuilds the broadphase in one go
+	rebuildBroadPhase();
 }
 
 // Scarle --------------------------------------------------------------------------------------------------------------
 
 void LEGO::Handler::update()
 {
+	int physics_steps = 0;
+	
 	if(driving_mode)
 	{
-		//If in driving mode steps the physics scene
-		physic_scene->Step();
+		//Reset is the only queued input while driving
+		while(!input_queue.empty())
+		{
+			if(input_queue.front() == input_reset)
+				resetCompositeBody();
+			input_queue.pop();
+		}
+		
+		//If in driving mode runs as many physics steps as the frame time needs
+		physics_steps = physic_scene->Advance(GD->m_dt);
 	}
 	else
 	{
@@ -211,8 +228,8 @@ void LEGO::Handler::update()
 	for(auto& block : composite_body_assembly)
 	{
 		block->Tick(GD);
-		//on driving mode calls the movement behaviour of each object
-		if(driving_mode)
+		//on driving mode calls the movement behaviour of each object, once per physics step taken
+		for(int i = 0; i < physics_steps; ++i)
 			block->applyInputToBlock(GD, movement_vector);
 	}
 	
@@ -317,6 +334,8 @@ void LEGO::Handler::readInput()
 		{
 			movement_vector.z = 0;
 		}
+		
+		addToInputQueue(GD->m_KBS.R, input_reset);
 	}
 	else
 	{
@@ -422,6 +441,9 @@ void LEGO::Handler::loadFromPath(const std::string& path)
 	
 	if(!jsonfile.empty())
 	{
+		//Defers mass and broadphase updates of the vehicle until every block is in
+		composite_body->BeginShapeEdit();
+
 		//Clears the already existing blocks that may have been placed
 		while(!composite_body_assembly.empty())
 		{
@@ -445,6 +467,10 @@ void LEGO::Handler::loadFromPath(const std::string& path)
 			//this file is written and read only via lego component
 			composite_body_assembly.back()->materialize();
 		}
+		composite_body->EndShapeEdit();
+
+		//Blocks were added one at a time, rebuilds the broadphase in one go
+		rebuildBroadPhase();
 	}
 }
 
@@ -554,6 +580,13 @@ void LEGO::Handler::materializeCompositeBody()
 	driving_mode = true;
 	UI->setDrivingMode(driving_mode);
 
+	//The vehicle was built one block at a time, rebuilds the broadphase before driving
+	rebuildBroadPhase();
+
+	//Checkpoints the scene so the vehicle can be put back without rebuilding it
+	vehicle_checkpoint.resize(physic_scene->GetStateSize());
+	physic_scene->SaveState(vehicle_checkpoint.data());
+
 	//For the camera, a base offset is applied as it would be overlapping with the vehicle otherwise
 	Vector3 offset_pos = Vector3(10,60,80);
 	Vector3 farthest_pos = Vector3(0,0,0);
@@ -582,6 +615,35 @@ void LEGO::Handler::materializeCompositeBody()
 	GD->m_GS = GS_PLAY_TPS_CAM;
 }
 
+/**
+ * \brief Rebuilds the physics broadphase so its quality does not depend on the order blocks were added in.
+ * In debug mode, prints how many broadphase nodes a query visits on average before and after.
+ */
+void LEGO::Handler::rebuildBroadPhase() const
+{
+	const float visits_before = debug_mode ? physic_scene->GetBroadPhaseQueryVisits() : 0.f;
+	physic_scene->RebuildBroadPhase();
+
+	if(debug_mode)
+	{
+		const float visits_after = physic_scene->GetBroadPhaseQueryVisits();
+		const std::string message = "Broadphase rebuilt, average query visits " +
+			std::to_string(visits_before) + " -> " + std::to_string(visits_after) + "\n";
+		OutputDebugStringA(message.c_str());
+	}
+}
+
+/**
+ * \brief Puts the vehicle back where it was when it was materialized, keeping every block and body pointer valid.
+ */
+void LEGO::Handler::resetCompositeBody()
+{
+	if(!vehicle_checkpoint.empty())
+	{
+		physic_scene->LoadState(vehicle_checkpoint.data(), (int)vehicle_checkpoint.size());
+	}
+}
+
 // Getters & Setters ---------------------------------------------------------------------------------------------------
 
 /**
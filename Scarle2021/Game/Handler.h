@@ -36,7 +36,8 @@ namespace LEGO
 		input_rotate_pitch,
 		input_delete,
 		input_select,
-		input_materialize
+		input_materialize,
+		input_reset
 	};
 	
 	/**
@@ -77,6 +78,10 @@ namespace LEGO
 		
 		//Materializes 
 		void materializeCompositeBody();
+		void resetCompositeBody();
+
+		//Physics
+		void rebuildBroadPhase() const;
 		
 		//Scarle and DX11 pointers
 		GameData* GD = nullptr;
@@ -88,8 +93,11 @@ namespace LEGO
 		
 		//Physic scene 
 		q3Scene* physic_scene = nullptr;
+		float physics_step = 1.f / 60.f; //Fixed step length, 1/30 halves the physics cost on slower machines
 		//Pointer to the "Vehicle"
 		q3Body* composite_body = nullptr;
+		//Scene state taken when the vehicle was materialized
+		std::vector<char> vehicle_checkpoint{};
 		
 		//Debug render
 		std::unique_ptr<DebugRender> debug_render = nullptr;
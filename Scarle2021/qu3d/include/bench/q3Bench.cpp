@@ -0,0 +1,1241 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3Bench.cpp
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+	#include <linux/perf_event.h>
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif // __linux__
+
+#include <nlohmann/json.hpp>
+
+#include "../q3.h"
+#include "../collision/q3Collide.h"
+#include "../dynamics/q3Contact.h"
+#include "../dynamics/q3ContactSolver.h"
+#include "../dynamics/q3Island.h"
+
+// Runs reproducible scenes without graphics and prints one JSON object per
+// run on stdout, so results can be collected and compared between builds.
+//
+//	qu3e_bench [--steps n] [--threads n] [--broadphase tree|sap|grid|all]
+//		[--iterations n] [--min-iterations n] [--tolerance t] [--relaxation w]
+//		[--arena bytes] [--arena-pairs n] [--arena-moves n] [--queries n]
+//		[--pool-size n] [--deterministic] [--no-simd] [--save-dir path] [scene ...]
+//
+// Scenes are pyramids, rain, platforms and compound, all of them when none
+// is named. sat is not a scene: it times q3SeparatingAxes against its SIMD
+// version on random box pairs and counts the pairs they disagree on. With
+// --queries every scene ends with n AABB queries and n raycasts, run on the
+// live broadphase and again on its query snapshots, which must agree. solver
+// solves the contacts of the settled pyramids as one island with the scalar
+// and the SIMD contact solver and counts the impulses they disagree on. pool
+// is not a scene either: it steps --pool-size single vehicle scenes through
+// a q3ScenePool of --threads threads, then again on one thread, and counts
+// the scenes whose state differs. The exit code is non zero on bad
+// arguments or any disagreement.
+
+#ifndef Q3_BENCH_SAVE_DIR
+	#define Q3_BENCH_SAVE_DIR "SaveData"
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Allocation counting
+//--------------------------------------------------------------------------------------------------
+// q3Alloc and operator new both end up in malloc. With glibc and
+// Q3_BENCH_COUNT_ALLOCATIONS, set by the qu3e_bench_count_allocations CMake
+// option, the bench replaces malloc to count the calls made while a step
+// runs, worker threads included. Sanitizers replace malloc themselves, so
+// sanitized builds never count. Otherwise allocations are reported as -1.
+static std::atomic<bool> countAllocations( false );
+static std::atomic<u64> allocationCount( 0 );
+
+#if defined( __SANITIZE_ADDRESS__ ) || defined( __SANITIZE_THREAD__ )
+	#undef Q3_BENCH_COUNT_ALLOCATIONS
+#elif defined( __has_feature )
+	#if __has_feature( address_sanitizer ) || __has_feature( thread_sanitizer ) || __has_feature( memory_sanitizer )
+		#undef Q3_BENCH_COUNT_ALLOCATIONS
+	#endif
+#endif
+
+#if defined( Q3_BENCH_COUNT_ALLOCATIONS ) && !defined( __GLIBC__ )
+	#undef Q3_BENCH_COUNT_ALLOCATIONS
+#endif
+
+#ifdef Q3_BENCH_COUNT_ALLOCATIONS
+extern "C"
+{
+	void* __libc_malloc( size_t size );
+	void* __libc_calloc( size_t count, size_t size );
+	void* __libc_realloc( void* memory, size_t size );
+
+	void* malloc( size_t size ) __THROW
+	{
+		if ( countAllocations.load( std::memory_order_relaxed ) )
+			allocationCount.fetch_add( 1, std::memory_order_relaxed );
+
+		return __libc_malloc( size );
+	}
+
+	void* calloc( size_t count, size_t size ) __THROW
+	{
+		if ( countAllocations.load( std::memory_order_relaxed ) )
+			allocationCount.fetch_add( 1, std::memory_order_relaxed );
+
+		return __libc_calloc( count, size );
+	}
+
+	void* realloc( void* memory, size_t size ) __THROW
+	{
+		if ( countAllocations.load( std::memory_order_relaxed ) )
+			allocationCount.fetch_add( 1, std::memory_order_relaxed );
+
+		return __libc_realloc( memory, size );
+	}
+}
+#endif // Q3_BENCH_COUNT_ALLOCATIONS
+
+//--------------------------------------------------------------------------------------------------
+// q3BenchCacheMisses
+//--------------------------------------------------------------------------------------------------
+// Hardware cache misses of the calling thread, from perf events on Linux.
+// Reads -1 elsewhere, or where the kernel or a virtual machine does not
+// expose the counter.
+struct q3BenchCacheMisses
+{
+	int fd;
+
+	q3BenchCacheMisses( )
+		: fd( -1 )
+	{
+#ifdef __linux__
+		perf_event_attr attr;
+		memset( &attr, 0, sizeof( attr ) );
+		attr.size = sizeof( attr );
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd = (int)syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 );
+#endif // __linux__
+	}
+
+	~q3BenchCacheMisses( )
+	{
+#ifdef __linux__
+		if ( fd >= 0 )
+			close( fd );
+#endif // __linux__
+	}
+
+	void Start( )
+	{
+#ifdef __linux__
+		if ( fd >= 0 )
+		{
+			ioctl( fd, PERF_EVENT_IOC_RESET, 0 );
+			ioctl( fd, PERF_EVENT_IOC_ENABLE, 0 );
+		}
+#endif // __linux__
+	}
+
+	r64 Stop( )
+	{
+#ifdef __linux__
+		long long count;
+
+		if ( fd >= 0 )
+		{
+			ioctl( fd, PERF_EVENT_IOC_DISABLE, 0 );
+
+			if ( read( fd, &count, sizeof( count ) ) == sizeof( count ) )
+				return r64( count );
+		}
+#endif // __linux__
+
+		return -1.0;
+	}
+};
+
+//--------------------------------------------------------------------------------------------------
+// q3BenchRandom
+//--------------------------------------------------------------------------------------------------
+// Fixed seed LCG so every run builds the same scene on every platform
+struct q3BenchRandom
+{
+	u32 state;
+
+	q3BenchRandom( u32 seed )
+		: state( seed )
+	{
+	}
+
+	r32 Next( r32 lo, r32 hi )
+	{
+		state = state * 1664525u + 1013904223u;
+		return lo + (hi - lo) * r32( state >> 8 ) / r32( 1 << 24 );
+	}
+};
+
+//--------------------------------------------------------------------------------------------------
+// Scenes
+//--------------------------------------------------------------------------------------------------
+struct q3BenchOptions
+{
+	i32 steps;
+	i32 threads;
+	i32 iterations;
+	i32 minIterations;
+	r32 tolerance;
+	r32 relaxation;
+	q3FrameArenaDef arena;
+	i32 queries;
+	i32 poolSize;
+	bool deterministic;
+	bool simd;
+	std::string saveDir;
+};
+
+struct q3BenchWorld
+{
+	std::vector<q3Body*> vehicles;	// Pushed forward once they have landed
+	q3AABB bounds;	// Where --queries looks
+	i32 bodyCount;
+	i32 boxCount;
+};
+
+typedef void (*q3BenchBuild)( q3Scene* scene, const q3BenchOptions& options, q3BenchWorld* world );
+
+struct q3BenchScene
+{
+	const char* name;
+	q3BenchBuild build;
+};
+
+//--------------------------------------------------------------------------------------------------
+static q3Body* q3BenchBody( q3Scene* scene, q3BodyType type, const q3Vec3& position, q3BenchWorld* world )
+{
+	q3BodyDef def;
+	def.bodyType = type;
+	def.position = position;
+	++world->bodyCount;
+	return scene->CreateBody( def );
+}
+
+//--------------------------------------------------------------------------------------------------
+static void q3BenchBox( q3Body* body, const q3Vec3& position, const q3Vec3& extents, r32 friction, q3BenchWorld* world )
+{
+	q3Transform tx;
+	q3Identity( tx );
+	tx.position = position;
+
+	q3BoxDef def;
+	def.Set( tx, extents );
+	def.SetFriction( friction );
+	body->AddBox( def );
+	++world->boxCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+static void q3BenchGround( q3Scene* scene, r32 halfWidth, q3BenchWorld* world )
+{
+	world->bounds.min.Set( -halfWidth, r32( 0.0 ), -halfWidth );
+	world->bounds.max.Set( halfWidth, r32( 20.0 ), halfWidth );
+
+	q3Body* ground = q3BenchBody( scene, eStaticBody, q3Vec3( r32( 0.0 ), r32( 0.0 ), r32( 0.0 ) ), world );
+	q3BenchBox( ground, q3Vec3( r32( 0.0 ), r32( 0.0 ), r32( 0.0 ) ), q3Vec3( halfWidth * r32( 2.0 ), r32( 2.0 ), halfWidth * r32( 2.0 ) ), r32( 0.4 ), world );
+}
+
+//--------------------------------------------------------------------------------------------------
+// Four pyramids of unit boxes, 12 rows high and 3 boxes deep
+static void q3BuildPyramids( q3Scene* scene, const q3BenchOptions& options, q3BenchWorld* world )
+{
+	Q3_UNUSED( options );
+
+	q3BenchGround( scene, r32( 100.0 ), world );
+
+	const i32 rows = 12;
+	for ( i32 p = 0; p < 4; ++p )
+	{
+		for ( i32 r = 0; r < rows; ++r )
+		{
+			for ( i32 i = 0; i < rows - r; ++i )
+			{
+				for ( i32 k = 0; k < 3; ++k )
+				{
+					q3Vec3 position( r32( -60.0 ) + r32( p ) * r32( 35.0 ) + r32( i ) * r32( 1.02 ) + r32( r ) * r32( 0.51 ), r32( 1.5 ) + r32( r ), r32( k ) * r32( 1.02 ) );
+					q3Body* body = q3BenchBody( scene, eDynamicBody, position, world );
+					q3BenchBox( body, q3Vec3( r32( 0.0 ), r32( 0.0 ), r32( 0.0 ) ), q3Vec3( r32( 1.0 ), r32( 1.0 ), r32( 1.0 ) ), r32( 0.4 ), world );
+				}
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// 10k randomly sized and rotated boxes dropped in layers onto the ground
+static void q3BuildRain( q3Scene* scene, const q3BenchOptions& options, q3BenchWorld* world )
+{
+	Q3_UNUSED( options );
+
+	q3BenchGround( scene, r32( 120.0 ), world );
+
+	q3BenchRandom random( 1 );
+	const i32 side = 40;
+
+	for ( i32 n = 0; n < 10000; ++n )
+	{
+		i32 cell = n % (side * side);
+		i32 layer = n / (side * side);
+
+		q3BodyDef def;
+		def.bodyType = eDynamicBody;
+		def.position.Set(
+			r32( cell % side - side / 2 ) * r32( 5.0 ) + random.Next( r32( -1.0 ), r32( 1.0 ) ),
+			r32( 8.0 ) + r32( layer ) * r32( 8.0 ) + random.Next( r32( 0.0 ), r32( 2.0 ) ),
+			r32( cell / side - side / 2 ) * r32( 5.0 ) + random.Next( r32( -1.0 ), r32( 1.0 ) ) );
+		def.axis.Set( random.Next( r32( -1.0 ), r32( 1.0 ) ), r32( 1.0 ), random.Next( r32( -1.0 ), r32( 1.0 ) ) );
+		def.angle = random.Next( r32( 0.0 ), r32( 3.0 ) );
+		q3Body* body = scene->CreateBody( def );
+		++world->bodyCount;
+
+		q3Vec3 extents( random.Next( r32( 0.8 ), r32( 2.4 ) ), random.Next( r32( 0.8 ), r32( 2.4 ) ), random.Next( r32( 0.8 ), r32( 2.4 ) ) );
+		q3BenchBox( body, q3Vec3( r32( 0.0 ), r32( 0.0 ), r32( 0.0 ) ), extents, r32( 0.4 ), world );
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Box extents of each block type, indexed by the game's BlockIndex
+static const q3Vec3 q3k_blockExtents[] = {
+	q3Vec3( r32( 1.0 ), r32( 1.0 ), r32( 1.0 ) ),		// id_invalid
+	q3Vec3( r32( 1.0 ), r32( 1.0 ), r32( 1.0 ) ),		// id_LEGOBaseObj
+	q3Vec3( r32( 9.0 ), r32( 9.0 ), r32( 9.0 ) ),		// id_LEGOCube
+	q3Vec3( r32( 101.0 ), r32( 0.1 ), r32( 101.0 ) ),	// id_LEGOPlatform
+	q3Vec3( r32( 9.0 ), r32( 9.0 ), r32( 9.0 ) ),		// id_LEGOStartingCube
+	q3Vec3( r32( 9.0 ), r32( 19.0 ), r32( 19.0 ) ),	// id_LEGOSteeringWheel
+	q3Vec3( r32( 9.0 ), r32( 9.0 ), r32( 14.0 ) ),		// id_LEGOThruster
+	q3Vec3( r32( 9.0 ), r32( 19.0 ), r32( 19.0 ) ),	// id_LEGOWheel
+	q3Vec3( r32( 29.0 ), r32( 0.5 ), r32( 10.5 ) ),	// id_LEGOWing
+};
+
+//--------------------------------------------------------------------------------------------------
+// Adds the blocks of a vehicle saved by the game to body, the same way
+// LEGO::Handler::loadFromPath does. Blocks keep an identity rotation and
+// only their extents are turned, so only 90 degree rotations are exact.
+static bool q3BenchVehicle( q3Body* body, const std::string& path, q3BenchWorld* world )
+{
+	std::ifstream file( path );
+	if ( !file )
+		return false;
+
+	nlohmann::json blocks = nlohmann::json::parse( file, nullptr, false );
+	if ( blocks.is_discarded( ) || !blocks.is_array( ) )
+	{
+		fprintf( stderr, "qu3e_bench: %s is not a vehicle\n", path.c_str( ) );
+		return false;
+	}
+
+	const q3Vec3 x( r32( 1.0 ), r32( 0.0 ), r32( 0.0 ) );
+	const q3Vec3 y( r32( 0.0 ), r32( 1.0 ), r32( 0.0 ) );
+	const q3Vec3 z( r32( 0.0 ), r32( 0.0 ), r32( 1.0 ) );
+
+	body->BeginShapeEdit( );
+
+	for ( const nlohmann::json& block : blocks )
+	{
+		i32 type = block[ "type" ];
+		if ( type <= 0 || type >= i32( sizeof( q3k_blockExtents ) / sizeof( q3k_blockExtents[ 0 ] ) ) )
+			continue;
+
+		const nlohmann::json& p = block[ "position" ];
+		const nlohmann::json& r = block[ "rotation" ];
+
+		// Roll, then pitch, then yaw, as XMQuaternionRotationRollPitchYaw
+		q3Quaternion q = q3Quaternion( y, r[ "yaw" ] ) * q3Quaternion( x, r[ "pitch" ] ) * q3Quaternion( z, r[ "roll" ] );
+		q3Vec3 e = q.ToMat3( ) * q3k_blockExtents[ type ];
+		e.Set( q3Abs( std::round( e.x ) ), q3Abs( std::round( e.y ) ), q3Abs( std::round( e.z ) ) );
+
+		q3BenchBox( body, q3Vec3( p[ "x" ], p[ "y" ], p[ "z" ] ), e, r32( 0.8 ), world );
+	}
+
+	body->EndShapeEdit( );
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The game's 8x8 platform grid with every saved vehicle dropped onto it
+static void q3BuildPlatforms( q3Scene* scene, const q3BenchOptions& options, q3BenchWorld* world )
+{
+	scene->SetGravity( q3Vec3( r32( 0.0 ), r32( -19.62 ), r32( 0.0 ) ) );
+	world->bounds.min.Set( r32( -400.0 ), r32( -60.0 ), r32( -400.0 ) );
+	world->bounds.max.Set( r32( 400.0 ), r32( -20.0 ), r32( 400.0 ) );
+
+	q3Body* platforms = q3BenchBody( scene, eStaticBody, q3Vec3( r32( 0.0 ), r32( 0.0 ), r32( 0.0 ) ), world );
+	platforms->BeginShapeEdit( );
+
+	for ( i32 i = 0; i < 8; ++i )
+	{
+		for ( i32 j = 0; j < 8; ++j )
+		{
+			q3Vec3 position( r32( 100 * i - 350 ), r32( -50.0 ), r32( 100 * j - 350 ) );
+			q3BenchBox( platforms, position, q3k_blockExtents[ 3 ], r32( 0.8 ), world );
+		}
+	}
+
+	platforms->EndShapeEdit( );
+
+	for ( i32 slot = 1; slot <= 3; ++slot )
+	{
+		std::string path = options.saveDir + "/slot" + std::to_string( slot ) + ".json";
+		q3Body* vehicle = q3BenchBody( scene, eDynamicBody, q3Vec3( r32( 250 * (slot - 2) ), r32( -35.0 ), r32( 0.0 ) ), world );
+
+		if ( q3BenchVehicle( vehicle, path, world ) )
+			world->vehicles.push_back( vehicle );
+		else
+		{
+			fprintf( stderr, "qu3e_bench: skipping vehicle %s\n", path.c_str( ) );
+			scene->RemoveBody( vehicle );
+			--world->bodyCount;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// A single 10x5x10 body of 500 unit boxes dropped tilted onto loose boxes
+static void q3BuildCompound( q3Scene* scene, const q3BenchOptions& options, q3BenchWorld* world )
+{
+	Q3_UNUSED( options );
+
+	q3BenchGround( scene, r32( 50.0 ), world );
+
+	for ( i32 i = 0; i < 10; ++i )
+	{
+		for ( i32 j = 0; j < 10; ++j )
+		{
+			q3Vec3 position( r32( i ) * r32( 1.5 ) - r32( 6.75 ), r32( 1.5 ), r32( j ) * r32( 1.5 ) - r32( 6.75 ) );
+			q3Body* body = q3BenchBody( scene, eDynamicBody, position, world );
+			q3BenchBox( body, q3Vec3( r32( 0.0 ), r32( 0.0 ), r32( 0.0 ) ), q3Vec3( r32( 1.0 ), r32( 1.0 ), r32( 1.0 ) ), r32( 0.4 ), world );
+		}
+	}
+
+	q3BodyDef def;
+	def.bodyType = eDynamicBody;
+	def.position.Set( r32( 0.0 ), r32( 12.0 ), r32( 0.0 ) );
+	def.axis.Set( r32( 1.0 ), r32( 0.0 ), r32( 1.0 ) );
+	def.angle = r32( 0.3 );
+	q3Body* compound = scene->CreateBody( def );
+	++world->bodyCount;
+
+	compound->BeginShapeEdit( );
+
+	for ( i32 i = 0; i < 10; ++i )
+	{
+		for ( i32 k = 0; k < 5; ++k )
+		{
+			for ( i32 j = 0; j < 10; ++j )
+			{
+				q3Vec3 position( r32( i ) - r32( 4.5 ), r32( k ) - r32( 2.0 ), r32( j ) - r32( 4.5 ) );
+				q3BenchBox( compound, position, q3Vec3( r32( 1.0 ), r32( 1.0 ), r32( 1.0 ) ), r32( 0.4 ), world );
+			}
+		}
+	}
+
+	compound->EndShapeEdit( );
+}
+
+static const q3BenchScene q3k_scenes[] = {
+	{ "pyramids", q3BuildPyramids },
+	{ "rain", q3BuildRain },
+	{ "platforms", q3BuildPlatforms },
+	{ "compound", q3BuildCompound },
+};
+
+static const char* q3k_broadPhaseNames[] = { "tree", "sap", "grid" };
+
+//--------------------------------------------------------------------------------------------------
+// Runs
+//--------------------------------------------------------------------------------------------------
+// Counts hits and folds them into an order dependent checksum
+struct q3BenchQueryCallback : public q3QueryCallback
+{
+	u64 hits;
+	u64 checksum;
+
+	bool ReportShape( q3Box* box )
+	{
+		++hits;
+		checksum = checksum * 1099511628211ull + (u64)(uintptr_t)box;
+		return true;
+	}
+};
+
+struct q3BenchQueryTimes
+{
+	r64 aabbNs;
+	r64 rayNs;
+	r64 missesPerQuery;
+	u64 hits;
+	u64 checksum;
+};
+
+//--------------------------------------------------------------------------------------------------
+static void q3RunQueries( const q3Scene& scene, const std::vector<q3AABB>& aabbs, const std::vector<q3RaycastData>& rays, q3BenchQueryTimes* times )
+{
+	typedef std::chrono::steady_clock clock;
+
+	q3BenchQueryCallback cb;
+	cb.hits = 0;
+	cb.checksum = 0;
+
+	q3BenchCacheMisses misses;
+	misses.Start( );
+	clock::time_point start = clock::now( );
+
+	for ( const q3AABB& aabb : aabbs )
+		scene.QueryAABB( &cb, aabb );
+
+	clock::time_point middle = clock::now( );
+
+	for ( q3RaycastData ray : rays )
+		scene.RayCast( &cb, ray );
+
+	clock::time_point end = clock::now( );
+	r64 missCount = misses.Stop( );
+
+	r64 count = r64( aabbs.size( ) );
+	times->aabbNs = std::chrono::duration<r64, std::nano>( middle - start ).count( ) / count;
+	times->rayNs = std::chrono::duration<r64, std::nano>( end - middle ).count( ) / count;
+	times->missesPerQuery = missCount < 0.0 ? -1.0 : missCount / (count * 2.0);
+	times->hits = cb.hits;
+	times->checksum = cb.checksum;
+}
+
+//--------------------------------------------------------------------------------------------------
+static i32 q3RunScene( const q3BenchScene& benchScene, q3BroadPhaseType broadPhase, const q3BenchOptions& options )
+{
+	typedef std::chrono::steady_clock clock;
+
+	q3Scene scene( r32( 1.0 / 60.0 ), q3Vec3( r32( 0.0 ), r32( -9.8 ), r32( 0.0 ) ), options.iterations, broadPhase );
+	scene.SetAdaptiveIterations( options.minIterations, options.tolerance );
+	scene.SetRelaxation( options.relaxation );
+	scene.SetFrameArena( options.arena );
+	scene.SetThreadCount( options.threads );
+	scene.SetEnableSIMD( options.simd );
+	scene.SetDeterministic( options.deterministic );
+
+	q3BenchWorld world;
+	world.bodyCount = 0;
+	world.boxCount = 0;
+	benchScene.build( &scene, options, &world );
+	scene.RebuildBroadPhase( );
+
+	q3StepStats sum;
+	memset( &sum, 0, sizeof( sum ) );
+	r64 msTotal = 0.0;
+	r64 msMax = 0.0;
+	u64 allocations = 0;
+
+	for ( i32 i = 0; i < options.steps; ++i )
+	{
+		// Vehicles are given a push once they have settled on the platforms
+		if ( i == options.steps / 4 )
+		{
+			for ( q3Body* vehicle : world.vehicles )
+				vehicle->ApplyLinearImpulse( q3Vec3( r32( 0.0 ), r32( 0.0 ), vehicle->GetMass( ) * r32( 40.0 ) ) );
+		}
+
+		allocationCount.store( 0, std::memory_order_relaxed );
+		countAllocations.store( true, std::memory_order_relaxed );
+		clock::time_point start = clock::now( );
+
+		scene.Step( );
+
+		clock::time_point end = clock::now( );
+		countAllocations.store( false, std::memory_order_relaxed );
+		allocations += allocationCount.load( std::memory_order_relaxed );
+
+		r64 ms = std::chrono::duration<r64, std::milli>( end - start ).count( );
+		msTotal += ms;
+		msMax = ms > msMax ? ms : msMax;
+
+		q3StepStats stats;
+		scene.GetStepStats( &stats );
+		sum.updatePairs += stats.updatePairs;
+		sum.testCollisions += stats.testCollisions;
+		sum.islandBuild += stats.islandBuild;
+		sum.islandSolve += stats.islandSolve;
+		sum.synchronizeProxies += stats.synchronizeProxies;
+		sum.islandSplit += stats.islandSplit;
+		sum.findNewContacts += stats.findNewContacts;
+		sum.pairCount += stats.pairCount;
+		sum.contactCount += stats.contactCount;
+		sum.solvedContactCount += stats.solvedContactCount;
+		sum.islandCount += stats.islandCount;
+		sum.iterations += stats.iterations;
+		sum.treeVisits += stats.treeVisits;
+	}
+
+	r64 n = r64( options.steps > 0 ? options.steps : 1 );
+
+	q3FrameArenaStats arena;
+	scene.GetFrameArenaStats( &arena );
+
+	// Boxes of 1 to 8 units and rays up to 50 units long inside the scene's
+	// bounds, first on the live trees and then on their snapshots
+	q3BenchQueryTimes live;
+	q3BenchQueryTimes snapshot;
+	memset( &live, 0, sizeof( live ) );
+	memset( &snapshot, 0, sizeof( snapshot ) );
+	i32 queryMismatches = 0;
+
+	if ( options.queries > 0 )
+	{
+		q3BenchRandom random( 7 );
+		const q3AABB& bounds = world.bounds;
+		std::vector<q3AABB> aabbs( options.queries );
+		std::vector<q3RaycastData> rays( options.queries );
+
+		for ( i32 i = 0; i < options.queries; ++i )
+		{
+			q3Vec3 center( random.Next( bounds.min.x, bounds.max.x ), random.Next( bounds.min.y, bounds.max.y ), random.Next( bounds.min.z, bounds.max.z ) );
+			r32 half = random.Next( r32( 0.5 ), r32( 4.0 ) );
+			aabbs[ i ].min = center - q3Vec3( half, half, half );
+			aabbs[ i ].max = center + q3Vec3( half, half, half );
+
+			q3Vec3 dir( random.Next( r32( -1.0 ), r32( 1.0 ) ), random.Next( r32( -1.0 ), r32( 0.2 ) ), random.Next( r32( -1.0 ), r32( 1.0 ) ) );
+			rays[ i ].Set( center, q3Normalize( dir ), random.Next( r32( 1.0 ), r32( 50.0 ) ) );
+		}
+
+		q3RunQueries( scene, aabbs, rays, &live );
+		scene.SetQuerySnapshots( true );
+		q3RunQueries( scene, aabbs, rays, &snapshot );
+		scene.SetQuerySnapshots( false );
+
+		if ( live.hits != snapshot.hits || live.checksum != snapshot.checksum )
+			queryMismatches = 1;
+	}
+
+#ifdef Q3_BENCH_COUNT_ALLOCATIONS
+	r64 allocationsPerStep = r64( allocations ) / n;
+#else
+	r64 allocationsPerStep = -1.0;
+#endif // Q3_BENCH_COUNT_ALLOCATIONS
+
+	printf( "{\"scene\":\"%s\",\"broadphase\":\"%s\",\"threads\":%d,\"simd\":%s,\"deterministic\":%s,"
+		"\"max_iterations\":%d,\"min_iterations\":%d,\"tolerance\":%g,\"relaxation\":%g,\"bodies\":%d,\"boxes\":%d,\"steps\":%d,"
+		"\"ms_per_step\":%.4f,\"ms_max\":%.4f,\"allocs_per_step\":%.2f,"
+		"\"pairs_per_step\":%.1f,\"contacts\":%.1f,\"solved_contacts\":%.1f,\"islands\":%.1f,\"iterations\":%.1f,\"tree_visits\":%.1f,"
+		"\"phase_ms\":{\"update_pairs\":%.4f,\"test_collisions\":%.4f,\"island_build\":%.4f,\"island_solve\":%.4f,"
+		"\"synchronize_proxies\":%.4f,\"island_split\":%.4f,\"find_new_contacts\":%.4f},"
+		"\"arena\":{\"bytes\":%d,\"peak_bytes\":%d,\"pairs\":%d,\"peak_pairs\":%d,\"moves\":%d,\"peak_moves\":%d,\"overflows\":%d},"
+		"\"queries\":{\"count\":%d,\"hits\":%llu,\"mismatches\":%d,"
+		"\"live\":{\"aabb_ns\":%.1f,\"ray_ns\":%.1f,\"cache_misses\":%.2f},"
+		"\"snapshot\":{\"aabb_ns\":%.1f,\"ray_ns\":%.1f,\"cache_misses\":%.2f}},"
+		"\"state_hash\":\"%016llx\"}\n",
+		benchScene.name, q3k_broadPhaseNames[ broadPhase ], scene.GetThreadCount( ),
+		options.simd ? "true" : "false", options.deterministic ? "true" : "false",
+		options.iterations, options.minIterations, options.tolerance, options.relaxation, world.bodyCount, world.boxCount, options.steps,
+		msTotal / n, msMax, allocationsPerStep,
+		r64( sum.pairCount ) / n, r64( sum.contactCount ) / n, r64( sum.solvedContactCount ) / n,
+		r64( sum.islandCount ) / n, r64( sum.iterations ) / n, r64( sum.treeVisits ) / n,
+		sum.updatePairs / n, sum.testCollisions / n, sum.islandBuild / n, sum.islandSolve / n,
+		sum.synchronizeProxies / n, sum.islandSplit / n, sum.findNewContacts / n,
+		arena.capacity.bytes, arena.peak.bytes, arena.capacity.pairCapacity, arena.peak.pairCapacity,
+		arena.capacity.moveCapacity, arena.peak.moveCapacity, arena.overflowCount,
+		options.queries, (unsigned long long)live.hits, queryMismatches,
+		live.aabbNs, live.rayNs, live.missesPerQuery,
+		snapshot.aabbNs, snapshot.rayNs, snapshot.missesPerQuery,
+		(unsigned long long)scene.ComputeStateHash( ) );
+	fflush( stdout );
+
+	return queryMismatches;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Random overlapping box pairs, every fourth one axis aligned and every
+// seventh one turned by 90 degrees, so the parallel paths are covered
+static i32 q3RunSeparatingAxes( )
+{
+	struct Pair
+	{
+		q3Vec3 t;
+		q3Mat3 C;
+		q3Mat3 absC;
+		q3Vec3 eA;
+		q3Vec3 eB;
+		bool parallel;
+	};
+
+	const i32 count = 200000;
+	std::vector<Pair> pairs( count );
+	q3BenchRandom random( 7 );
+
+	for ( i32 n = 0; n < count; ++n )
+	{
+		Pair& p = pairs[ n ];
+
+		q3Vec3 axis( random.Next( r32( -1.0 ), r32( 1.0 ) ), random.Next( r32( -1.0 ), r32( 1.0 ) ), random.Next( r32( -1.0 ), r32( 1.0 ) ) );
+		if ( q3Length( axis ) < r32( 1.0e-3 ) )
+			axis.Set( r32( 0.0 ), r32( 1.0 ), r32( 0.0 ) );
+
+		r32 angle = random.Next( r32( -3.14159 ), r32( 3.14159 ) );
+		if ( n % 4 == 0 )
+			angle = r32( 0.0 );
+		if ( n % 7 == 0 )
+			angle = r32( 1.5707963 );
+
+		p.C = q3Quaternion( q3Normalize( axis ), angle ).ToMat3( );
+		p.t.Set( random.Next( r32( -3.0 ), r32( 3.0 ) ), random.Next( r32( -3.0 ), r32( 3.0 ) ), random.Next( r32( -3.0 ), r32( 3.0 ) ) );
+		p.eA.Set( random.Next( r32( 0.1 ), r32( 2.0 ) ), random.Next( r32( 0.1 ), r32( 2.0 ) ), random.Next( r32( 0.1 ), r32( 2.0 ) ) );
+		p.eB.Set( random.Next( r32( 0.1 ), r32( 2.0 ) ), random.Next( r32( 0.1 ), r32( 2.0 ) ), random.Next( r32( 0.1 ), r32( 2.0 ) ) );
+
+		p.parallel = false;
+		for ( i32 i = 0; i < 3; ++i )
+		{
+			for ( i32 j = 0; j < 3; ++j )
+			{
+				p.absC[ i ][ j ] = q3Abs( p.C[ i ][ j ] );
+
+				if ( p.absC[ i ][ j ] + r32( 1.0e-6 ) >= r32( 1.0 ) )
+					p.parallel = true;
+			}
+		}
+	}
+
+	i32 separated = 0;
+	i32 mismatches = 0;
+	r64 scalarNs = -1.0;
+	r64 simdNs = -1.0;
+
+	typedef std::chrono::steady_clock clock;
+	const i32 repeats = 10;
+	i32 sink = 0;
+
+	clock::time_point start = clock::now( );
+	for ( i32 k = 0; k < repeats; ++k )
+	{
+		for ( const Pair& p : pairs )
+		{
+			q3AxisQuery q;
+			sink += q3SeparatingAxes( p.t, p.C, p.absC, p.eA, p.eB, p.parallel, &q );
+		}
+	}
+	scalarNs = std::chrono::duration<r64, std::nano>( clock::now( ) - start ).count( ) / r64( repeats * count );
+
+#ifdef Q3_SIMD
+	start = clock::now( );
+	for ( i32 k = 0; k < repeats; ++k )
+	{
+		for ( const Pair& p : pairs )
+		{
+			q3AxisQuery q;
+			sink += q3SeparatingAxesSIMD( p.t, p.C, p.absC, p.eA, p.eB, p.parallel, &q );
+		}
+	}
+	simdNs = std::chrono::duration<r64, std::nano>( clock::now( ) - start ).count( ) / r64( repeats * count );
+
+	for ( const Pair& p : pairs )
+	{
+		q3AxisQuery a = { };
+		q3AxisQuery b = { };
+
+		i32 axisA = q3SeparatingAxes( p.t, p.C, p.absC, p.eA, p.eB, p.parallel, &a );
+		i32 axisB = q3SeparatingAxesSIMD( p.t, p.C, p.absC, p.eA, p.eB, p.parallel, &b );
+
+		if ( axisA != ~0 )
+			++separated;
+
+		// Bit for bit, including the edge normal of the deepest edge axis
+		bool match = axisA == axisB;
+		if ( match && axisA == ~0 )
+		{
+			match = a.aAxis == b.aAxis && a.bAxis == b.bAxis && a.eAxis == b.eAxis
+				&& !memcmp( &a.aMax, &b.aMax, sizeof( r32 ) )
+				&& !memcmp( &a.bMax, &b.bMax, sizeof( r32 ) )
+				&& !memcmp( &a.eMax, &b.eMax, sizeof( r32 ) )
+				&& (a.eAxis == ~0 || !memcmp( &a.nE, &b.nE, sizeof( q3Vec3 ) ));
+		}
+
+		if ( !match )
+			++mismatches;
+	}
+#else
+	for ( const Pair& p : pairs )
+	{
+		q3AxisQuery q;
+		if ( q3SeparatingAxes( p.t, p.C, p.absC, p.eA, p.eB, p.parallel, &q ) != ~0 )
+			++separated;
+	}
+#endif // Q3_SIMD
+
+	printf( "{\"scene\":\"sat\",\"pairs\":%d,\"separated\":%d,\"mismatches\":%d,"
+		"\"scalar_ns_per_pair\":%.2f,\"simd_ns_per_pair\":%.2f,\"checksum\":%d}\n",
+		count, separated, mismatches, scalarNs, simdNs, sink );
+	fflush( stdout );
+
+	return mismatches;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Keeps the touching contacts of a scene, in the order they began
+struct q3BenchContacts : public q3ContactListener
+{
+	std::vector<q3ContactConstraint*> contacts;
+
+	void BeginContact( const q3ContactConstraint *contact )
+	{
+		contacts.push_back( const_cast<q3ContactConstraint*>( contact ) );
+	}
+
+	void EndContact( const q3ContactConstraint *contact )
+	{
+		for ( size_t i = 0; i < contacts.size( ); ++i )
+		{
+			if ( contacts[ i ] == contact )
+			{
+				contacts.erase( contacts.begin( ) + i );
+				break;
+			}
+		}
+	}
+};
+
+//--------------------------------------------------------------------------------------------------
+// Settles the pyramids, then gathers all their contacts into one island and
+// solves it from the same starting states with the scalar solver and with
+// the batched SIMD solver. The accumulated impulses of every contact point
+// and the resulting velocities must agree bit for bit.
+static i32 q3RunSolver( const q3BenchOptions& options )
+{
+	q3Scene scene( r32( 1.0 / 60.0 ), q3Vec3( r32( 0.0 ), r32( -9.8 ), r32( 0.0 ) ), options.iterations );
+	q3BenchContacts listener;
+	q3BenchWorld world;
+	world.bodyCount = 0;
+	world.boxCount = 0;
+
+	scene.SetAllowSleep( false );
+	scene.SetContactListener( &listener );
+	q3BuildPyramids( &scene, options, &world );
+
+	for ( i32 i = 0; i < 60; ++i )
+		scene.Step( );
+
+	scene.SetContactListener( NULL );
+
+	i32 contactCount = i32( listener.contacts.size( ) );
+	std::vector<q3Body*> bodies( world.bodyCount );
+	std::vector<q3VelocityState> velocities( world.bodyCount );
+	std::vector<q3ContactConstraintState> states( contactCount );
+	std::vector<i32> scratch( world.bodyCount + 3 * contactCount + 1 );
+	std::vector<q3ContactBatch> batches( contactCount / 2 + 1 );
+
+	q3Island island;
+	island.m_bodies = bodies.data( );
+	island.m_velocities = velocities.data( );
+	island.m_bodyCapacity = world.bodyCount;
+	island.m_bodyCount = 0;
+	island.m_contacts = listener.contacts.data( );
+	island.m_contactStates = states.data( );
+	island.m_contactCount = contactCount;
+	island.m_contactCapacity = contactCount;
+	island.m_dt = r32( 1.0 / 60.0 );
+	island.m_relaxation = r32( 1.0 );
+	island.m_enableFriction = true;
+	island.m_enableSIMD = false;
+	island.m_solverScratch = scratch.data( );
+	island.m_contactBatches = batches.data( );
+	island.m_threadPool = NULL;
+
+	// Island indices are handed out by Add, in the order bodies are met
+	for ( q3ContactConstraint* contact : listener.contacts )
+	{
+		q3Body* pair[ 2 ] = { contact->bodyA, contact->bodyB };
+
+		for ( q3Body* body : pair )
+		{
+			bool found = false;
+			for ( i32 i = 0; i < island.m_bodyCount && !found; ++i )
+				found = bodies[ i ] == body;
+
+			if ( !found )
+				island.Add( body );
+		}
+	}
+
+	for ( i32 i = 0; i < island.m_bodyCount; ++i )
+	{
+		velocities[ i ].v = bodies[ i ]->GetLinearVelocity( );
+		velocities[ i ].w = bodies[ i ]->GetAngularVelocity( );
+	}
+
+	island.Initialize( );
+
+	const std::vector<q3VelocityState> startVelocities = velocities;
+	const std::vector<q3ContactConstraintState> startStates = states;
+	std::vector<q3VelocityState> scalarVelocities;
+	std::vector<q3ContactConstraintState> scalarStates;
+
+	typedef std::chrono::steady_clock clock;
+	const i32 repeats = 50;
+	r64 scalarNs = -1.0;
+	r64 simdNs = -1.0;
+	i32 points = 0;
+	i32 batchCount = 0;
+	i32 mismatches = 0;
+
+	for ( i32 pass = 0; pass < 2; ++pass )
+	{
+		island.m_enableSIMD = pass == 1;
+
+		clock::time_point start = clock::now( );
+		for ( i32 k = 0; k < repeats; ++k )
+		{
+			velocities = startVelocities;
+			states = startStates;
+
+			q3ContactSolver solver;
+			solver.Initialize( &island );
+			solver.PreSolve( island.m_dt );
+
+			for ( i32 i = 0; i < options.iterations; ++i )
+				solver.Solve( );
+
+#ifdef Q3_SIMD
+			for ( i32 i = 0; i < solver.m_batchCount; ++i )
+				solver.UnpackBatch( solver.m_batches + i );
+#endif // Q3_SIMD
+
+			batchCount = solver.m_batchCount;
+		}
+		r64 ns = std::chrono::duration<r64, std::nano>( clock::now( ) - start ).count( ) / r64( repeats );
+
+		if ( pass == 0 )
+		{
+			scalarNs = ns;
+			scalarVelocities = velocities;
+			scalarStates = states;
+
+#ifndef Q3_SIMD
+			break;
+#endif // Q3_SIMD
+		}
+
+		else
+			simdNs = ns;
+	}
+
+	for ( i32 i = 0; i < contactCount; ++i )
+	{
+		for ( i32 j = 0; j < states[ i ].contactCount; ++j )
+		{
+			const q3ContactState& a = scalarStates[ i ].contacts[ j ];
+			const q3ContactState& b = states[ i ].contacts[ j ];
+
+			if ( memcmp( &a.normalImpulse, &b.normalImpulse, sizeof( r32 ) )
+				|| memcmp( a.tangentImpulse, b.tangentImpulse, sizeof( a.tangentImpulse ) ) )
+				++mismatches;
+
+			++points;
+		}
+	}
+
+	for ( i32 i = 0; i < island.m_bodyCount; ++i )
+	{
+		if ( memcmp( &scalarVelocities[ i ], &velocities[ i ], sizeof( q3VelocityState ) ) )
+			++mismatches;
+	}
+
+	printf( "{\"scene\":\"solver\",\"bodies\":%d,\"contacts\":%d,\"points\":%d,\"batches\":%d,\"iterations\":%d,\"mismatches\":%d,"
+		"\"scalar_us_per_solve\":%.2f,\"simd_us_per_solve\":%.2f}\n",
+		island.m_bodyCount, contactCount, points, batchCount, options.iterations, mismatches,
+		scalarNs / 1000.0, simdNs >= 0.0 ? simdNs / 1000.0 : -1.0 );
+	fflush( stdout );
+
+	return mismatches;
+}
+
+//--------------------------------------------------------------------------------------------------
+// One saved vehicle, the designs taking turns, on a single platform as wide
+// as the game's whole grid, as a server scoring submitted designs would run
+// them
+static void q3BuildDesign( q3Scene* scene, const q3BenchOptions& options, i32 design, q3BenchWorld* world )
+{
+	scene->SetGravity( q3Vec3( r32( 0.0 ), r32( -19.62 ), r32( 0.0 ) ) );
+
+	q3Body* platform = q3BenchBody( scene, eStaticBody, q3Vec3( r32( 0.0 ), r32( 0.0 ), r32( 0.0 ) ), world );
+	q3BenchBox( platform, q3Vec3( r32( 0.0 ), r32( -50.0 ), r32( 0.0 ) ), q3Vec3( r32( 808.0 ), r32( 0.1 ), r32( 808.0 ) ), r32( 0.8 ), world );
+
+	std::string path = options.saveDir + "/slot" + std::to_string( design % 3 + 1 ) + ".json";
+	q3Body* vehicle = q3BenchBody( scene, eDynamicBody, q3Vec3( r32( 0.0 ), r32( -35.0 ), r32( 0.0 ) ), world );
+
+	if ( q3BenchVehicle( vehicle, path, world ) )
+		world->vehicles.push_back( vehicle );
+	else
+	{
+		scene->RemoveBody( vehicle );
+		--world->bodyCount;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Builds the pool's scenes, steps them and returns their state hashes
+static r64 q3StepPool( const q3BenchOptions& options, i32 threads, std::vector<u64>* hashes, r64* contacts )
+{
+	typedef std::chrono::steady_clock clock;
+
+	std::vector<q3Scene*> scenes( options.poolSize );
+	std::vector<q3BenchWorld> worlds( options.poolSize );
+	q3ScenePool pool( threads );
+
+	for ( i32 i = 0; i < options.poolSize; ++i )
+	{
+		scenes[ i ] = new q3Scene( r32( 1.0 / 60.0 ), q3Vec3( r32( 0.0 ), r32( -9.8 ), r32( 0.0 ) ), options.iterations );
+		scenes[ i ]->SetAdaptiveIterations( options.minIterations, options.tolerance );
+		scenes[ i ]->SetRelaxation( options.relaxation );
+		scenes[ i ]->SetEnableSIMD( options.simd );
+		scenes[ i ]->SetDeterministic( options.deterministic );
+
+		worlds[ i ].bodyCount = 0;
+		worlds[ i ].boxCount = 0;
+		q3BuildDesign( scenes[ i ], options, i, &worlds[ i ] );
+		pool.Add( scenes[ i ] );
+	}
+
+	clock::time_point start = clock::now( );
+
+	// Vehicles are given a push once they have settled, like platforms
+	pool.Step( options.steps / 4 );
+
+	for ( const q3BenchWorld& world : worlds )
+	{
+		for ( q3Body* vehicle : world.vehicles )
+			vehicle->ApplyLinearImpulse( q3Vec3( r32( 0.0 ), r32( 0.0 ), vehicle->GetMass( ) * r32( 40.0 ) ) );
+	}
+
+	pool.Step( options.steps - options.steps / 4 );
+
+	clock::time_point end = clock::now( );
+
+	hashes->resize( options.poolSize );
+	*contacts = 0.0;
+
+	for ( i32 i = 0; i < options.poolSize; ++i )
+	{
+		(*hashes)[ i ] = scenes[ i ]->ComputeStateHash( );
+		*contacts += r64( pool.GetStats( i ).lastStep.contactCount );
+		delete scenes[ i ];
+	}
+
+	return std::chrono::duration<r64, std::milli>( end - start ).count( );
+}
+
+//--------------------------------------------------------------------------------------------------
+static i32 q3RunPool( const q3BenchOptions& options )
+{
+	std::vector<u64> pooled;
+	std::vector<u64> alone;
+	r64 contacts;
+
+	r64 msPooled = q3StepPool( options, options.threads, &pooled, &contacts );
+	r64 msAlone = q3StepPool( options, 1, &alone, &contacts );
+
+	i32 mismatches = 0;
+
+	for ( i32 i = 0; i < options.poolSize; ++i )
+	{
+		if ( pooled[ i ] != alone[ i ] )
+			++mismatches;
+	}
+
+	r64 sceneSteps = r64( options.poolSize ) * r64( options.steps );
+
+	printf( "{\"scene\":\"pool\",\"scenes\":%d,\"threads\":%d,\"steps\":%d,\"ms\":%.2f,\"single_thread_ms\":%.2f,"
+		"\"scene_steps_per_second\":%.0f,\"speedup\":%.2f,\"contacts_per_scene\":%.1f,\"mismatches\":%d}\n",
+		options.poolSize, options.threads, options.steps, msPooled, msAlone,
+		msPooled > 0.0 ? sceneSteps * 1000.0 / msPooled : 0.0, msPooled > 0.0 ? msAlone / msPooled : 0.0,
+		options.poolSize ? contacts / r64( options.poolSize ) : 0.0, mismatches );
+	fflush( stdout );
+
+	return mismatches;
+}
+
+//--------------------------------------------------------------------------------------------------
+static void q3Usage( )
+{
+	fprintf( stderr,
+		"usage: qu3e_bench [--steps n] [--threads n] [--broadphase tree|sap|grid|all]\n"
+		"                  [--iterations n] [--min-iterations n] [--tolerance t] [--relaxation w]\n"
+		"                  [--arena bytes] [--arena-pairs n] [--arena-moves n] [--queries n]\n"
+		"                  [--pool-size n] [--deterministic] [--no-simd] [--save-dir path] [scene ...]\n"
+		"scenes: pyramids rain platforms compound sat solver pool\n" );
+}
+
+//--------------------------------------------------------------------------------------------------
+int main( int argc, char** argv )
+{
+	q3BenchOptions options;
+	options.steps = 300;
+	options.threads = 1;
+	options.iterations = 20;
+	options.minIterations = 20;
+	options.tolerance = r32( 0.0 );
+	options.relaxation = r32( 1.0 );
+	options.arena.bytes = 0;
+	options.arena.pairCapacity = 0;
+	options.arena.moveCapacity = 0;
+	options.queries = 0;
+	options.poolSize = 128;
+	options.deterministic = false;
+	options.simd = true;
+	options.saveDir = Q3_BENCH_SAVE_DIR;
+
+	std::vector<q3BroadPhaseType> broadPhases;
+	std::vector<std::string> names;
+
+	for ( i32 i = 1; i < argc; ++i )
+	{
+		std::string arg = argv[ i ];
+		bool hasValue = i + 1 < argc;
+
+		if ( arg == "--steps" && hasValue )
+			options.steps = atoi( argv[ ++i ] );
+		else if ( arg == "--threads" && hasValue )
+			options.threads = atoi( argv[ ++i ] );
+		else if ( arg == "--iterations" && hasValue )
+			options.iterations = atoi( argv[ ++i ] );
+		else if ( arg == "--min-iterations" && hasValue )
+			options.minIterations = atoi( argv[ ++i ] );
+		else if ( arg == "--tolerance" && hasValue )
+			options.tolerance = r32( atof( argv[ ++i ] ) );
+		else if ( arg == "--relaxation" && hasValue )
+			options.relaxation = r32( atof( argv[ ++i ] ) );
+		else if ( arg == "--arena" && hasValue )
+			options.arena.bytes = atoi( argv[ ++i ] );
+		else if ( arg == "--arena-pairs" && hasValue )
+			options.arena.pairCapacity = atoi( argv[ ++i ] );
+		else if ( arg == "--arena-moves" && hasValue )
+			options.arena.moveCapacity = atoi( argv[ ++i ] );
+		else if ( arg == "--queries" && hasValue )
+			options.queries = atoi( argv[ ++i ] );
+		else if ( arg == "--pool-size" && hasValue )
+			options.poolSize = atoi( argv[ ++i ] );
+		else if ( arg == "--save-dir" && hasValue )
+			options.saveDir = argv[ ++i ];
+		else if ( arg == "--deterministic" )
+			options.deterministic = true;
+		else if ( arg == "--no-simd" )
+			options.simd = false;
+		else if ( arg == "--broadphase" && hasValue )
+		{
+			std::string value = argv[ ++i ];
+
+			for ( i32 type = 0; type < 3; ++type )
+			{
+				if ( value == "all" || value == q3k_broadPhaseNames[ type ] )
+					broadPhases.push_back( q3BroadPhaseType( type ) );
+			}
+
+			if ( broadPhases.empty( ) )
+			{
+				q3Usage( );
+				return 1;
+			}
+		}
+		else if ( arg[ 0 ] == '-' )
+		{
+			q3Usage( );
+			return 1;
+		}
+		else
+			names.push_back( arg );
+	}
+
+	if ( broadPhases.empty( ) )
+		broadPhases.push_back( eBroadPhaseTree );
+
+	if ( names.empty( ) )
+	{
+		for ( const q3BenchScene& scene : q3k_scenes )
+			names.push_back( scene.name );
+	}
+
+	i32 failures = 0;
+
+	for ( const std::string& name : names )
+	{
+		if ( name == "sat" )
+		{
+			failures += q3RunSeparatingAxes( ) ? 1 : 0;
+			continue;
+		}
+
+		if ( name == "solver" )
+		{
+			failures += q3RunSolver( options ) ? 1 : 0;
+			continue;
+		}
+
+		if ( name == "pool" )
+		{
+			failures += q3RunPool( options ) ? 1 : 0;
+			continue;
+		}
+
+		const q3BenchScene* found = NULL;
+		for ( const q3BenchScene& scene : q3k_scenes )
+		{
+			if ( name == scene.name )
+				found = &scene;
+		}
+
+		if ( !found )
+		{
+			fprintf( stderr, "qu3e_bench: unknown scene %s\n", name.c_str( ) );
+			q3Usage( );
+			return 1;
+		}
+
+		for ( q3BroadPhaseType broadPhase : broadPhases )
+			failures += q3RunScene( *found, broadPhase, options );
+	}
+
+	return failures ? 2 : 0;
+}
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -24,17 +26,24 @@
 */
 //--------------------------------------------------------------------------------------------------
 
+#include <algorithm>
+
 #include "q3BroadPhase.h"
 #include "../collision/q3Box.h"
 #include "../common/q3Geometry.h"
 #include "../dynamics/q3ContactManager.h"
+#include "../dynamics/q3Body.h"
 
 //--------------------------------------------------------------------------------------------------
 // q3BroadPhase
 //--------------------------------------------------------------------------------------------------
-q3BroadPhase::q3BroadPhase( q3ContactManager *manager )
+q3BroadPhase::q3BroadPhase( q3ContactManager *manager, q3BroadPhaseType type )
 {
 	m_manager = manager;
+	m_type = type;
+	m_deterministic = false;
+	m_staticIndex = CreateIndex( type );
+	m_dynamicIndex = CreateIndex( type );
 
 	m_pairCount = 0;
 	m_pairCapacity = 64;
@@ -43,11 +52,18 @@ q3BroadPhase::q3BroadPhase( q3ContactManager *manager )
 	m_moveCount = 0;
 	m_moveCapacity = 64;
 	m_moveBuffer = (i32*)q3Alloc( m_moveCapacity * sizeof( i32 ) );
+
+	m_peakPairCount = 0;
+	m_peakMoveCount = 0;
+	m_overflowCount = 0;
+	m_queryVisits = 0;
 }
 
 //--------------------------------------------------------------------------------------------------
 q3BroadPhase::~q3BroadPhase( )
 {
+	DestroyIndex( m_dynamicIndex );
+	DestroyIndex( m_staticIndex );
 	q3Free( m_moveBuffer );
 	q3Free( m_pairBuffer );
 }
@@ -55,97 +71,265 @@ q3BroadPhase::~q3BroadPhase( )
 //--------------------------------------------------------------------------------------------------
 void q3BroadPhase::InsertBox( q3Box *box, const q3AABB& aabb )
 {
-	i32 id = m_tree.Insert( aabb, box );
-	box->broadPhaseIndex = id;
-	BufferMove( id );
+	bool isStatic = (box->body->m_flags & q3Body::eStatic) != 0;
+	q3ProxyIndex *index = isStatic ? m_staticIndex : m_dynamicIndex;
+	i32 key = q3MakeProxyKey( index->Insert( aabb, box ), isStatic );
+	box->broadPhaseIndex = key;
+	BufferMove( key );
 }
 
 //--------------------------------------------------------------------------------------------------
-void q3BroadPhase::RemoveBox( const q3Box *box )
+void q3BroadPhase::InsertBoxes( q3Box **boxes, i32 count )
 {
-	m_tree.Remove( box->broadPhaseIndex );
+	if ( !count )
+		return;
+
+	const q3Body *body = boxes[ 0 ]->body;
+	bool isStatic = (body->m_flags & q3Body::eStatic) != 0;
+	q3ProxyIndex *index = isStatic ? m_staticIndex : m_dynamicIndex;
+
+	// Rebuilding the whole index costs more than a few single inserts
+	if ( count < index->GetProxyCount( ) )
+	{
+		for ( i32 i = 0; i < count; ++i )
+		{
+			q3AABB aabb;
+			boxes[ i ]->ComputeAABB( body->m_tx, &aabb );
+			InsertBox( boxes[ i ], aabb );
+		}
+
+		return;
+	}
+
+	q3AABB *aabbs = (q3AABB *)q3Alloc( (sizeof( q3AABB ) + sizeof( void* ) + sizeof( i32 )) * count );
+	void **userData = (void **)(aabbs + count);
+	i32 *ids = (i32 *)(userData + count);
+
+	for ( i32 i = 0; i < count; ++i )
+	{
+		assert( boxes[ i ]->body == body );
+
+		boxes[ i ]->ComputeAABB( body->m_tx, aabbs + i );
+		userData[ i ] = boxes[ i ];
+	}
+
+	index->Insert( aabbs, userData, count, ids );
+
+	for ( i32 i = 0; i < count; ++i )
+	{
+		i32 key = q3MakeProxyKey( ids[ i ], isStatic );
+		boxes[ i ]->broadPhaseIndex = key;
+		BufferMove( key );
+	}
+
+	q3Free( aabbs );
 }
 
 //--------------------------------------------------------------------------------------------------
-inline bool ContactPairSort( const q3ContactPair& lhs, const q3ContactPair& rhs )
+void q3BroadPhase::RemoveBox( const q3Box *box )
 {
-	if ( lhs.A < rhs.A )
-		return true;
+	i32 key = box->broadPhaseIndex;
+	GetIndex( key )->Remove( q3ProxyKeyId( key ) );
 
-	if ( lhs.A == rhs.A )
-		return lhs.B < rhs.B;
-
-	return false;
+	// The id can be handed out again before the next UpdatePairs
+	for ( i32 i = 0; i < m_moveCount; ++i )
+	{
+		if ( m_moveBuffer[ i ] == key )
+			m_moveBuffer[ i ] = q3k_nullProxyKey;
+	}
 }
 
 //--------------------------------------------------------------------------------------------------
 void q3BroadPhase::UpdatePairs( )
 {
 	m_pairCount = 0;
+	m_peakMoveCount = q3Max( m_peakMoveCount, m_moveCount );
+
+#ifdef Q3_PROFILE
+	m_queryVisits = 0;
+#endif // Q3_PROFILE
 
-	// Query the tree with all moving boxs
+	// Query the indices with all moving boxs
 	for ( i32 i = 0; i < m_moveCount; ++i)
 	{
 		m_currentIndex = m_moveBuffer[ i ];
-		q3AABB aabb = m_tree.GetFatAABB( m_currentIndex );
 
-		// @TODO: Use a static and non-static tree and query one against the other.
-		//        This will potentially prevent (gotta think about this more) time
-		//        wasted with queries of static bodies against static bodies, and
-		//        kinematic to kinematic.
-		m_tree.Query( this, aabb );
+		if ( m_currentIndex == q3k_nullProxyKey )
+			continue;
+
+		q3AABB aabb = GetFatAABB( m_currentIndex );
+
+		// Moving proxies can touch anything, but static proxies only need
+		// to look for non-static neighbours
+		q3KeyCallback<q3BroadPhase> wrapper;
+		wrapper.cb = this;
+		wrapper.visitCount = 0;
+		wrapper.isStatic = false;
+		QueryIndex( m_dynamicIndex, &wrapper, aabb );
+
+		if ( !q3ProxyKeyIsStatic( m_currentIndex ) )
+		{
+			wrapper.isStatic = true;
+			QueryIndex( m_staticIndex, &wrapper, aabb );
+		}
+
+#ifdef Q3_PROFILE
+		m_queryVisits += wrapper.visitCount;
+#endif // Q3_PROFILE
 	}
 
 	// Reset the move buffer
 	m_moveCount = 0;
+	m_peakPairCount = q3Max( m_peakPairCount, m_pairCount );
 
-	// Sort pairs to expose duplicates
-	std::sort( m_pairBuffer, m_pairBuffer + m_pairCount, ContactPairSort );
+	if ( m_deterministic )
+		SortPairs( );
 
-	// Queue manifolds for solving
+	// Queue manifolds for solving. A pair shows up twice when both of its
+	// proxies moved, the contact manager's pair table drops the second.
+	for ( i32 i = 0; i < m_pairCount; ++i )
 	{
-		i32 i = 0;
-		while ( i < m_pairCount )
-		{
-			// Add contact to manager
-			q3ContactPair* pair = m_pairBuffer + i;
-			q3Box *A = (q3Box*)m_tree.GetUserData( pair->A );
-			q3Box *B = (q3Box*)m_tree.GetUserData( pair->B );
-			m_manager->AddContact( A, B );
+		q3ContactPair* pair = m_pairBuffer + i;
+		q3Box *A = (q3Box*)GetUserData( pair->A );
+		q3Box *B = (q3Box*)GetUserData( pair->B );
+		m_manager->AddContact( A, B );
+	}
+
+	m_staticIndex->Validate( );
+	m_dynamicIndex->Validate( );
+}
 
-			++i;
+//--------------------------------------------------------------------------------------------------
+void q3BroadPhase::Update( i32 key, const q3AABB& aabb )
+{
+	if ( GetIndex( key )->Update( q3ProxyKeyId( key ), aabb ) )
+		BufferMove( key );
+}
 
-			// Skip duplicate pairs by iterating i until we find a unique pair
-			while ( i < m_pairCount )
-			{
-				q3ContactPair* potentialDup = m_pairBuffer + i;
+//--------------------------------------------------------------------------------------------------
+void q3BroadPhase::Update( const i32 *keys, const q3AABB *aabbs, i32 count, i32 *ids, bool *moved )
+{
+	if ( !count )
+		return;
 
-				if ( pair->A != potentialDup->A || pair->B != potentialDup->B )
-					break;
+	q3ProxyIndex *index = GetIndex( keys[ 0 ] );
 
-				++i;
-			}
-		}
+	for ( i32 i = 0; i < count; ++i )
+	{
+		assert( GetIndex( keys[ i ] ) == index );
+		ids[ i ] = q3ProxyKeyId( keys[ i ] );
 	}
 
-	m_tree.Validate( );
+	index->Update( ids, aabbs, count, moved );
+
+	for ( i32 i = 0; i < count; ++i )
+	{
+		if ( moved[ i ] )
+			BufferMove( keys[ i ] );
+	}
 }
 
 //--------------------------------------------------------------------------------------------------
-void q3BroadPhase::Update( i32 id, const q3AABB& aabb )
+void q3BroadPhase::SetFatAABB( i32 key, const q3AABB& fatAABB )
 {
-	if ( m_tree.Update( id, aabb ) )
-		BufferMove( id );
+	GetIndex( key )->SetFatAABB( q3ProxyKeyId( key ), fatAABB );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3BroadPhase::SetDeterministic( bool enabled )
+{
+	m_deterministic = enabled;
 }
 
 //--------------------------------------------------------------------------------------------------
 bool q3BroadPhase::TestOverlap( i32 A, i32 B ) const
 {
-	return q3AABBtoAABB( m_tree.GetFatAABB( A ), m_tree.GetFatAABB( B ) );
+	return q3AABBtoAABB( GetFatAABB( A ), GetFatAABB( B ) );
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3BroadPhase::GetStaticProxyCount( ) const
+{
+	return m_staticIndex->GetProxyCount( );
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3BroadPhase::GetDynamicProxyCount( ) const
+{
+	return m_dynamicIndex->GetProxyCount( );
+}
+
+//--------------------------------------------------------------------------------------------------
+q3BroadPhaseType q3BroadPhase::GetType( ) const
+{
+	return m_type;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3BroadPhase::Rebuild( )
+{
+	m_staticIndex->Rebuild( );
+	m_dynamicIndex->Rebuild( );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3BroadPhase::UpdateSnapshots( )
+{
+	m_staticIndex->UpdateSnapshot( );
+	m_dynamicIndex->UpdateSnapshot( );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3BroadPhase::ClearSnapshots( )
+{
+	m_staticIndex->ClearSnapshot( );
+	m_dynamicIndex->ClearSnapshot( );
+}
+
+//--------------------------------------------------------------------------------------------------
+r32 q3BroadPhase::ComputeAverageQueryVisits( ) const
+{
+	i32 staticCount = m_staticIndex->GetProxyCount( );
+	i32 dynamicCount = m_dynamicIndex->GetProxyCount( );
+
+	if ( !(staticCount + dynamicCount) )
+		return r32( 0.0 );
+
+	r32 visits =
+		m_staticIndex->ComputeAverageQueryVisits( ) * r32( staticCount ) +
+		m_dynamicIndex->ComputeAverageQueryVisits( ) * r32( dynamicCount );
+
+	return visits / r32( staticCount + dynamicCount );
 }
 
 //--------------------------------------------------------------------------------------------------
-void q3BroadPhase::BufferMove( i32 id )
+void q3BroadPhase::ReserveBuffers( i32 pairCapacity, i32 moveCapacity )
+{
+	if ( pairCapacity > m_pairCapacity )
+	{
+		q3ContactPair* oldBuffer = m_pairBuffer;
+		m_pairCapacity = pairCapacity;
+		m_pairBuffer = (q3ContactPair*)q3Alloc( m_pairCapacity * sizeof( q3ContactPair ) );
+		memcpy( m_pairBuffer, oldBuffer, m_pairCount * sizeof( q3ContactPair ) );
+		q3Free( oldBuffer );
+	}
+
+	if ( moveCapacity > m_moveCapacity )
+	{
+		i32* oldBuffer = m_moveBuffer;
+		m_moveCapacity = moveCapacity;
+		m_moveBuffer = (i32*)q3Alloc( m_moveCapacity * sizeof( i32 ) );
+		memcpy( m_moveBuffer, oldBuffer, m_moveCount * sizeof( i32 ) );
+		q3Free( oldBuffer );
+	}
+
+	m_peakPairCount = 0;
+	m_peakMoveCount = 0;
+	m_overflowCount = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3BroadPhase::BufferMove( i32 key )
 {
 	if ( m_moveCount == m_moveCapacity )
 	{
@@ -154,7 +338,72 @@ void q3BroadPhase::BufferMove( i32 id )
 		m_moveBuffer = (i32*)q3Alloc( m_moveCapacity * sizeof( i32 ) );
 		memcpy( m_moveBuffer, oldBuffer, m_moveCount * sizeof( i32 ) );
 		q3Free( oldBuffer );
+		++m_overflowCount;
+	}
+
+	m_moveBuffer[ m_moveCount++ ] = key;
+}
+
+//--------------------------------------------------------------------------------------------------
+struct q3PairSerialLess
+{
+	bool operator()( const q3ContactPair& a, const q3ContactPair& b ) const
+	{
+		i32 a0 = ((const q3Box*)bp->GetUserData( a.A ))->serial;
+		i32 b0 = ((const q3Box*)bp->GetUserData( b.A ))->serial;
+
+		if ( a0 != b0 )
+			return a0 < b0;
+
+		return ((const q3Box*)bp->GetUserData( a.B ))->serial < ((const q3Box*)bp->GetUserData( b.B ))->serial;
 	}
 
-	m_moveBuffer[ m_moveCount++ ] = id;
+	const q3BroadPhase *bp;
+};
+
+//--------------------------------------------------------------------------------------------------
+void q3BroadPhase::SortPairs( )
+{
+	// Box A of each pair gets the lower serial, the same pair found twice
+	// ends up next to its copy
+	for ( i32 i = 0; i < m_pairCount; ++i )
+	{
+		q3ContactPair* pair = m_pairBuffer + i;
+		const q3Box *A = (const q3Box*)GetUserData( pair->A );
+		const q3Box *B = (const q3Box*)GetUserData( pair->B );
+
+		if ( B->serial < A->serial )
+		{
+			i32 key = pair->A;
+			pair->A = pair->B;
+			pair->B = key;
+		}
+	}
+
+	q3PairSerialLess less;
+	less.bp = this;
+	std::sort( m_pairBuffer, m_pairBuffer + m_pairCount, less );
+}
+
+//--------------------------------------------------------------------------------------------------
+q3ProxyIndex *q3BroadPhase::CreateIndex( q3BroadPhaseType type )
+{
+	switch ( type )
+	{
+	case eBroadPhaseSweepAndPrune:
+		return new (q3Alloc( sizeof( q3SweepAndPrune ) )) q3SweepAndPrune;
+
+	case eBroadPhaseHashGrid:
+		return new (q3Alloc( sizeof( q3HashGrid ) )) q3HashGrid;
+
+	default:
+		return new (q3Alloc( sizeof( q3DynamicAABBTree ) )) q3DynamicAABBTree;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3BroadPhase::DestroyIndex( q3ProxyIndex *index )
+{
+	index->~q3ProxyIndex( );
+	q3Free( index );
 }
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -28,7 +30,10 @@
 #define Q3BROADPHASE_H
 
 #include "../common/q3Types.h"
+#include "q3ProxyIndex.h"
 #include "q3DynamicAABBTree.h"
+#include "q3SweepAndPrune.h"
+#include "q3HashGrid.h"
 #include "../common/q3Memory.h"
 
 //--------------------------------------------------------------------------------------------------
@@ -45,23 +50,100 @@ struct q3ContactPair
 	i32 B;
 };
 
+// Proxies live in one of two indices. Boxes attached to static bodies go in
+// the static index and everything else goes in the dynamic index, so static
+// geometry is never queried against itself. Proxies are identified by a key
+// holding the proxy id in the owning index, shifted up by one bit, and the
+// static flag in the lowest bit.
+// Key of boxes that are not in the broadphase, see q3Body::BeginShapeEdit
+const i32 q3k_nullProxyKey = -1;
+
+inline i32 q3MakeProxyKey( i32 id, bool isStatic )
+{
+	return (id << 1) | (isStatic ? 1 : 0);
+}
+
+inline i32 q3ProxyKeyId( i32 key )
+{
+	return key >> 1;
+}
+
+inline bool q3ProxyKeyIsStatic( i32 key )
+{
+	return (key & 1) != 0;
+}
+
 class q3BroadPhase
 {
 public:
-	q3BroadPhase( q3ContactManager *manager );
+	// The type selects the q3ProxyIndex implementation used for both indices
+	q3BroadPhase( q3ContactManager *manager, q3BroadPhaseType type );
 	~q3BroadPhase( );
 
 	void InsertBox( q3Box *shape, const q3AABB& aabb );
 	void RemoveBox( const q3Box *shape );
 
+	// Inserts boxes of a single body at once. Batches large enough to at
+	// least double their index go through q3ProxyIndex's bulk insert.
+	void InsertBoxes( q3Box **boxes, i32 count );
+
 	// Generates the contact list. All previous contacts are returned to the allocator
 	// before generation occurs.
 	void UpdatePairs( void );
 
-	void Update( i32 id, const q3AABB& aabb );
+	void Update( i32 key, const q3AABB& aabb );
+
+	// Updates count proxies of the same index at once, see
+	// q3ProxyIndex::Update. ids and moved are scratch for count entries.
+	void Update( const i32 *keys, const q3AABB *aabbs, i32 count, i32 *ids, bool *moved );
+
+	// See q3ProxyIndex::SetFatAABB
+	void SetFatAABB( i32 key, const q3AABB& fatAABB );
+
+	// Queues new pairs in q3Box::serial order instead of the order the index
+	// reports them, so contacts are created the same way for every index
+	// type and proxy id history. Off by default.
+	void SetDeterministic( bool enabled );
 
 	bool TestOverlap( i32 A, i32 B ) const;
 
+	void *GetUserData( i32 key ) const;
+	const q3AABB& GetFatAABB( i32 key ) const;
+
+	// Query both indices. The callback receives proxy keys and can stop the
+	// query by returning false.
+	template <typename T>
+	void Query( T *cb, const q3AABB& aabb ) const;
+	template <typename T>
+	void Query( T *cb, q3RaycastData& rayCast ) const;
+
+	// Batched AABB query over both indices, see q3DynamicAABBTree. scratch
+	// must hold GetBatchScratchSize( count ) integers.
+	template <typename T>
+	void Query( T *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const;
+	i32 GetBatchScratchSize( i32 count ) const;
+
+	i32 GetStaticProxyCount( ) const;
+	i32 GetDynamicProxyCount( ) const;
+	q3BroadPhaseType GetType( ) const;
+
+	// Rebuilds both indices, see q3ProxyIndex::Rebuild
+	void Rebuild( );
+
+	// Updates or frees the query snapshots of both indices, see
+	// q3ProxyIndex::UpdateSnapshot
+	void UpdateSnapshots( );
+	void ClearSnapshots( );
+
+	// Grows the pair and move buffers to at least the given capacities
+	// and clears the peak and overflow counts. Buffers that still have to
+	// grow on their own count as overflows.
+	void ReserveBuffers( i32 pairCapacity, i32 moveCapacity );
+
+	// q3ProxyIndex::ComputeAverageQueryVisits over all proxies of both
+	// indices
+	r32 ComputeAverageQueryVisits( ) const;
+
 private:
 	q3ContactManager *m_manager;
 
@@ -73,16 +155,217 @@ private:
 	i32 m_moveCount;
 	i32 m_moveCapacity;
 
-	q3DynamicAABBTree m_tree;
+	i32 m_peakPairCount;
+	i32 m_peakMoveCount;
+	i32 m_overflowCount;
+
+	i32 m_queryVisits;	// Index nodes visited by the last UpdatePairs, with Q3_PROFILE
+
+	q3BroadPhaseType m_type;
+	bool m_deterministic;
+	q3ProxyIndex *m_staticIndex;
+	q3ProxyIndex *m_dynamicIndex;
 	i32 m_currentIndex;
 
-	void BufferMove( i32 id );
-	bool TreeCallBack( i32 index );
+	// Translates index proxy ids into proxy keys for the callback. These
+	// are handed to the templated queries of the concrete index, so no hit
+	// goes through a virtual call.
+	template <typename T>
+	struct q3KeyCallback
+	{
+		bool TreeCallBack( i32 id )
+		{
+			keepGoing = cb->TreeCallBack( q3MakeProxyKey( id, isStatic ) );
+			return keepGoing;
+		}
+
+		T *cb;
+		bool isStatic;
+		bool keepGoing;
+		i32 visitCount;
+	};
+
+	template <typename T>
+	struct q3KeyBatchCallback
+	{
+		bool TreeCallBack( i32 queryIndex, i32 id )
+		{
+			keepGoing = cb->TreeCallBack( queryIndex, q3MakeProxyKey( id, isStatic ) );
+			return keepGoing;
+		}
+
+		bool IsActive( i32 queryIndex )
+		{
+			return cb->IsActive( queryIndex );
+		}
+
+		T *cb;
+		bool isStatic;
+		bool keepGoing;
+	};
+
+	static q3ProxyIndex *CreateIndex( q3BroadPhaseType type );
+	static void DestroyIndex( q3ProxyIndex *index );
+
+	q3ProxyIndex *GetIndex( i32 key ) const;
+
+	// Run the query on the concrete type of index, chosen once per query
+	// by m_type
+	template <typename T>
+	void QueryIndex( const q3ProxyIndex *index, T *cb, const q3AABB& aabb ) const;
+	template <typename T>
+	void QueryIndex( const q3ProxyIndex *index, T *cb, q3RaycastData& rayCast ) const;
+	template <typename T>
+	void QueryIndex( const q3ProxyIndex *index, T *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const;
+
+	void BufferMove( i32 key );
+	void SortPairs( );
+	bool TreeCallBack( i32 key );
 
-	friend class q3DynamicAABBTree;
 	friend class q3Scene;
 };
 
+//--------------------------------------------------------------------------------------------------
+inline q3ProxyIndex *q3BroadPhase::GetIndex( i32 key ) const
+{
+	return q3ProxyKeyIsStatic( key ) ? m_staticIndex : m_dynamicIndex;
+}
+
+//--------------------------------------------------------------------------------------------------
+inline void *q3BroadPhase::GetUserData( i32 key ) const
+{
+	return GetIndex( key )->GetUserData( q3ProxyKeyId( key ) );
+}
+
+//--------------------------------------------------------------------------------------------------
+inline const q3AABB& q3BroadPhase::GetFatAABB( i32 key ) const
+{
+	return GetIndex( key )->GetFatAABB( q3ProxyKeyId( key ) );
+}
+
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3BroadPhase::QueryIndex( const q3ProxyIndex *index, T *cb, const q3AABB& aabb ) const
+{
+	switch ( m_type )
+	{
+	case eBroadPhaseSweepAndPrune:
+		static_cast<const q3SweepAndPrune *>( index )->Query( cb, aabb );
+		break;
+
+	case eBroadPhaseHashGrid:
+		static_cast<const q3HashGrid *>( index )->Query( cb, aabb );
+		break;
+
+	default:
+		static_cast<const q3DynamicAABBTree *>( index )->Query( cb, aabb );
+		break;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3BroadPhase::QueryIndex( const q3ProxyIndex *index, T *cb, q3RaycastData& rayCast ) const
+{
+	switch ( m_type )
+	{
+	case eBroadPhaseSweepAndPrune:
+		static_cast<const q3SweepAndPrune *>( index )->Query( cb, rayCast );
+		break;
+
+	case eBroadPhaseHashGrid:
+		static_cast<const q3HashGrid *>( index )->Query( cb, rayCast );
+		break;
+
+	default:
+		static_cast<const q3DynamicAABBTree *>( index )->Query( cb, rayCast );
+		break;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3BroadPhase::QueryIndex( const q3ProxyIndex *index, T *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const
+{
+	switch ( m_type )
+	{
+	case eBroadPhaseSweepAndPrune:
+		static_cast<const q3SweepAndPrune *>( index )->Query( cb, aabbs, count, scratch );
+		break;
+
+	case eBroadPhaseHashGrid:
+		static_cast<const q3HashGrid *>( index )->Query( cb, aabbs, count, scratch );
+		break;
+
+	default:
+		static_cast<const q3DynamicAABBTree *>( index )->Query( cb, aabbs, count, scratch );
+		break;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3BroadPhase::Query( T *cb, const q3AABB& aabb ) const
+{
+	q3KeyCallback<T> wrapper;
+	wrapper.cb = cb;
+	wrapper.keepGoing = true;
+	wrapper.visitCount = 0;
+
+	wrapper.isStatic = false;
+	QueryIndex( m_dynamicIndex, &wrapper, aabb );
+
+	if ( !wrapper.keepGoing )
+		return;
+
+	wrapper.isStatic = true;
+	QueryIndex( m_staticIndex, &wrapper, aabb );
+}
+
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3BroadPhase::Query( T *cb, q3RaycastData& rayCast ) const
+{
+	q3KeyCallback<T> wrapper;
+	wrapper.cb = cb;
+	wrapper.keepGoing = true;
+	wrapper.visitCount = 0;
+
+	wrapper.isStatic = false;
+	QueryIndex( m_dynamicIndex, &wrapper, rayCast );
+
+	if ( !wrapper.keepGoing )
+		return;
+
+	wrapper.isStatic = true;
+	QueryIndex( m_staticIndex, &wrapper, rayCast );
+}
+
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3BroadPhase::Query( T *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const
+{
+	q3KeyBatchCallback<T> wrapper;
+	wrapper.cb = cb;
+	wrapper.keepGoing = true;
+
+	wrapper.isStatic = false;
+	QueryIndex( m_dynamicIndex, &wrapper, aabbs, count, scratch );
+
+	if ( !wrapper.keepGoing )
+		return;
+
+	wrapper.isStatic = true;
+	QueryIndex( m_staticIndex, &wrapper, aabbs, count, scratch );
+}
+
+//--------------------------------------------------------------------------------------------------
+inline i32 q3BroadPhase::GetBatchScratchSize( i32 count ) const
+{
+	return q3Max( m_staticIndex->GetBatchScratchSize( count ), m_dynamicIndex->GetBatchScratchSize( count ) );
+}
+
+//--------------------------------------------------------------------------------------------------
 inline bool q3BroadPhase::TreeCallBack( i32 index )
 {
 	// Cannot collide with self
@@ -96,6 +379,7 @@ inline bool q3BroadPhase::TreeCallBack( i32 index )
 		m_pairBuffer = (q3ContactPair*)q3Alloc( m_pairCapacity * sizeof( q3ContactPair ) );
 		memcpy( m_pairBuffer, oldBuffer, m_pairCount * sizeof( q3ContactPair ) );
 		q3Free( oldBuffer );
+		++m_overflowCount;
 	}
 
 	i32 iA = q3Min( index, m_currentIndex );
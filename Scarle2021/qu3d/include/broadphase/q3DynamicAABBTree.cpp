@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -24,21 +26,16 @@
 */
 //--------------------------------------------------------------------------------------------------
 
+#include <stdint.h>
 #include "q3DynamicAABBTree.h"
 #include "../debug/q3Render.h"
 #include "../common/q3Memory.h"
 
 //--------------------------------------------------------------------------------------------------
 // q3DynamicAABBTree
-//--------------------------------------------------------------------------------------------------
-inline void FattenAABB( q3AABB& aabb )
-{
-	const r32 k_fattener = r32( 0.5 );
-	q3Vec3 v( k_fattener, k_fattener, k_fattener );
-
-	aabb.min -= v;
-	aabb.max += v;
-}
+// Number of bins each axis is split into when searching for the best split
+// during Rebuild
+const i32 q3k_sahBinCount = 16;
 
 //--------------------------------------------------------------------------------------------------
 q3DynamicAABBTree::q3DynamicAABBTree( )
@@ -47,15 +44,26 @@ q3DynamicAABBTree::q3DynamicAABBTree( )
 
 	m_capacity = 1024;
 	m_count = 0;
+	m_proxyCount = 0;
 	m_nodes = (Node *)q3Alloc( sizeof( Node ) * m_capacity );
 
 	AddToFreeList( 0 );
+
+	m_snapshotMemory = NULL;
+	m_snapshotNodes = NULL;
+	m_snapshotLeaves = NULL;
+	m_snapshotCapacity = 0;
+	m_snapshotNodeCount = 0;
+	m_snapshotLeafCount = 0;
+	m_snapshotRoot = 0;
+	m_snapshotFresh = false;
 }
 
 //--------------------------------------------------------------------------------------------------
 q3DynamicAABBTree::~q3DynamicAABBTree( )
 {
 	q3Free( m_nodes );
+	q3Free( m_snapshotMemory );
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -65,11 +73,13 @@ i32 q3DynamicAABBTree::Insert( const q3AABB& aabb, void *userData )
 
 	// Fatten AABB and set height/userdata
 	m_nodes[ id ].aabb = aabb;
-	FattenAABB( m_nodes[id].aabb );
+	q3FattenAABB( m_nodes[id].aabb );
 	m_nodes[ id ].userData = userData;
 	m_nodes[ id ].height = 0;
 
 	InsertLeaf( id );
+	++m_proxyCount;
+	m_snapshotFresh = false;
 
 	return id;
 }
@@ -81,6 +91,8 @@ void q3DynamicAABBTree::Remove( i32 id )
 
 	RemoveLeaf( id );
 	DeallocateNode( id );
+	--m_proxyCount;
+	m_snapshotFresh = false;
 }
 
 bool q3DynamicAABBTree::Update( i32 id, const q3AABB& aabb )
@@ -91,16 +103,267 @@ bool q3DynamicAABBTree::Update( i32 id, const q3AABB& aabb )
 	if ( m_nodes[ id ].aabb.Contains( aabb ) )
 		return false;
 
+	q3AABB fatAABB = aabb;
+	q3FattenAABB( fatAABB );
+	SetFatAABB( id, fatAABB );
+
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3DynamicAABBTree::SetFatAABB( i32 id, const q3AABB& fatAABB )
+{
+	assert( id >= 0 && id < m_capacity );
+	assert( m_nodes[ id ].IsLeaf( ) );
+
 	RemoveLeaf( id );
 
-	m_nodes[ id ].aabb = aabb;
-	FattenAABB( m_nodes[ id ].aabb );
+	m_nodes[ id ].aabb = fatAABB;
 
 	InsertLeaf( id );
+	m_snapshotFresh = false;
+}
 
-	return true;
+//--------------------------------------------------------------------------------------------------
+void q3DynamicAABBTree::Update( const i32 *ids, const q3AABB *aabbs, i32 count, bool *moved )
+{
+	// Reinsertions rotate branches, so they go first while the tree is
+	// still whole. A reinserted leaf contains its AABB afterwards.
+	for ( i32 i = 0; i < count; ++i )
+	{
+		i32 id = ids[ i ];
+		assert( id >= 0 && id < m_capacity );
+		assert( m_nodes[ id ].IsLeaf( ) );
+
+		moved[ i ] = !m_nodes[ id ].aabb.Contains( aabbs[ i ] );
+
+		if ( moved[ i ] && !q3AABBtoAABB( m_nodes[ id ].aabb, aabbs[ i ] ) )
+		{
+			q3AABB fatAABB = aabbs[ i ];
+			q3FattenAABB( fatAABB );
+			SetFatAABB( id, fatAABB );
+		}
+	}
+
+	i32 refitCount = 0;
+
+	for ( i32 i = 0; i < count; ++i )
+	{
+		i32 id = ids[ i ];
+
+		if ( moved[ i ] && !m_nodes[ id ].aabb.Contains( aabbs[ i ] ) )
+		{
+			m_nodes[ id ].aabb = aabbs[ i ];
+			q3FattenAABB( m_nodes[ id ].aabb );
+			++refitCount;
+		}
+	}
+
+	if ( !refitCount )
+		return;
+
+	// A branch only changes when one of its children did, so each walk
+	// stops where the ones before it already brought the tree up to date
+	for ( i32 i = 0; i < count; ++i )
+	{
+		i32 id = ids[ i ];
+
+		if ( moved[ i ] && id != m_root )
+			Refit( m_nodes[ id ].parent );
+	}
+
+	m_snapshotFresh = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3DynamicAABBTree::Insert( const q3AABB *aabbs, void **userData, i32 count, i32 *ids )
+{
+	for ( i32 i = 0; i < count; ++i )
+	{
+		i32 id = AllocateNode( );
+
+		m_nodes[ id ].aabb = aabbs[ i ];
+		q3FattenAABB( m_nodes[ id ].aabb );
+		m_nodes[ id ].userData = userData[ i ];
+		m_nodes[ id ].height = 0;
+
+		ids[ i ] = id;
+		++m_proxyCount;
+	}
+
+	Rebuild( );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3DynamicAABBTree::Rebuild( )
+{
+	m_snapshotFresh = false;
+
+	if ( !m_proxyCount )
+		return;
+
+	i32 *leaves = (i32 *)q3Alloc( sizeof( i32 ) * m_proxyCount );
+	i32 leafCount = 0;
+
+	// Keep the leaves, free every branch
+	for ( i32 i = 0; i < m_capacity; ++i )
+	{
+		const Node *n = m_nodes + i;
+
+		if ( n->height == Node::Null )
+			continue;
+
+		if ( n->IsLeaf( ) )
+			leaves[ leafCount++ ] = i;
+		else
+			DeallocateNode( i );
+	}
+
+	assert( leafCount == m_proxyCount );
+
+	m_root = BuildRange( leaves, leafCount );
+	m_nodes[ m_root ].parent = Node::Null;
+
+	q3Free( leaves );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3DynamicAABBTree::UpdateSnapshot( )
+{
+	if ( m_snapshotFresh )
+		return;
+
+	if ( m_proxyCount > m_snapshotCapacity )
+	{
+		q3Free( m_snapshotMemory );
+
+		// Room for twice as many leaves before the next reallocation. The
+		// nodes come first so they can start on a cache line.
+		m_snapshotCapacity = m_proxyCount * 2;
+		i32 nodeBytes = sizeof( SnapshotNode ) * m_snapshotCapacity;
+		m_snapshotMemory = q3Alloc( nodeBytes + sizeof( SnapshotLeaf ) * m_snapshotCapacity + 63 );
+
+		uintptr_t aligned = ((uintptr_t)m_snapshotMemory + 63) & ~(uintptr_t)63;
+		m_snapshotNodes = (SnapshotNode *)aligned;
+		m_snapshotLeaves = (SnapshotLeaf *)(aligned + nodeBytes);
+	}
+
+	m_snapshotNodeCount = 0;
+	m_snapshotLeafCount = 0;
+
+	if ( m_root != Node::Null )
+	{
+		SetBounds( m_nodes[ m_root ].aabb, &m_snapshotBounds );
+		m_snapshotRoot = BuildSnapshot( m_root, m_snapshotBounds );
+	}
+
+	assert( m_snapshotLeafCount == m_proxyCount );
+	m_snapshotFresh = true;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3DynamicAABBTree::ClearSnapshot( )
+{
+	q3Free( m_snapshotMemory );
+	m_snapshotMemory = NULL;
+	m_snapshotNodes = NULL;
+	m_snapshotLeaves = NULL;
+	m_snapshotCapacity = 0;
+	m_snapshotNodeCount = 0;
+	m_snapshotLeafCount = 0;
+	m_snapshotFresh = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool q3DynamicAABBTree::IsSnapshotFresh( ) const
+{
+	return m_snapshotFresh;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3DynamicAABBTree::Quantise( const SnapshotBounds& bounds, const q3AABB& aabb, u16 *min, u16 *max, SnapshotBounds *decoded )
+{
+	for ( i32 i = 0; i < 3; ++i )
+	{
+		r32 extent = bounds.max[ i ] - bounds.min[ i ];
+		r32 lo = r32( 0.0 );
+		r32 hi = r32( 65535.0 );
+
+		if ( extent > r32( 0.0 ) )
+		{
+			r32 toGrid = r32( 65535.0 ) / extent;
+			lo = q3Clamp( r32( 0.0 ), r32( 65535.0 ), std::floor( (aabb.min.v[ i ] - bounds.min[ i ]) * toGrid ) );
+			hi = q3Clamp( r32( 0.0 ), r32( 65535.0 ), std::ceil( (aabb.max.v[ i ] - bounds.min[ i ]) * toGrid ) );
+		}
+
+		min[ i ] = u16( lo );
+		max[ i ] = u16( hi );
+	}
+
+	// Step outwards until the decoded box covers the exact one. The ends of
+	// the range decode to the bounds themselves, so this always stops.
+	// Children are then quantised inside what queries will decode rather
+	// than the exact bounds, which keeps every level conservative.
+	for ( ;; )
+	{
+		Dequantise( bounds, min, max, decoded );
+		bool covered = true;
+
+		for ( i32 i = 0; i < 3; ++i )
+		{
+			if ( decoded->min[ i ] > aabb.min.v[ i ] && min[ i ] > 0 )
+			{
+				--min[ i ];
+				covered = false;
+			}
+
+			if ( decoded->max[ i ] < aabb.max.v[ i ] && max[ i ] < 65535 )
+			{
+				++max[ i ];
+				covered = false;
+			}
+		}
+
+		if ( covered )
+			return;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3DynamicAABBTree::BuildSnapshot( i32 index, const SnapshotBounds& bounds )
+{
+	const Node *n = m_nodes + index;
+
+	if ( n->IsLeaf( ) )
+	{
+		SnapshotLeaf *leaf = m_snapshotLeaves + m_snapshotLeafCount;
+		leaf->aabb = n->aabb;
+		leaf->id = index;
+
+		return ~m_snapshotLeafCount++;
+	}
+
+	// Depth first, so the first child is the next record
+	i32 ref = m_snapshotNodeCount++;
+	i32 children[ 2 ] = { n->right, n->left };
+	SnapshotBounds decoded[ 2 ];
+
+	for ( i32 i = 0; i < 2; ++i )
+	{
+		SnapshotNode *s = m_snapshotNodes + ref;
+		Quantise( bounds, m_nodes[ children[ i ] ].aabb, s->min[ i ], s->max[ i ], decoded + i );
+	}
+
+	for ( i32 i = 0; i < 2; ++i )
+	{
+		i32 child = BuildSnapshot( children[ i ], decoded[ i ] );
+		m_snapshotNodes[ ref ].child[ i ] = child;
+	}
+
+	return ref;
 }
 
+//--------------------------------------------------------------------------------------------------
 void *q3DynamicAABBTree::GetUserData( i32 id ) const
 {
 	assert( id >= 0 && id < m_capacity );
@@ -115,6 +378,63 @@ const q3AABB& q3DynamicAABBTree::GetFatAABB( i32 id ) const
 	return m_nodes[ id ].aabb;
 }
 
+i32 q3DynamicAABBTree::GetProxyCount( ) const
+{
+	return m_proxyCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3DynamicAABBTree::GetHeight( ) const
+{
+	if ( m_root == Node::Null )
+		return 0;
+
+	return m_nodes[ m_root ].height;
+}
+
+//--------------------------------------------------------------------------------------------------
+r32 q3DynamicAABBTree::ComputeAverageQueryVisits( ) const
+{
+	if ( !m_proxyCount )
+		return r32( 0.0 );
+
+	i32 visits = 0;
+
+	for ( i32 i = 0; i < m_capacity; ++i )
+	{
+		const Node *n = m_nodes + i;
+
+		if ( n->height == 0 && n->IsLeaf( ) )
+			visits += CountVisits( n->aabb );
+	}
+
+	return r32( visits ) / r32( m_proxyCount );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3DynamicAABBTree::Query( q3ProxyCallback *cb, const q3AABB& aabb ) const
+{
+	Query< q3ProxyCallback >( cb, aabb );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3DynamicAABBTree::Query( q3ProxyCallback *cb, q3RaycastData& rayCast ) const
+{
+	Query< q3ProxyCallback >( cb, rayCast );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3DynamicAABBTree::Query( q3ProxyBatchCallback *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const
+{
+	Query< q3ProxyBatchCallback >( cb, aabbs, count, scratch );
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3DynamicAABBTree::GetBatchScratchSize( i32 count ) const
+{
+	return count * (GetHeight( ) + 2);
+}
+
 void q3DynamicAABBTree::Render( q3Render *render ) const
 {
 	if ( m_root != Node::Null )
@@ -213,6 +533,171 @@ void q3DynamicAABBTree::ValidateStructure( i32 index ) const
 	ValidateStructure( ir );
 }
 
+//--------------------------------------------------------------------------------------------------
+i32 q3DynamicAABBTree::BuildRange( i32 *leaves, i32 count )
+{
+	if ( count == 1 )
+		return leaves[ 0 ];
+
+	// Bins are laid out over the bounds of the leaf centers, twice the
+	// center is used to save the multiplication
+	q3Vec3 cmin = m_nodes[ leaves[ 0 ] ].aabb.min + m_nodes[ leaves[ 0 ] ].aabb.max;
+	q3Vec3 cmax = cmin;
+
+	for ( i32 i = 1; i < count; ++i )
+	{
+		const q3AABB& aabb = m_nodes[ leaves[ i ] ].aabb;
+		q3Vec3 c = aabb.min + aabb.max;
+		cmin = q3Min( cmin, c );
+		cmax = q3Max( cmax, c );
+	}
+
+	struct Bin
+	{
+		q3AABB aabb;
+		i32 count;
+	};
+
+	r32 bestCost = FLT_MAX;
+	i32 bestAxis = -1;
+	i32 bestSplit = 0;
+
+	for ( i32 axis = 0; axis < 3; ++axis )
+	{
+		r32 extent = cmax[ axis ] - cmin[ axis ];
+
+		if ( extent <= r32( 0.0 ) )
+			continue;
+
+		Bin bins[ q3k_sahBinCount ];
+		r32 scale = r32( q3k_sahBinCount ) / extent;
+
+		for ( i32 i = 0; i < q3k_sahBinCount; ++i )
+			bins[ i ].count = 0;
+
+		for ( i32 i = 0; i < count; ++i )
+		{
+			const q3AABB& aabb = m_nodes[ leaves[ i ] ].aabb;
+			r32 c = aabb.min[ axis ] + aabb.max[ axis ];
+			i32 b = q3Min( (i32)((c - cmin[ axis ]) * scale), q3k_sahBinCount - 1 );
+
+			bins[ b ].aabb = bins[ b ].count ? q3Combine( bins[ b ].aabb, aabb ) : aabb;
+			++bins[ b ].count;
+		}
+
+		// Area and count right of each split, sweeping from the right
+		r32 rightArea[ q3k_sahBinCount ];
+		i32 rightCount[ q3k_sahBinCount ];
+		q3AABB bounds;
+		i32 boundsCount = 0;
+
+		for ( i32 i = q3k_sahBinCount - 1; i > 0; --i )
+		{
+			if ( bins[ i ].count )
+			{
+				bounds = boundsCount ? q3Combine( bounds, bins[ i ].aabb ) : bins[ i ].aabb;
+				boundsCount += bins[ i ].count;
+			}
+
+			rightArea[ i ] = boundsCount ? bounds.SurfaceArea( ) : r32( 0.0 );
+			rightCount[ i ] = boundsCount;
+		}
+
+		boundsCount = 0;
+
+		for ( i32 i = 0; i < q3k_sahBinCount - 1; ++i )
+		{
+			if ( bins[ i ].count )
+			{
+				bounds = boundsCount ? q3Combine( bounds, bins[ i ].aabb ) : bins[ i ].aabb;
+				boundsCount += bins[ i ].count;
+			}
+
+			if ( !boundsCount || !rightCount[ i + 1 ] )
+				continue;
+
+			r32 cost = bounds.SurfaceArea( ) * r32( boundsCount ) + rightArea[ i + 1 ] * r32( rightCount[ i + 1 ] );
+
+			if ( cost < bestCost )
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	// All centers coincide, any split is as good as another
+	i32 mid = count >> 1;
+
+	if ( bestAxis != -1 )
+	{
+		r32 scale = r32( q3k_sahBinCount ) / (cmax[ bestAxis ] - cmin[ bestAxis ]);
+		mid = 0;
+
+		for ( i32 i = 0; i < count; ++i )
+		{
+			const q3AABB& aabb = m_nodes[ leaves[ i ] ].aabb;
+			r32 c = aabb.min[ bestAxis ] + aabb.max[ bestAxis ];
+			i32 b = q3Min( (i32)((c - cmin[ bestAxis ]) * scale), q3k_sahBinCount - 1 );
+
+			if ( b <= bestSplit )
+			{
+				i32 t = leaves[ mid ];
+				leaves[ mid++ ] = leaves[ i ];
+				leaves[ i ] = t;
+			}
+		}
+	}
+
+	i32 left = BuildRange( leaves, mid );
+	i32 right = BuildRange( leaves + mid, count - mid );
+
+	i32 id = AllocateNode( );
+	Node *n = m_nodes + id;
+	n->left = left;
+	n->right = right;
+	n->aabb = q3Combine( m_nodes[ left ].aabb, m_nodes[ right ].aabb );
+	n->height = 1 + q3Max( m_nodes[ left ].height, m_nodes[ right ].height );
+	m_nodes[ left ].parent = id;
+	m_nodes[ right ].parent = id;
+
+	return id;
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3DynamicAABBTree::CountVisits( const q3AABB& aabb ) const
+{
+	const i32 k_stackCapacity = 256;
+	i32 stack[ k_stackCapacity ];
+	i32 sp = 1;
+	i32 visits = 0;
+
+	*stack = m_root;
+
+	while ( sp )
+	{
+		// k_stackCapacity too small
+		assert( sp < k_stackCapacity );
+
+		i32 id = stack[ --sp ];
+
+		if ( id == Node::Null )
+			continue;
+
+		const Node *n = m_nodes + id;
+		++visits;
+
+		if ( !n->IsLeaf( ) && q3AABBtoAABB( aabb, n->aabb ) )
+		{
+			stack[ sp++ ] = n->left;
+			stack[ sp++ ] = n->right;
+		}
+	}
+
+	return visits;
+}
+
 i32 q3DynamicAABBTree::AllocateNode( )
 {
 	if ( m_freeList == Node::Null )
@@ -524,3 +1009,19 @@ void q3DynamicAABBTree::SyncHeirarchy( i32 index )
 		index = m_nodes[ index ].parent;
 	}
 }
+
+//--------------------------------------------------------------------------------------------------
+void q3DynamicAABBTree::Refit( i32 index )
+{
+	while ( index != Node::Null )
+	{
+		Node *n = m_nodes + index;
+		q3AABB aabb = q3Combine( m_nodes[ n->left ].aabb, m_nodes[ n->right ].aabb );
+
+		if ( !memcmp( &aabb, &n->aabb, sizeof( q3AABB ) ) )
+			return;
+
+		n->aabb = aabb;
+		index = n->parent;
+	}
+}
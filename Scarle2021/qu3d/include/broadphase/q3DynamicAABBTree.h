@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -27,8 +29,11 @@
 #ifndef Q3DYNAMICAABBTREE_H
 #define Q3DYNAMICAABBTREE_H
 
-#include "../math/q3Math.h"
-#include "../common/q3Geometry.h"
+#include "q3ProxyIndex.h"
+
+#ifdef Q3_SIMD
+	#include <emmintrin.h>
+#endif // Q3_SIMD
 
 //--------------------------------------------------------------------------------------------------
 // q3DynamicAABBTree
@@ -38,28 +43,78 @@
 // http://www.randygaul.net/2013/08/06/dynamic-aabb-tree/
 class q3Render;
 
-class q3DynamicAABBTree
+class q3DynamicAABBTree : public q3ProxyIndex
 {
 public:
 	q3DynamicAABBTree( );
-	~q3DynamicAABBTree( );
+	virtual ~q3DynamicAABBTree( );
 
 	// Provide tight-AABB
-	i32 Insert( const q3AABB& aabb, void *userData );
-	void Remove( i32 id );
-	bool Update( i32 id, const q3AABB& aabb );
-
-	void *GetUserData( i32 id ) const;
-	const q3AABB& GetFatAABB( i32 id ) const;
+	virtual i32 Insert( const q3AABB& aabb, void *userData );
+	virtual void Remove( i32 id );
+	virtual bool Update( i32 id, const q3AABB& aabb );
+	virtual void SetFatAABB( i32 id, const q3AABB& fatAABB );
+
+	// Adds count leaves at once, then rebuilds the whole tree from all of
+	// its leaves with Rebuild
+	virtual void Insert( const q3AABB *aabbs, void **userData, i32 count, i32 *ids );
+
+	// Leaves whose new AABB left their fat AABB without leaving its
+	// neighbourhood get the new fat AABB in place, and their branches are
+	// refit bottom up once every leaf is written, instead of a remove and
+	// insert each. Leaves that jumped clear of their old fat AABB are
+	// reinserted, as refitting would stretch branches across the gap.
+	virtual void Update( const i32 *ids, const q3AABB *aabbs, i32 count, bool *moved );
+
+	// Throws away every branch and builds the tree again top down, splitting
+	// each node where the binned surface area heuristic is cheapest. The
+	// result no longer depends on the order leaves were inserted in. Leaf
+	// ids are kept. Meant to be called after loading, not every step.
+	virtual void Rebuild( );
+
+	virtual void *GetUserData( i32 id ) const;
+	virtual const q3AABB& GetFatAABB( i32 id ) const;
+	virtual i32 GetProxyCount( ) const;
+	i32 GetHeight( ) const;
 	void Render( q3Render *render ) const;
 
+	// q3ProxyIndex queries, these run the templated queries below
+	virtual void Query( q3ProxyCallback *cb, const q3AABB& aabb ) const;
+	virtual void Query( q3ProxyCallback *cb, q3RaycastData& rayCast ) const;
+	virtual void Query( q3ProxyBatchCallback *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const;
+	virtual i32 GetBatchScratchSize( i32 count ) const;
+
+	virtual r32 ComputeAverageQueryVisits( ) const;
+
+	// Builds a read-only copy of the tree for queries. Its nodes sit in the
+	// order queries walk them, so a node's first child is the next record,
+	// and each 32 byte record holds the bounds of both children quantised
+	// to 16 bits inside the node's own bounds, rounded outwards. Leaves
+	// keep their exact fat AABB, so the copy reports the same proxies in
+	// the same order as the live tree. Any change to the tree makes it
+	// stale, and queries use the live nodes until the next update.
+	virtual void UpdateSnapshot( );
+	virtual void ClearSnapshot( );
+	bool IsSnapshotFresh( ) const;
+
+	// These run on the snapshot while it is fresh, and take callbacks
+	// deriving from, or shaped like, q3ProxyCallback and q3ProxyBatchCallback
 	template <typename T>
 	void Query( T *cb, const q3AABB& aabb ) const;
 	template <typename T>
 	void Query( T *cb, q3RaycastData& rayCast ) const;
 
+	// Walks the tree once for a whole batch of AABBs. Each node filters the
+	// batch entries that reached it down to the ones overlapping it, so
+	// shared upper nodes are only visited once. TreeCallBack( queryIndex,
+	// id ) can stop the whole query by returning false, and entries for
+	// which IsActive( queryIndex ) returns false are dropped from the walk.
+	// scratch must hold count * (GetHeight( ) + 2) integers.
+	template <typename T>
+	void Query( T *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const;
+
 	// For testing
-	void Validate( ) const;
+	virtual void Validate( ) const;
 
 private:
 	struct Node
@@ -98,26 +153,87 @@ private:
 		static const i32 Null = -1;
 	};
 
+	struct SnapshotNode
+	{
+		u16 min[ 2 ][ 3 ];
+		u16 max[ 2 ][ 3 ];
+
+		// Snapshot node index, or ~leaf index. The child the live queries
+		// push last comes first.
+		i32 child[ 2 ];
+	};
+
+	struct SnapshotLeaf
+	{
+		q3AABB aabb;
+		i32 id;
+	};
+
+	// Plain floats for the query stacks, q3Vec3 has no inline constructor.
+	// The fourth lane stays zero.
+	struct SnapshotBounds
+	{
+		r32 min[ 4 ];
+		r32 max[ 4 ];
+	};
+
+	struct SnapshotSegment
+	{
+		r32 d[ 3 ];	// p1 - p0
+		r32 sum[ 3 ];	// p0 + p1
+	};
+
+	template <typename T>
+	void QuerySnapshot( T *cb, const q3AABB& aabb ) const;
+	template <typename T>
+	void QuerySnapshot( T *cb, q3RaycastData& rayCast ) const;
+	template <typename T>
+	void QuerySnapshot( T *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const;
+
+	static inline void SetBounds( const q3AABB& aabb, SnapshotBounds *bounds );
+	static inline void Dequantise( const SnapshotBounds& bounds, const u16 *min, const u16 *max, SnapshotBounds *decoded );
+	static inline bool Overlaps( const SnapshotBounds& a, const SnapshotBounds& b );
+	static inline bool Overlaps( const SnapshotSegment& segment, const SnapshotBounds& bounds );
+	static void Quantise( const SnapshotBounds& bounds, const q3AABB& aabb, u16 *min, u16 *max, SnapshotBounds *decoded );
+	i32 BuildSnapshot( i32 index, const SnapshotBounds& bounds );
+
 	inline i32 AllocateNode( );
 	inline void DeallocateNode( i32 index );
 	i32 Balance( i32 index );
 	void InsertLeaf( i32 index );
 	void RemoveLeaf( i32 index );
 	void ValidateStructure( i32 index ) const;
+	i32 BuildRange( i32 *leaves, i32 count );
+	i32 CountVisits( const q3AABB& aabb ) const;
 	void RenderNode( q3Render *render, i32 index ) const;
 
 	// Correct AABB hierarchy heights and AABBs starting at supplied
 	// index traversing up the heirarchy
 	void SyncHeirarchy( i32 index );
 
+	// Recomputes branch AABBs from index up, stopping at the first branch
+	// that comes out unchanged. No rotations.
+	void Refit( i32 index );
+
 	// Insert nodes at a given index until m_capacity into the free list
 	void AddToFreeList( i32 index );
 
 	i32 m_root;
 	Node *m_nodes;
 	i32 m_count;	// Number of active nodes
+	i32 m_proxyCount;	// Number of leaves
 	i32 m_capacity;	// Max capacity of nodes
 	i32 m_freeList;
+
+	void *m_snapshotMemory;
+	SnapshotNode *m_snapshotNodes;	// Cache line aligned
+	SnapshotLeaf *m_snapshotLeaves;
+	i32 m_snapshotCapacity;	// In leaves
+	i32 m_snapshotNodeCount;
+	i32 m_snapshotLeafCount;
+	i32 m_snapshotRoot;
+	SnapshotBounds m_snapshotBounds;	// Exact bounds of the root
+	bool m_snapshotFresh;
 };
 
 #include "q3DynamicAABBTree.inl"
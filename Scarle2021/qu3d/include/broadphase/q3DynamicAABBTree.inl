@@ -3,6 +3,8 @@
 //
 //	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 //
+//	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+//
 //	This software is provided 'as-is', without any express or implied
 //	warranty. In no event will the authors be held liable for any damages
 //	arising from the use of this software.
@@ -47,10 +49,123 @@ inline void q3DynamicAABBTree::DeallocateNode( i32 index )
 	--m_count;
 }
 
+//--------------------------------------------------------------------------------------------------
+inline void q3DynamicAABBTree::SetBounds( const q3AABB& aabb, SnapshotBounds *bounds )
+{
+	for ( i32 i = 0; i < 3; ++i )
+	{
+		bounds->min[ i ] = aabb.min.v[ i ];
+		bounds->max[ i ] = aabb.max.v[ i ];
+	}
+
+	bounds->min[ 3 ] = r32( 0.0 );
+	bounds->max[ 3 ] = r32( 0.0 );
+}
+
+//--------------------------------------------------------------------------------------------------
+// Both the build and the queries decode through here, so they round alike.
+// The top value maps to the parent's bound exactly, so children touching it
+// stay covered.
+inline void q3DynamicAABBTree::Dequantise( const SnapshotBounds& bounds, const u16 *min, const u16 *max, SnapshotBounds *decoded )
+{
+#ifdef Q3_SIMD
+	// Eight bytes are read from each array, the fourth value belongs to the
+	// next field and lands in the zero lane
+	const __m128i zero = _mm_setzero_si128( );
+	__m128i qMin = _mm_unpacklo_epi16( _mm_loadl_epi64( (const __m128i *)min ), zero );
+	__m128i qMax = _mm_unpacklo_epi16( _mm_loadl_epi64( (const __m128i *)max ), zero );
+
+	__m128 lo = _mm_loadu_ps( bounds.min );
+	__m128 hi = _mm_loadu_ps( bounds.max );
+	__m128 scale = _mm_mul_ps( _mm_sub_ps( hi, lo ), _mm_set1_ps( r32( 1.0 / 65535.0 ) ) );
+	__m128 top = _mm_castsi128_ps( _mm_cmpeq_epi32( qMax, _mm_set1_epi32( 65535 ) ) );
+
+	__m128 dMin = _mm_add_ps( lo, _mm_mul_ps( _mm_cvtepi32_ps( qMin ), scale ) );
+	__m128 dMax = _mm_add_ps( lo, _mm_mul_ps( _mm_cvtepi32_ps( qMax ), scale ) );
+	dMax = _mm_or_ps( _mm_and_ps( top, hi ), _mm_andnot_ps( top, dMax ) );
+
+	_mm_storeu_ps( decoded->min, dMin );
+	_mm_storeu_ps( decoded->max, dMax );
+#else
+	for ( i32 i = 0; i < 3; ++i )
+	{
+		r32 scale = (bounds.max[ i ] - bounds.min[ i ]) * r32( 1.0 / 65535.0 );
+		decoded->min[ i ] = bounds.min[ i ] + r32( min[ i ] ) * scale;
+		decoded->max[ i ] = max[ i ] == 65535 ? bounds.max[ i ] : bounds.min[ i ] + r32( max[ i ] ) * scale;
+	}
+
+	decoded->min[ 3 ] = r32( 0.0 );
+	decoded->max[ 3 ] = r32( 0.0 );
+#endif // Q3_SIMD
+}
+
+//--------------------------------------------------------------------------------------------------
+// Same test as q3AABBtoAABB
+inline bool q3DynamicAABBTree::Overlaps( const SnapshotBounds& a, const SnapshotBounds& b )
+{
+#ifdef Q3_SIMD
+	__m128 apart = _mm_or_ps(
+		_mm_cmplt_ps( _mm_loadu_ps( a.max ), _mm_loadu_ps( b.min ) ),
+		_mm_cmpgt_ps( _mm_loadu_ps( a.min ), _mm_loadu_ps( b.max ) ) );
+
+	return !_mm_movemask_ps( apart );
+#else
+	for ( i32 i = 0; i < 3; ++i )
+	{
+		if ( a.max[ i ] < b.min[ i ] || a.min[ i ] > b.max[ i ] )
+			return false;
+	}
+
+	return true;
+#endif // Q3_SIMD
+}
+
+//--------------------------------------------------------------------------------------------------
+// Same test as q3SegmentToAABB
+inline bool q3DynamicAABBTree::Overlaps( const SnapshotSegment& segment, const SnapshotBounds& bounds )
+{
+	const r32 k_epsilon = r32( 1.0e-6 );
+	const r32 *d = segment.d;
+
+	r32 e[ 3 ];
+	r32 m[ 3 ];
+	r32 ad[ 3 ];
+
+	for ( i32 i = 0; i < 3; ++i )
+	{
+		e[ i ] = bounds.max[ i ] - bounds.min[ i ];
+		m[ i ] = segment.sum[ i ] - bounds.min[ i ] - bounds.max[ i ];
+		ad[ i ] = q3Abs( d[ i ] );
+
+		if ( q3Abs( m[ i ] ) > e[ i ] + ad[ i ] )
+			return false;
+	}
+
+	for ( i32 i = 0; i < 3; ++i )
+		ad[ i ] += k_epsilon;
+
+	if ( q3Abs( m[ 1 ] * d[ 2 ] - m[ 2 ] * d[ 1 ] ) > e[ 1 ] * ad[ 2 ] + e[ 2 ] * ad[ 1 ] )
+		return false;
+
+	if ( q3Abs( m[ 2 ] * d[ 0 ] - m[ 0 ] * d[ 2 ] ) > e[ 0 ] * ad[ 2 ] + e[ 2 ] * ad[ 0 ] )
+		return false;
+
+	if ( q3Abs( m[ 0 ] * d[ 1 ] - m[ 1 ] * d[ 0 ] ) > e[ 0 ] * ad[ 1 ] + e[ 1 ] * ad[ 0 ] )
+		return false;
+
+	return true;
+}
+
 //--------------------------------------------------------------------------------------------------
 template <typename T>
 inline void q3DynamicAABBTree::Query( T *cb, const q3AABB& aabb ) const
 {
+	if ( m_snapshotFresh )
+	{
+		QuerySnapshot( cb, aabb );
+		return;
+	}
+
 	const i32 k_stackCapacity = 256;
 	i32 stack[ k_stackCapacity ];
 	i32 sp = 1;
@@ -64,6 +179,11 @@ inline void q3DynamicAABBTree::Query( T *cb, const q3AABB& aabb ) const
 
 		i32 id = stack[ --sp ];
 
+		if ( id == Node::Null )
+			continue;
+
+		Q3_COUNT_VISIT( cb );
+
 		const Node *n = m_nodes + id;
 		if ( q3AABBtoAABB( aabb, n->aabb ) )
 		{
@@ -81,11 +201,91 @@ inline void q3DynamicAABBTree::Query( T *cb, const q3AABB& aabb ) const
 	}
 }
 
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3DynamicAABBTree::Query( T *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const
+{
+	if ( m_snapshotFresh )
+	{
+		QuerySnapshot( cb, aabbs, count, scratch );
+		return;
+	}
+
+	struct Entry
+	{
+		i32 id;
+		i32 first;	// Batch entries that reached this node live in
+		i32 count;	// scratch[ first, first + count )
+	};
+
+	const i32 k_stackCapacity = 256;
+	Entry stack[ k_stackCapacity ];
+	i32 sp = 1;
+
+	for ( i32 i = 0; i < count; ++i )
+		scratch[ i ] = i;
+
+	stack->id = m_root;
+	stack->first = 0;
+	stack->count = count;
+
+	while ( sp )
+	{
+		// k_stackCapacity too small
+		assert( sp < k_stackCapacity );
+
+		Entry e = stack[ --sp ];
+
+		if ( e.id == Node::Null )
+			continue;
+
+		// Lists above the popped one belonged to subtrees that are done
+		i32 top = e.first + e.count;
+		const Node *n = m_nodes + e.id;
+		i32 filtered = 0;
+
+		for ( i32 i = 0; i < e.count; ++i )
+		{
+			i32 queryIndex = scratch[ e.first + i ];
+
+			if ( cb->IsActive( queryIndex ) && q3AABBtoAABB( aabbs[ queryIndex ], n->aabb ) )
+				scratch[ top + filtered++ ] = queryIndex;
+		}
+
+		if ( !filtered )
+			continue;
+
+		if ( n->IsLeaf( ) )
+		{
+			for ( i32 i = 0; i < filtered; ++i )
+			{
+				if ( !cb->TreeCallBack( scratch[ top + i ], e.id ) )
+					return;
+			}
+		}
+
+		else
+		{
+			stack[ sp ].id = n->right;
+			stack[ sp ].first = top;
+			stack[ sp++ ].count = filtered;
+			stack[ sp ].id = n->left;
+			stack[ sp ].first = top;
+			stack[ sp++ ].count = filtered;
+		}
+	}
+}
+
 //--------------------------------------------------------------------------------------------------
 template <typename T>
 void q3DynamicAABBTree::Query( T *cb, q3RaycastData& rayCast ) const
 {
-	const r32 k_epsilon = r32( 1.0e-6 );
+	if ( m_snapshotFresh )
+	{
+		QuerySnapshot( cb, rayCast );
+		return;
+	}
+
 	const i32 k_stackCapacity = 256;
 	i32 stack[ k_stackCapacity ];
 	i32 sp = 1;
@@ -105,50 +305,239 @@ void q3DynamicAABBTree::Query( T *cb, q3RaycastData& rayCast ) const
 		if ( id == Node::Null )
 			continue;
 
+		Q3_COUNT_VISIT( cb );
+
 		const Node *n = m_nodes + id;
 
-		q3Vec3 e = n->aabb.max - n->aabb.min;
-		q3Vec3 d = p1 - p0;
-		q3Vec3 m = p0 + p1 - n->aabb.min - n->aabb.max;
+		if ( !q3SegmentToAABB( p0, p1, n->aabb ) )
+			continue;
 
-		r32 adx = q3Abs( d.x );
+		if ( n->IsLeaf( ) )
+		{
+			if ( !cb->TreeCallBack( id ) )
+				return;
+		}
 
-		if ( q3Abs( m.x ) > e.x + adx )
-			continue;
+		else
+		{
+			stack[ sp++ ] = n->left;
+			stack[ sp++ ] = n->right;
+		}
+	}
+}
 
-		r32 ady = q3Abs( d.y );
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3DynamicAABBTree::QuerySnapshot( T *cb, const q3AABB& aabb ) const
+{
+	struct Entry
+	{
+		SnapshotBounds bounds;
+		i32 ref;
+	};
 
-		if ( q3Abs( m.y ) > e.y + ady )
-			continue;
+	const i32 k_stackCapacity = 256;
+	Entry stack[ k_stackCapacity ];
+	i32 sp = 1;
 
-		r32 adz = q3Abs( d.z );
+	SnapshotBounds query;
+	SetBounds( aabb, &query );
 
-		if ( q3Abs( m.z ) > e.z + adz )
-			continue;
+	if ( !m_snapshotLeafCount || !Overlaps( query, m_snapshotBounds ) )
+		return;
+
+	stack->bounds = m_snapshotBounds;
+	stack->ref = m_snapshotRoot;
 
-		adx += k_epsilon;
-		ady += k_epsilon;
-		adz += k_epsilon;
+	while ( sp )
+	{
+		// k_stackCapacity too small
+		assert( sp + 2 <= k_stackCapacity );
+
+		Entry e = stack[ --sp ];
+
+		Q3_COUNT_VISIT( cb );
+
+		if ( e.ref < 0 )
+		{
+			const SnapshotLeaf *leaf = m_snapshotLeaves + ~e.ref;
+
+			if ( q3AABBtoAABB( aabb, leaf->aabb ) && !cb->TreeCallBack( leaf->id ) )
+				return;
 
-		if( q3Abs( m.y * d.z - m.z * d.y) > e.y * adz + e.z * ady )
 			continue;
+		}
+
+		// Both children are tested before either is walked, the first one
+		// goes on top of the stack
+		const SnapshotNode *n = m_snapshotNodes + e.ref;
+
+		for ( i32 i = 1; i >= 0; --i )
+		{
+			Entry *child = stack + sp;
+			Dequantise( e.bounds, n->min[ i ], n->max[ i ], &child->bounds );
+
+			if ( Overlaps( query, child->bounds ) )
+			{
+				child->ref = n->child[ i ];
+				++sp;
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3DynamicAABBTree::QuerySnapshot( T *cb, q3RaycastData& rayCast ) const
+{
+	struct Entry
+	{
+		SnapshotBounds bounds;
+		i32 ref;
+	};
+
+	const i32 k_stackCapacity = 256;
+	Entry stack[ k_stackCapacity ];
+	i32 sp = 1;
+
+	q3Vec3 p0 = rayCast.start;
+	q3Vec3 p1 = p0 + rayCast.dir * rayCast.t;
+
+	SnapshotSegment segment;
+
+	for ( i32 i = 0; i < 3; ++i )
+	{
+		segment.d[ i ] = p1.v[ i ] - p0.v[ i ];
+		segment.sum[ i ] = p0.v[ i ] + p1.v[ i ];
+	}
+
+	if ( !m_snapshotLeafCount || !Overlaps( segment, m_snapshotBounds ) )
+		return;
+
+	stack->bounds = m_snapshotBounds;
+	stack->ref = m_snapshotRoot;
+
+	while ( sp )
+	{
+		// k_stackCapacity too small
+		assert( sp + 2 <= k_stackCapacity );
+
+		Entry e = stack[ --sp ];
+
+		Q3_COUNT_VISIT( cb );
+
+		if ( e.ref < 0 )
+		{
+			const SnapshotLeaf *leaf = m_snapshotLeaves + ~e.ref;
+
+			if ( q3SegmentToAABB( p0, p1, leaf->aabb ) && !cb->TreeCallBack( leaf->id ) )
+				return;
 
-		if( q3Abs( m.z * d.x - m.x * d.z) > e.x * adz + e.z * adx )
 			continue;
+		}
+
+		const SnapshotNode *n = m_snapshotNodes + e.ref;
+
+		for ( i32 i = 1; i >= 0; --i )
+		{
+			Entry *child = stack + sp;
+			Dequantise( e.bounds, n->min[ i ], n->max[ i ], &child->bounds );
+
+			if ( Overlaps( segment, child->bounds ) )
+			{
+				child->ref = n->child[ i ];
+				++sp;
+			}
+		}
+	}
+}
 
-		if ( q3Abs( m.x * d.y - m.y * d.x) > e.x * ady + e.y * adx )
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3DynamicAABBTree::QuerySnapshot( T *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const
+{
+	struct Entry
+	{
+		SnapshotBounds bounds;
+		i32 ref;
+		i32 first;
+		i32 count;
+	};
+
+	const i32 k_stackCapacity = 256;
+	Entry stack[ k_stackCapacity ];
+	i32 sp = 1;
+
+	if ( !m_snapshotLeafCount )
+		return;
+
+	for ( i32 i = 0; i < count; ++i )
+		scratch[ i ] = i;
+
+	stack->bounds = m_snapshotBounds;
+	stack->ref = m_snapshotRoot;
+	stack->first = 0;
+	stack->count = count;
+
+	while ( sp )
+	{
+		// k_stackCapacity too small
+		assert( sp + 2 <= k_stackCapacity );
+
+		Entry e = stack[ --sp ];
+		const SnapshotLeaf *leaf = e.ref < 0 ? m_snapshotLeaves + ~e.ref : NULL;
+
+		// Lists above the popped one belonged to subtrees that are done
+		i32 top = e.first + e.count;
+		i32 filtered = 0;
+
+		for ( i32 i = 0; i < e.count; ++i )
+		{
+			i32 queryIndex = scratch[ e.first + i ];
+
+			if ( !cb->IsActive( queryIndex ) )
+				continue;
+
+			bool overlaps;
+
+			if ( leaf )
+				overlaps = q3AABBtoAABB( aabbs[ queryIndex ], leaf->aabb );
+
+			else
+			{
+				SnapshotBounds query;
+				SetBounds( aabbs[ queryIndex ], &query );
+				overlaps = Overlaps( query, e.bounds );
+			}
+
+			if ( overlaps )
+				scratch[ top + filtered++ ] = queryIndex;
+		}
+
+		if ( !filtered )
 			continue;
 
-		if ( n->IsLeaf( ) )
+		if ( leaf )
 		{
-			if ( !cb->TreeCallBack( id ) )
-				return;
+			for ( i32 i = 0; i < filtered; ++i )
+			{
+				if ( !cb->TreeCallBack( scratch[ top + i ], leaf->id ) )
+					return;
+			}
 		}
 
 		else
 		{
-			stack[ sp++ ] = n->left;
-			stack[ sp++ ] = n->right;
+			// The live walk takes the left child first
+			const SnapshotNode *n = m_snapshotNodes + e.ref;
+
+			for ( i32 i = 0; i < 2; ++i )
+			{
+				Dequantise( e.bounds, n->min[ i ], n->max[ i ], &stack[ sp ].bounds );
+				stack[ sp ].ref = n->child[ i ];
+				stack[ sp ].first = top;
+				stack[ sp++ ].count = filtered;
+			}
 		}
 	}
 }
@@ -0,0 +1,492 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3HashGrid.cpp
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#include "q3HashGrid.h"
+#include "../common/q3Memory.h"
+
+//--------------------------------------------------------------------------------------------------
+// q3HashGrid
+//--------------------------------------------------------------------------------------------------
+// Proxies touching more cells than this go to the large list
+const i32 q3k_maxProxyCells = 256;
+
+//--------------------------------------------------------------------------------------------------
+inline i32 q3CellCoord( r32 x, r32 invCellSize )
+{
+	// Keeps cell coordinates far away from integer overflow
+	const r32 k_limit = r32( 1 << 20 );
+
+	return (i32)std::floor( q3Clamp( -k_limit, k_limit, x * invCellSize ) );
+}
+
+//--------------------------------------------------------------------------------------------------
+q3HashGrid::q3HashGrid( r32 cellSize )
+{
+	m_cellSize = cellSize;
+	m_invCellSize = r32( 1.0 ) / cellSize;
+
+	m_proxies = NULL;
+	m_capacity = 0;
+	m_freeList = Proxy::Null;
+	m_proxyCount = 0;
+
+	m_entries = NULL;
+	m_entryCapacity = 0;
+	m_entryFreeList = Proxy::Null;
+	m_entryCount = 0;
+
+	m_buckets = NULL;
+	m_bucketCount = 0;
+	Rehash( 1024 );
+
+	m_largeCount = 0;
+	m_largeCapacity = 16;
+	m_large = (i32 *)q3Alloc( sizeof( i32 ) * m_largeCapacity );
+}
+
+//--------------------------------------------------------------------------------------------------
+q3HashGrid::~q3HashGrid( )
+{
+	q3Free( m_large );
+	q3Free( m_buckets );
+	q3Free( m_entries );
+	q3Free( m_proxies );
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3HashGrid::Insert( const q3AABB& aabb, void *userData )
+{
+	i32 id = AllocateProxy( );
+	Proxy *p = m_proxies + id;
+
+	p->aabb = aabb;
+	q3FattenAABB( p->aabb );
+	p->userData = userData;
+	p->largeSlot = Proxy::Null;
+	p->used = true;
+	ComputeCells( p->aabb, &p->cells );
+
+	Link( id );
+	++m_proxyCount;
+
+	return id;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3HashGrid::Remove( i32 id )
+{
+	assert( id >= 0 && id < m_capacity );
+	assert( m_proxies[ id ].used );
+
+	Unlink( id );
+
+	Proxy *p = m_proxies + id;
+	p->used = false;
+	p->next = m_freeList;
+	m_freeList = id;
+	--m_proxyCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool q3HashGrid::Update( i32 id, const q3AABB& aabb )
+{
+	assert( id >= 0 && id < m_capacity );
+	assert( m_proxies[ id ].used );
+
+	Proxy *p = m_proxies + id;
+
+	if ( p->aabb.Contains( aabb ) )
+		return false;
+
+	q3AABB fatAABB = aabb;
+	q3FattenAABB( fatAABB );
+	SetFatAABB( id, fatAABB );
+
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3HashGrid::SetFatAABB( i32 id, const q3AABB& fatAABB )
+{
+	assert( id >= 0 && id < m_capacity );
+	assert( m_proxies[ id ].used );
+
+	Proxy *p = m_proxies + id;
+
+	CellRange cells;
+	ComputeCells( fatAABB, &cells );
+
+	// Most moves stay within the same cells
+	if ( memcmp( &cells, &p->cells, sizeof( CellRange ) ) )
+	{
+		Unlink( id );
+		p->cells = cells;
+		Link( id );
+	}
+
+	p->aabb = fatAABB;
+}
+
+//--------------------------------------------------------------------------------------------------
+void *q3HashGrid::GetUserData( i32 id ) const
+{
+	assert( id >= 0 && id < m_capacity );
+
+	return m_proxies[ id ].userData;
+}
+
+//--------------------------------------------------------------------------------------------------
+const q3AABB& q3HashGrid::GetFatAABB( i32 id ) const
+{
+	assert( id >= 0 && id < m_capacity );
+
+	return m_proxies[ id ].aabb;
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3HashGrid::GetProxyCount( ) const
+{
+	return m_proxyCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3HashGrid::Query( q3ProxyCallback *cb, const q3AABB& aabb ) const
+{
+	Query< q3ProxyCallback >( cb, aabb );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3HashGrid::Query( q3ProxyCallback *cb, q3RaycastData& rayCast ) const
+{
+	Query< q3ProxyCallback >( cb, rayCast );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3HashGrid::Query( q3ProxyBatchCallback *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const
+{
+	Query< q3ProxyBatchCallback >( cb, aabbs, count, scratch );
+}
+
+//--------------------------------------------------------------------------------------------------
+r32 q3HashGrid::ComputeAverageQueryVisits( ) const
+{
+	if ( !m_proxyCount )
+		return r32( 0.0 );
+
+	i32 visits = 0;
+
+	for ( i32 id = 0; id < m_capacity; ++id )
+	{
+		if ( m_proxies[ id ].used )
+			visits += CountVisits( m_proxies[ id ].aabb );
+	}
+
+	return r32( visits ) / r32( m_proxyCount );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3HashGrid::Validate( ) const
+{
+	i32 proxyCount = 0;
+	i32 cellCount = 0;
+
+	for ( i32 id = 0; id < m_capacity; ++id )
+	{
+		const Proxy *p = m_proxies + id;
+
+		if ( !p->used )
+			continue;
+
+		++proxyCount;
+
+		if ( p->largeSlot != Proxy::Null )
+		{
+			assert( m_large[ p->largeSlot ] == id );
+			continue;
+		}
+
+		cellCount +=
+			(p->cells.max[ 0 ] - p->cells.min[ 0 ] + 1) *
+			(p->cells.max[ 1 ] - p->cells.min[ 1 ] + 1) *
+			(p->cells.max[ 2 ] - p->cells.min[ 2 ] + 1);
+	}
+
+	i32 entryCount = 0;
+
+	for ( i32 i = 0; i < m_bucketCount; ++i )
+	{
+		for ( i32 index = m_buckets[ i ]; index != Proxy::Null; index = m_entries[ index ].next )
+		{
+			const Entry *e = m_entries + index;
+
+			assert( e->proxy != Proxy::Null );
+			assert( Hash( e->x, e->y, e->z ) == i );
+			++entryCount;
+
+			Q3_UNUSED( e );
+		}
+	}
+
+	assert( proxyCount == m_proxyCount );
+	assert( cellCount == m_entryCount );
+	assert( entryCount == m_entryCount );
+
+	Q3_UNUSED( proxyCount );
+	Q3_UNUSED( cellCount );
+	Q3_UNUSED( entryCount );
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3HashGrid::AllocateProxy( )
+{
+	if ( m_freeList == Proxy::Null )
+	{
+		i32 capacity = m_capacity ? m_capacity * 2 : 256;
+		Proxy *proxies = (Proxy *)q3Alloc( sizeof( Proxy ) * capacity );
+
+		if ( m_capacity )
+			memcpy( proxies, m_proxies, sizeof( Proxy ) * m_capacity );
+
+		q3Free( m_proxies );
+		m_proxies = proxies;
+
+		for ( i32 i = m_capacity; i < capacity; ++i )
+		{
+			m_proxies[ i ].used = false;
+			m_proxies[ i ].next = i + 1 < capacity ? i + 1 : Proxy::Null;
+		}
+
+		m_freeList = m_capacity;
+		m_capacity = capacity;
+	}
+
+	i32 id = m_freeList;
+	m_freeList = m_proxies[ id ].next;
+
+	return id;
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3HashGrid::AllocateEntry( )
+{
+	if ( m_entryFreeList == Proxy::Null )
+	{
+		i32 capacity = m_entryCapacity ? m_entryCapacity * 2 : 1024;
+		Entry *entries = (Entry *)q3Alloc( sizeof( Entry ) * capacity );
+
+		if ( m_entryCapacity )
+			memcpy( entries, m_entries, sizeof( Entry ) * m_entryCapacity );
+
+		q3Free( m_entries );
+		m_entries = entries;
+
+		for ( i32 i = m_entryCapacity; i < capacity; ++i )
+		{
+			m_entries[ i ].proxy = Proxy::Null;
+			m_entries[ i ].next = i + 1 < capacity ? i + 1 : Proxy::Null;
+		}
+
+		m_entryFreeList = m_entryCapacity;
+		m_entryCapacity = capacity;
+	}
+
+	i32 index = m_entryFreeList;
+	m_entryFreeList = m_entries[ index ].next;
+
+	return index;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3HashGrid::Link( i32 id )
+{
+	Proxy *p = m_proxies + id;
+	const CellRange& cells = p->cells;
+
+	i32 cellCount =
+		(cells.max[ 0 ] - cells.min[ 0 ] + 1) *
+		(cells.max[ 1 ] - cells.min[ 1 ] + 1) *
+		(cells.max[ 2 ] - cells.min[ 2 ] + 1);
+
+	// Also guards the product against overflow for huge AABBs
+	bool large = cells.max[ 0 ] - cells.min[ 0 ] >= q3k_maxProxyCells ||
+		cells.max[ 1 ] - cells.min[ 1 ] >= q3k_maxProxyCells ||
+		cells.max[ 2 ] - cells.min[ 2 ] >= q3k_maxProxyCells;
+
+	if ( large || cellCount > q3k_maxProxyCells )
+	{
+		if ( m_largeCount == m_largeCapacity )
+		{
+			i32 *oldLarge = m_large;
+			m_largeCapacity *= 2;
+			m_large = (i32 *)q3Alloc( sizeof( i32 ) * m_largeCapacity );
+			memcpy( m_large, oldLarge, sizeof( i32 ) * m_largeCount );
+			q3Free( oldLarge );
+		}
+
+		p->largeSlot = m_largeCount;
+		m_large[ m_largeCount++ ] = id;
+		return;
+	}
+
+	for ( i32 x = cells.min[ 0 ]; x <= cells.max[ 0 ]; ++x )
+	{
+		for ( i32 y = cells.min[ 1 ]; y <= cells.max[ 1 ]; ++y )
+		{
+			for ( i32 z = cells.min[ 2 ]; z <= cells.max[ 2 ]; ++z )
+			{
+				i32 index = AllocateEntry( );
+				Entry *e = m_entries + index;
+				i32 bucket = Hash( x, y, z );
+
+				e->x = x;
+				e->y = y;
+				e->z = z;
+				e->proxy = id;
+				e->next = m_buckets[ bucket ];
+				m_buckets[ bucket ] = index;
+			}
+		}
+	}
+
+	m_entryCount += cellCount;
+
+	if ( m_entryCount > m_bucketCount * 2 )
+		Rehash( m_bucketCount * 2 );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3HashGrid::Unlink( i32 id )
+{
+	Proxy *p = m_proxies + id;
+
+	if ( p->largeSlot != Proxy::Null )
+	{
+		i32 last = m_large[ --m_largeCount ];
+		m_large[ p->largeSlot ] = last;
+		m_proxies[ last ].largeSlot = p->largeSlot;
+		p->largeSlot = Proxy::Null;
+		return;
+	}
+
+	const CellRange& cells = p->cells;
+
+	for ( i32 x = cells.min[ 0 ]; x <= cells.max[ 0 ]; ++x )
+	{
+		for ( i32 y = cells.min[ 1 ]; y <= cells.max[ 1 ]; ++y )
+		{
+			for ( i32 z = cells.min[ 2 ]; z <= cells.max[ 2 ]; ++z )
+			{
+				i32 *link = m_buckets + Hash( x, y, z );
+
+				while ( *link != Proxy::Null )
+				{
+					i32 index = *link;
+					Entry *e = m_entries + index;
+
+					if ( e->proxy == id && e->x == x && e->y == y && e->z == z )
+					{
+						*link = e->next;
+						e->proxy = Proxy::Null;
+						e->next = m_entryFreeList;
+						m_entryFreeList = index;
+						--m_entryCount;
+						break;
+					}
+
+					link = &e->next;
+				}
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3HashGrid::Rehash( i32 bucketCount )
+{
+	q3Free( m_buckets );
+	m_bucketCount = bucketCount;
+	m_buckets = (i32 *)q3Alloc( sizeof( i32 ) * m_bucketCount );
+
+	for ( i32 i = 0; i < m_bucketCount; ++i )
+		m_buckets[ i ] = Proxy::Null;
+
+	for ( i32 i = 0; i < m_entryCapacity; ++i )
+	{
+		Entry *e = m_entries + i;
+
+		if ( e->proxy == Proxy::Null )
+			continue;
+
+		i32 bucket = Hash( e->x, e->y, e->z );
+		e->next = m_buckets[ bucket ];
+		m_buckets[ bucket ] = i;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Mirrors QueryCells, counting the proxies and cell entries it looks at
+i32 q3HashGrid::CountVisits( const q3AABB& aabb ) const
+{
+	CellRange range;
+	ComputeCells( aabb, &range );
+
+	r32 cellCount =
+		r32( range.max[ 0 ] - range.min[ 0 ] + 1 ) *
+		r32( range.max[ 1 ] - range.min[ 1 ] + 1 ) *
+		r32( range.max[ 2 ] - range.min[ 2 ] + 1 );
+
+	if ( cellCount > r32( m_proxyCount ) )
+		return m_largeCount + m_capacity;
+
+	i32 visits = m_largeCount;
+
+	for ( i32 x = range.min[ 0 ]; x <= range.max[ 0 ]; ++x )
+	{
+		for ( i32 y = range.min[ 1 ]; y <= range.max[ 1 ]; ++y )
+		{
+			for ( i32 z = range.min[ 2 ]; z <= range.max[ 2 ]; ++z )
+			{
+				for ( i32 index = m_buckets[ Hash( x, y, z ) ]; index != Proxy::Null; index = m_entries[ index ].next )
+					++visits;
+			}
+		}
+	}
+
+	return visits;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3HashGrid::ComputeCells( const q3AABB& aabb, CellRange *cells ) const
+{
+	cells->min[ 0 ] = q3CellCoord( aabb.min.x, m_invCellSize );
+	cells->min[ 1 ] = q3CellCoord( aabb.min.y, m_invCellSize );
+	cells->min[ 2 ] = q3CellCoord( aabb.min.z, m_invCellSize );
+	cells->max[ 0 ] = q3CellCoord( aabb.max.x, m_invCellSize );
+	cells->max[ 1 ] = q3CellCoord( aabb.max.y, m_invCellSize );
+	cells->max[ 2 ] = q3CellCoord( aabb.max.z, m_invCellSize );
+}
@@ -0,0 +1,144 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3HashGrid.h
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#ifndef Q3HASHGRID_H
+#define Q3HASHGRID_H
+
+#include "q3ProxyIndex.h"
+
+//--------------------------------------------------------------------------------------------------
+// q3HashGrid
+//--------------------------------------------------------------------------------------------------
+// Uniform grid of cubic cells, stored sparsely in a hash table so the world
+// has no bounds. Every proxy is linked into each cell its fat AABB touches.
+// A query visits the cells of its AABB and reports a proxy only from the
+// first cell the two have in common, so nothing is reported twice and
+// queries stay free of per-proxy marks. Proxies that would touch too many
+// cells are kept in a separate list that every query checks.
+class q3HashGrid : public q3ProxyIndex
+{
+public:
+	q3HashGrid( r32 cellSize = r32( 16.0 ) );
+	virtual ~q3HashGrid( );
+
+	virtual i32 Insert( const q3AABB& aabb, void *userData );
+	virtual void Remove( i32 id );
+	virtual bool Update( i32 id, const q3AABB& aabb );
+	virtual void SetFatAABB( i32 id, const q3AABB& fatAABB );
+
+	virtual void *GetUserData( i32 id ) const;
+	virtual const q3AABB& GetFatAABB( i32 id ) const;
+	virtual i32 GetProxyCount( ) const;
+
+	// q3ProxyIndex queries, these run the templated queries below
+	virtual void Query( q3ProxyCallback *cb, const q3AABB& aabb ) const;
+	virtual void Query( q3ProxyCallback *cb, q3RaycastData& rayCast ) const;
+	virtual void Query( q3ProxyBatchCallback *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const;
+
+	// Take callbacks deriving from, or shaped like, q3ProxyCallback and
+	// q3ProxyBatchCallback. A batch runs one query per entry.
+	template <typename T>
+	void Query( T *cb, const q3AABB& aabb ) const;
+	template <typename T>
+	void Query( T *cb, q3RaycastData& rayCast ) const;
+	template <typename T>
+	void Query( T *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const;
+
+	virtual r32 ComputeAverageQueryVisits( ) const;
+
+	virtual void Validate( ) const;
+
+private:
+	// Inclusive range of cell coordinates
+	struct CellRange
+	{
+		i32 min[ 3 ];
+		i32 max[ 3 ];
+	};
+
+	struct Proxy
+	{
+		q3AABB aabb;
+		void *userData;
+		CellRange cells;
+
+		// Index into m_large, or Null when linked into the cells
+		i32 largeSlot;
+		i32 next; // free list
+		bool used;
+
+		static const i32 Null = -1;
+	};
+
+	// Links one proxy into one cell
+	struct Entry
+	{
+		i32 x;
+		i32 y;
+		i32 z;
+		i32 proxy; // Null for free entries
+		i32 next; // bucket chain or free list
+	};
+
+	i32 AllocateProxy( );
+	i32 AllocateEntry( );
+	void Link( i32 id );
+	void Unlink( i32 id );
+	void Rehash( i32 bucketCount );
+	void ComputeCells( const q3AABB& aabb, CellRange *cells ) const;
+	inline i32 Hash( i32 x, i32 y, i32 z ) const;
+
+	i32 CountVisits( const q3AABB& aabb ) const;
+
+	template <typename T, typename Test>
+	void QueryCells( T *cb, const q3AABB& bounds, const Test& test ) const;
+
+	r32 m_cellSize;
+	r32 m_invCellSize;
+
+	Proxy *m_proxies;
+	i32 m_capacity;
+	i32 m_freeList;
+	i32 m_proxyCount;
+
+	Entry *m_entries;
+	i32 m_entryCapacity;
+	i32 m_entryFreeList;
+	i32 m_entryCount;
+
+	i32 *m_buckets;
+	i32 m_bucketCount; // Power of two
+
+	i32 *m_large;
+	i32 m_largeCount;
+	i32 m_largeCapacity;
+};
+
+#include "q3HashGrid.inl"
+
+#endif // Q3HASHGRID_H
@@ -0,0 +1,173 @@
+//--------------------------------------------------------------------------------------------------
+// q3HashGrid.inl
+//
+//	Written for the Scarle2021 fork of qu3e, this file is not part of the
+//	original qu3e by Randy Gaul. It is distributed under the same license.
+//
+//	Copyright (c) the Scarle2021 contributors
+//
+//	This software is provided 'as-is', without any express or implied
+//	warranty. In no event will the authors be held liable for any damages
+//	arising from the use of this software.
+//
+//	Permission is granted to anyone to use this software for any purpose,
+//	including commercial applications, and to alter it and redistribute it
+//	freely, subject to the following restrictions:
+//	  1. The origin of this software must not be misrepresented; you must not
+//	     claim that you wrote the original software. If you use this software
+//	     in a product, an acknowledgment in the product documentation would be
+//	     appreciated but is not required.
+//	  2. Altered source versions must be plainly marked as such, and must not
+//	     be misrepresented as being the original software.
+//	  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------------------
+// q3HashGrid
+//--------------------------------------------------------------------------------------------------
+struct q3GridAABBTest
+{
+	bool operator()( const q3AABB& fatAABB ) const
+	{
+		return q3AABBtoAABB( aabb, fatAABB );
+	}
+
+	q3AABB aabb;
+};
+
+//--------------------------------------------------------------------------------------------------
+struct q3GridSegmentTest
+{
+	bool operator()( const q3AABB& fatAABB ) const
+	{
+		return q3SegmentToAABB( p0, p1, fatAABB );
+	}
+
+	q3Vec3 p0;
+	q3Vec3 p1;
+};
+
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3HashGrid::Query( T *cb, const q3AABB& aabb ) const
+{
+	q3GridAABBTest test;
+	test.aabb = aabb;
+
+	QueryCells( cb, aabb, test );
+}
+
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3HashGrid::Query( T *cb, q3RaycastData& rayCast ) const
+{
+	q3GridSegmentTest test;
+	test.p0 = rayCast.start;
+	test.p1 = rayCast.start + rayCast.dir * rayCast.t;
+
+	q3AABB bounds;
+	bounds.min = q3Min( test.p0, test.p1 );
+	bounds.max = q3Max( test.p0, test.p1 );
+
+	QueryCells( cb, bounds, test );
+}
+
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3HashGrid::Query( T *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const
+{
+	Q3_UNUSED( scratch );
+
+	q3QueryEach( this, cb, aabbs, count );
+}
+
+//--------------------------------------------------------------------------------------------------
+template <typename T, typename Test>
+inline void q3HashGrid::QueryCells( T *cb, const q3AABB& bounds, const Test& test ) const
+{
+	for ( i32 i = 0; i < m_largeCount; ++i )
+	{
+		i32 id = m_large[ i ];
+		Q3_COUNT_VISIT( cb );
+
+		if ( test( m_proxies[ id ].aabb ) )
+		{
+			if ( !cb->TreeCallBack( id ) )
+				return;
+		}
+	}
+
+	CellRange range;
+	ComputeCells( bounds, &range );
+
+	r32 cellCount =
+		r32( range.max[ 0 ] - range.min[ 0 ] + 1 ) *
+		r32( range.max[ 1 ] - range.min[ 1 ] + 1 ) *
+		r32( range.max[ 2 ] - range.min[ 2 ] + 1 );
+
+	// Huge queries are cheaper to answer by looking at every proxy
+	if ( cellCount > r32( m_proxyCount ) )
+	{
+		for ( i32 id = 0; id < m_capacity; ++id )
+		{
+			const Proxy *p = m_proxies + id;
+
+			if ( !p->used || p->largeSlot != Proxy::Null )
+				continue;
+
+			Q3_COUNT_VISIT( cb );
+
+			if ( test( p->aabb ) )
+			{
+				if ( !cb->TreeCallBack( id ) )
+					return;
+			}
+		}
+
+		return;
+	}
+
+	for ( i32 x = range.min[ 0 ]; x <= range.max[ 0 ]; ++x )
+	{
+		for ( i32 y = range.min[ 1 ]; y <= range.max[ 1 ]; ++y )
+		{
+			for ( i32 z = range.min[ 2 ]; z <= range.max[ 2 ]; ++z )
+			{
+				i32 index = m_buckets[ Hash( x, y, z ) ];
+
+				while ( index != Proxy::Null )
+				{
+					const Entry *e = m_entries + index;
+					index = e->next;
+					Q3_COUNT_VISIT( cb );
+
+					if ( e->x != x || e->y != y || e->z != z )
+						continue;
+
+					// Only the first cell shared with the query reports
+					// the proxy
+					const Proxy *p = m_proxies + e->proxy;
+
+					if ( x != q3Max( p->cells.min[ 0 ], range.min[ 0 ] ) ||
+						y != q3Max( p->cells.min[ 1 ], range.min[ 1 ] ) ||
+						z != q3Max( p->cells.min[ 2 ], range.min[ 2 ] ) )
+						continue;
+
+					if ( test( p->aabb ) )
+					{
+						if ( !cb->TreeCallBack( e->proxy ) )
+							return;
+					}
+				}
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+inline i32 q3HashGrid::Hash( i32 x, i32 y, i32 z ) const
+{
+	u32 h = (u32)x * 73856093u ^ (u32)y * 19349663u ^ (u32)z * 83492791u;
+
+	return (i32)(h & (u32)(m_bucketCount - 1));
+}
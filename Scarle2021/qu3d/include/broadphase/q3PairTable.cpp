@@ -0,0 +1,200 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3PairTable.cpp
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#include <cassert>
+
+#include "q3PairTable.h"
+#include "../common/q3Memory.h"
+
+//--------------------------------------------------------------------------------------------------
+// q3PairTable
+//--------------------------------------------------------------------------------------------------
+const i32 q3k_pairTableInitialCapacity = 256;
+
+//--------------------------------------------------------------------------------------------------
+// Entries hold the lower key first
+static inline void q3OrderPair( i32& a, i32& b )
+{
+	if ( b < a )
+	{
+		i32 t = a;
+		a = b;
+		b = t;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+q3PairTable::q3PairTable( )
+{
+	m_capacity = q3k_pairTableInitialCapacity;
+	m_count = 0;
+	m_entries = (q3PairEntry*)q3Alloc( sizeof( q3PairEntry ) * m_capacity );
+
+	Clear( );
+}
+
+//--------------------------------------------------------------------------------------------------
+q3PairTable::~q3PairTable( )
+{
+	q3Free( m_entries );
+}
+
+//--------------------------------------------------------------------------------------------------
+void* q3PairTable::Find( i32 a, i32 b ) const
+{
+	q3OrderPair( a, b );
+	i32 slot = FindSlot( a, b );
+	return m_entries[ slot ].a == -1 ? NULL : m_entries[ slot ].value;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3PairTable::Insert( i32 a, i32 b, void* value )
+{
+	assert( a >= 0 && b >= 0 );
+	q3OrderPair( a, b );
+
+	// Keep the load at or below one half
+	if ( 2 * (m_count + 1) > m_capacity )
+		Grow( );
+
+	i32 slot = FindSlot( a, b );
+	assert( m_entries[ slot ].a == -1 );
+
+	m_entries[ slot ].a = a;
+	m_entries[ slot ].b = b;
+	m_entries[ slot ].value = value;
+	++m_count;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3PairTable::Remove( i32 a, i32 b )
+{
+	q3OrderPair( a, b );
+	i32 mask = m_capacity - 1;
+	i32 slot = FindSlot( a, b );
+
+	if ( m_entries[ slot ].a == -1 )
+		return;
+
+	--m_count;
+
+	// Walk the rest of the cluster and move back every entry whose home
+	// slot does not lie between the hole and itself
+	i32 hole = slot;
+	i32 i = slot;
+
+	for ( ; ; )
+	{
+		i = (i + 1) & mask;
+		q3PairEntry* entry = m_entries + i;
+
+		if ( entry->a == -1 )
+			break;
+
+		i32 home = Hash( entry->a, entry->b );
+		bool stays = hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+
+		if ( stays )
+			continue;
+
+		m_entries[ hole ] = *entry;
+		hole = i;
+	}
+
+	m_entries[ hole ].a = -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3PairTable::Clear( )
+{
+	for ( i32 i = 0; i < m_capacity; ++i )
+		m_entries[ i ].a = -1;
+
+	m_count = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3PairTable::GetCount( ) const
+{
+	return m_count;
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3PairTable::FindSlot( i32 a, i32 b ) const
+{
+	i32 mask = m_capacity - 1;
+	i32 i = Hash( a, b );
+
+	for ( ; ; )
+	{
+		const q3PairEntry* entry = m_entries + i;
+
+		if ( entry->a == -1 || (entry->a == a && entry->b == b) )
+			return i;
+
+		i = (i + 1) & mask;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3PairTable::Hash( i32 a, i32 b ) const
+{
+	// Fibonacci hashing of both keys, the capacity is a power of two
+	u32 h = u32( a ) * 0x9E3779B1u;
+	h ^= (h >> 15) ^ (u32( b ) * 0x85EBCA77u);
+	h ^= h >> 13;
+	h *= 0xC2B2AE3Du;
+	h ^= h >> 16;
+
+	return i32( h & u32( m_capacity - 1 ) );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3PairTable::Grow( )
+{
+	q3PairEntry* oldEntries = m_entries;
+	i32 oldCapacity = m_capacity;
+
+	m_capacity *= 2;
+	m_entries = (q3PairEntry*)q3Alloc( sizeof( q3PairEntry ) * m_capacity );
+	Clear( );
+
+	for ( i32 i = 0; i < oldCapacity; ++i )
+	{
+		q3PairEntry* entry = oldEntries + i;
+
+		if ( entry->a == -1 )
+			continue;
+
+		i32 slot = FindSlot( entry->a, entry->b );
+		m_entries[ slot ] = *entry;
+		++m_count;
+	}
+
+	q3Free( oldEntries );
+}
@@ -0,0 +1,77 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3PairTable.h
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#ifndef Q3PAIRTABLE_H
+#define Q3PAIRTABLE_H
+
+#include "../common/q3Types.h"
+
+//--------------------------------------------------------------------------------------------------
+// q3PairTable
+//--------------------------------------------------------------------------------------------------
+// Open addressing hash map from a pair of broadphase proxy keys to a user
+// pointer. Lookups, inserts and removals are O(1) on average. Removal
+// shifts later entries back instead of leaving tombstones, so the table
+// stays fast no matter how many pairs come and go. Keys must be >= 0.
+// Pairs are unordered: ( a, b ) and ( b, a ) are the same entry, since the
+// broadphase may report a pair either way round. Values keep track of
+// the order they were created in themselves.
+class q3PairTable
+{
+public:
+	q3PairTable( );
+	~q3PairTable( );
+
+	// Returns NULL if the pair is not in the table
+	void* Find( i32 a, i32 b ) const;
+
+	// The pair must not be in the table yet
+	void Insert( i32 a, i32 b, void* value );
+	void Remove( i32 a, i32 b );
+
+	void Clear( );
+	i32 GetCount( ) const;
+
+private:
+	struct q3PairEntry
+	{
+		i32 a;	// Lower key, -1 for empty slots
+		i32 b;
+		void* value;
+	};
+
+	i32 FindSlot( i32 a, i32 b ) const;
+	i32 Hash( i32 a, i32 b ) const;
+	void Grow( );
+
+	q3PairEntry* m_entries;
+	i32 m_capacity;
+	i32 m_count;
+};
+
+#endif // Q3PAIRTABLE_H
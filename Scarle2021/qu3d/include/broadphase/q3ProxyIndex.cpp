@@ -0,0 +1,68 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3ProxyIndex.cpp
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#include "q3ProxyIndex.h"
+
+//--------------------------------------------------------------------------------------------------
+// q3ProxyIndex
+//--------------------------------------------------------------------------------------------------
+void q3ProxyIndex::Insert( const q3AABB *aabbs, void **userData, i32 count, i32 *ids )
+{
+	for ( i32 i = 0; i < count; ++i )
+		ids[ i ] = Insert( aabbs[ i ], userData[ i ] );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ProxyIndex::Update( const i32 *ids, const q3AABB *aabbs, i32 count, bool *moved )
+{
+	for ( i32 i = 0; i < count; ++i )
+		moved[ i ] = Update( ids[ i ], aabbs[ i ] );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ProxyIndex::Rebuild( )
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ProxyIndex::UpdateSnapshot( )
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ProxyIndex::ClearSnapshot( )
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3ProxyIndex::GetBatchScratchSize( i32 count ) const
+{
+	Q3_UNUSED( count );
+
+	return 0;
+}
@@ -0,0 +1,240 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3ProxyIndex.h
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#ifndef Q3PROXYINDEX_H
+#define Q3PROXYINDEX_H
+
+#include "../math/q3Math.h"
+#include "../common/q3Geometry.h"
+#include "../common/q3Settings.h"
+
+//--------------------------------------------------------------------------------------------------
+// q3ProxyIndex
+//--------------------------------------------------------------------------------------------------
+// Spatial structure the broadphase keeps its proxies in. The broadphase owns
+// one index for static proxies and one for everything else, and generates
+// pairs and answers scene queries purely through this interface. Every
+// implementation stores the same fat AABBs (see q3FattenAABB) and reports
+// exactly the proxies whose fat AABB passes q3AABBtoAABB or q3SegmentToAABB,
+// so all of them produce the same pairs and query results, only the order of
+// the reports differs.
+enum q3BroadPhaseType
+{
+	eBroadPhaseTree,		// q3DynamicAABBTree, good all-rounder
+	eBroadPhaseSweepAndPrune,	// q3SweepAndPrune, cheap when few proxies move far
+	eBroadPhaseHashGrid		// q3HashGrid, for many proxies of similar size
+};
+
+// Receives the id of every proxy found by a query. Returning false stops
+// the query. This is the callback of the virtual q3ProxyIndex queries.
+// Every index also has templated queries that take any type with the same
+// members and call it directly, which the broadphase uses for its own
+// queries and pair generation.
+class q3ProxyCallback
+{
+public:
+	q3ProxyCallback( ) : visitCount( 0 ) {}
+	virtual ~q3ProxyCallback( ) {}
+
+	virtual bool TreeCallBack( i32 id ) = 0;
+
+	i32 visitCount;	// Nodes, or entries, looked at by queries so far, with Q3_PROFILE
+};
+
+// Counts one visited node, or entry, of a single query
+#ifdef Q3_PROFILE
+	#define Q3_COUNT_VISIT( cb ) ++(cb)->visitCount
+#else
+	#define Q3_COUNT_VISIT( cb )
+#endif // Q3_PROFILE
+
+// Receives the hits of a batched query, see q3DynamicAABBTree for the
+// meaning of IsActive. Templated batched queries take any type with the
+// same members, as above.
+class q3ProxyBatchCallback
+{
+public:
+	virtual ~q3ProxyBatchCallback( ) {}
+
+	virtual bool TreeCallBack( i32 queryIndex, i32 id ) = 0;
+	virtual bool IsActive( i32 queryIndex ) = 0;
+};
+
+class q3ProxyIndex
+{
+public:
+	virtual ~q3ProxyIndex( ) {}
+
+	// Provide tight-AABB. Ids are small non-negative integers that are
+	// reused after Remove.
+	virtual i32 Insert( const q3AABB& aabb, void *userData ) = 0;
+	virtual void Remove( i32 id ) = 0;
+
+	// Inserts count proxies at once and writes their ids. The default
+	// inserts them one by one.
+	virtual void Insert( const q3AABB *aabbs, void **userData, i32 count, i32 *ids );
+
+	// Rebuilds the structure over the current proxies, ids are kept. The
+	// default does nothing, for indices whose layout does not depend on
+	// the order proxies were inserted in.
+	virtual void Rebuild( );
+
+	// Brings a read-optimised copy of the index that queries use while it
+	// is fresh up to date, or frees it. The default does nothing, for
+	// indices that do not keep one.
+	virtual void UpdateSnapshot( );
+	virtual void ClearSnapshot( );
+
+	// Returns true when the fat AABB had to be moved
+	virtual bool Update( i32 id, const q3AABB& aabb ) = 0;
+
+	// Updates count proxies at once, moved[ i ] receives what Update would
+	// return for ids[ i ]. The default updates them one by one.
+	virtual void Update( const i32 *ids, const q3AABB *aabbs, i32 count, bool *moved );
+
+	// Moves a proxy to exactly the given fat AABB, e.g. one read back from
+	// GetFatAABB when restoring a checkpoint
+	virtual void SetFatAABB( i32 id, const q3AABB& fatAABB ) = 0;
+
+	virtual void *GetUserData( i32 id ) const = 0;
+	virtual const q3AABB& GetFatAABB( i32 id ) const = 0;
+	virtual i32 GetProxyCount( ) const = 0;
+
+	virtual void Query( q3ProxyCallback *cb, const q3AABB& aabb ) const = 0;
+	virtual void Query( q3ProxyCallback *cb, q3RaycastData& rayCast ) const = 0;
+
+	// Batched AABB query. Only q3DynamicAABBTree walks itself once for the
+	// whole batch, the other indices run one query per entry, see
+	// q3QueryEach. The default scratch size is zero.
+	virtual void Query( q3ProxyBatchCallback *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const = 0;
+	virtual i32 GetBatchScratchSize( i32 count ) const;
+
+	// Average number of nodes, or entries, a query visits. Measured by
+	// querying the fat AABB of every proxy, like pair generation does.
+	virtual r32 ComputeAverageQueryVisits( ) const = 0;
+
+	// For testing
+	virtual void Validate( ) const = 0;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Forwards the hits of one entry of a batch to the batch callback, for
+// indices that answer a batch one AABB query at a time
+template <typename T>
+struct q3BatchEntryCallback
+{
+	bool TreeCallBack( i32 id )
+	{
+		if ( !cb->TreeCallBack( queryIndex, id ) )
+		{
+			keepGoing = false;
+			return false;
+		}
+
+		return cb->IsActive( queryIndex );
+	}
+
+	T *cb;
+	i32 queryIndex;
+	bool keepGoing;
+	i32 visitCount;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Batched query for an index without a batched walk of its own, runs
+// index->Query once for every active entry
+template <typename I, typename T>
+inline void q3QueryEach( const I *index, T *cb, const q3AABB *aabbs, i32 count )
+{
+	q3BatchEntryCallback<T> wrapper;
+	wrapper.cb = cb;
+	wrapper.keepGoing = true;
+	wrapper.visitCount = 0;
+
+	for ( i32 i = 0; i < count && wrapper.keepGoing; ++i )
+	{
+		if ( !cb->IsActive( i ) )
+			continue;
+
+		wrapper.queryIndex = i;
+		index->Query( &wrapper, aabbs[ i ] );
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+inline void q3FattenAABB( q3AABB& aabb )
+{
+	const r32 k_fattener = r32( 0.5 );
+	q3Vec3 v( k_fattener, k_fattener, k_fattener );
+
+	aabb.min -= v;
+	aabb.max += v;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Separating axis test between the segment p0 -> p1 and an AABB
+inline bool q3SegmentToAABB( const q3Vec3& p0, const q3Vec3& p1, const q3AABB& aabb )
+{
+	const r32 k_epsilon = r32( 1.0e-6 );
+
+	q3Vec3 e = aabb.max - aabb.min;
+	q3Vec3 d = p1 - p0;
+	q3Vec3 m = p0 + p1 - aabb.min - aabb.max;
+
+	r32 adx = q3Abs( d.x );
+
+	if ( q3Abs( m.x ) > e.x + adx )
+		return false;
+
+	r32 ady = q3Abs( d.y );
+
+	if ( q3Abs( m.y ) > e.y + ady )
+		return false;
+
+	r32 adz = q3Abs( d.z );
+
+	if ( q3Abs( m.z ) > e.z + adz )
+		return false;
+
+	adx += k_epsilon;
+	ady += k_epsilon;
+	adz += k_epsilon;
+
+	if( q3Abs( m.y * d.z - m.z * d.y) > e.y * adz + e.z * ady )
+		return false;
+
+	if( q3Abs( m.z * d.x - m.x * d.z) > e.x * adz + e.z * adx )
+		return false;
+
+	if ( q3Abs( m.x * d.y - m.y * d.x) > e.x * ady + e.y * adx )
+		return false;
+
+	return true;
+}
+
+#endif // Q3PROXYINDEX_H
@@ -0,0 +1,340 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3SweepAndPrune.cpp
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#include "q3SweepAndPrune.h"
+#include "../common/q3Memory.h"
+
+//--------------------------------------------------------------------------------------------------
+// q3SweepAndPrune
+//--------------------------------------------------------------------------------------------------
+q3SweepAndPrune::q3SweepAndPrune( )
+{
+	m_capacity = 0;
+	m_freeList = Proxy::Null;
+	m_proxies = NULL;
+	m_mins = NULL;
+	m_order = NULL;
+	m_proxyCount = 0;
+	m_maxExtent = r32( 0.0 );
+}
+
+//--------------------------------------------------------------------------------------------------
+q3SweepAndPrune::~q3SweepAndPrune( )
+{
+	q3Free( m_order );
+	q3Free( m_mins );
+	q3Free( m_proxies );
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3SweepAndPrune::Insert( const q3AABB& aabb, void *userData )
+{
+	i32 id = AllocateProxy( );
+	Proxy *p = m_proxies + id;
+
+	p->aabb = aabb;
+	q3FattenAABB( p->aabb );
+	p->userData = userData;
+
+	// Append and sort into place
+	p->slot = m_proxyCount;
+	m_mins[ m_proxyCount ] = p->aabb.min.x;
+	m_order[ m_proxyCount ] = id;
+	++m_proxyCount;
+
+	Sort( p->slot );
+	Widen( p->aabb );
+
+	return id;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3SweepAndPrune::Remove( i32 id )
+{
+	assert( id >= 0 && id < m_capacity );
+	assert( m_proxies[ id ].slot != Proxy::Null );
+
+	Proxy *p = m_proxies + id;
+
+	for ( i32 i = p->slot; i < m_proxyCount - 1; ++i )
+	{
+		m_mins[ i ] = m_mins[ i + 1 ];
+		m_order[ i ] = m_order[ i + 1 ];
+		m_proxies[ m_order[ i ] ].slot = i;
+	}
+
+	--m_proxyCount;
+
+	r32 extent = p->aabb.max.x - p->aabb.min.x;
+
+	p->slot = Proxy::Null;
+	p->next = m_freeList;
+	m_freeList = id;
+
+	// Only the widest proxy can shrink the bound
+	if ( extent * r32( 1.01 ) >= m_maxExtent )
+		ComputeMaxExtent( );
+}
+
+//--------------------------------------------------------------------------------------------------
+bool q3SweepAndPrune::Update( i32 id, const q3AABB& aabb )
+{
+	assert( id >= 0 && id < m_capacity );
+	assert( m_proxies[ id ].slot != Proxy::Null );
+
+	Proxy *p = m_proxies + id;
+
+	if ( p->aabb.Contains( aabb ) )
+		return false;
+
+	q3AABB fatAABB = aabb;
+	q3FattenAABB( fatAABB );
+	SetFatAABB( id, fatAABB );
+
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3SweepAndPrune::SetFatAABB( i32 id, const q3AABB& fatAABB )
+{
+	assert( id >= 0 && id < m_capacity );
+	assert( m_proxies[ id ].slot != Proxy::Null );
+
+	Proxy *p = m_proxies + id;
+	p->aabb = fatAABB;
+
+	m_mins[ p->slot ] = p->aabb.min.x;
+	Sort( p->slot );
+
+	// The bound is allowed to stay larger than needed until the next
+	// removal, it only makes queries sweep a little further
+	Widen( p->aabb );
+}
+
+//--------------------------------------------------------------------------------------------------
+void *q3SweepAndPrune::GetUserData( i32 id ) const
+{
+	assert( id >= 0 && id < m_capacity );
+
+	return m_proxies[ id ].userData;
+}
+
+//--------------------------------------------------------------------------------------------------
+const q3AABB& q3SweepAndPrune::GetFatAABB( i32 id ) const
+{
+	assert( id >= 0 && id < m_capacity );
+
+	return m_proxies[ id ].aabb;
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3SweepAndPrune::GetProxyCount( ) const
+{
+	return m_proxyCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3SweepAndPrune::Query( q3ProxyCallback *cb, const q3AABB& aabb ) const
+{
+	Query< q3ProxyCallback >( cb, aabb );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3SweepAndPrune::Query( q3ProxyCallback *cb, q3RaycastData& rayCast ) const
+{
+	Query< q3ProxyCallback >( cb, rayCast );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3SweepAndPrune::Query( q3ProxyBatchCallback *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const
+{
+	Query< q3ProxyBatchCallback >( cb, aabbs, count, scratch );
+}
+
+//--------------------------------------------------------------------------------------------------
+r32 q3SweepAndPrune::ComputeAverageQueryVisits( ) const
+{
+	if ( !m_proxyCount )
+		return r32( 0.0 );
+
+	i32 visits = 0;
+
+	for ( i32 i = 0; i < m_proxyCount; ++i )
+		visits += CountVisits( m_proxies[ m_order[ i ] ].aabb );
+
+	return r32( visits ) / r32( m_proxyCount );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3SweepAndPrune::Validate( ) const
+{
+	i32 freeCount = 0;
+	i32 index = m_freeList;
+
+	while ( index != Proxy::Null )
+	{
+		assert( index >= 0 && index < m_capacity );
+		assert( m_proxies[ index ].slot == Proxy::Null );
+		index = m_proxies[ index ].next;
+		++freeCount;
+	}
+
+	assert( m_proxyCount + freeCount == m_capacity );
+
+	for ( i32 i = 0; i < m_proxyCount; ++i )
+	{
+		const Proxy *p = m_proxies + m_order[ i ];
+
+		assert( p->slot == i );
+		assert( m_mins[ i ] == p->aabb.min.x );
+		assert( i == 0 || m_mins[ i - 1 ] <= m_mins[ i ] );
+		assert( p->aabb.max.x - p->aabb.min.x <= m_maxExtent );
+
+		Q3_UNUSED( p );
+	}
+
+	Q3_UNUSED( freeCount );
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3SweepAndPrune::AllocateProxy( )
+{
+	if ( m_freeList == Proxy::Null )
+	{
+		i32 capacity = m_capacity ? m_capacity * 2 : 256;
+
+		Proxy *proxies = (Proxy *)q3Alloc( sizeof( Proxy ) * capacity );
+		r32 *mins = (r32 *)q3Alloc( sizeof( r32 ) * capacity );
+		i32 *order = (i32 *)q3Alloc( sizeof( i32 ) * capacity );
+
+		if ( m_capacity )
+		{
+			memcpy( proxies, m_proxies, sizeof( Proxy ) * m_capacity );
+			memcpy( mins, m_mins, sizeof( r32 ) * m_proxyCount );
+			memcpy( order, m_order, sizeof( i32 ) * m_proxyCount );
+		}
+
+		q3Free( m_order );
+		q3Free( m_mins );
+		q3Free( m_proxies );
+		m_proxies = proxies;
+		m_mins = mins;
+		m_order = order;
+
+		for ( i32 i = m_capacity; i < capacity; ++i )
+		{
+			m_proxies[ i ].slot = Proxy::Null;
+			m_proxies[ i ].next = i + 1 < capacity ? i + 1 : Proxy::Null;
+		}
+
+		m_freeList = m_capacity;
+		m_capacity = capacity;
+	}
+
+	i32 id = m_freeList;
+	m_freeList = m_proxies[ id ].next;
+
+	return id;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3SweepAndPrune::Sort( i32 slot )
+{
+	r32 key = m_mins[ slot ];
+	i32 id = m_order[ slot ];
+	i32 i = slot;
+
+	while ( i > 0 && m_mins[ i - 1 ] > key )
+	{
+		m_mins[ i ] = m_mins[ i - 1 ];
+		m_order[ i ] = m_order[ i - 1 ];
+		m_proxies[ m_order[ i ] ].slot = i;
+		--i;
+	}
+
+	while ( i < m_proxyCount - 1 && m_mins[ i + 1 ] < key )
+	{
+		m_mins[ i ] = m_mins[ i + 1 ];
+		m_order[ i ] = m_order[ i + 1 ];
+		m_proxies[ m_order[ i ] ].slot = i;
+		++i;
+	}
+
+	m_mins[ i ] = key;
+	m_order[ i ] = id;
+	m_proxies[ id ].slot = i;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3SweepAndPrune::Widen( const q3AABB& aabb )
+{
+	// A percent of headroom keeps rounding in aabb.min.x - m_maxExtent from
+	// cutting off a proxy that just touches the query. Fat AABBs are at
+	// least one unit wide, so this is always well above float precision.
+	m_maxExtent = q3Max( m_maxExtent, (aabb.max.x - aabb.min.x) * r32( 1.01 ) );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3SweepAndPrune::ComputeMaxExtent( )
+{
+	m_maxExtent = r32( 0.0 );
+
+	for ( i32 i = 0; i < m_proxyCount; ++i )
+		Widen( m_proxies[ m_order[ i ] ].aabb );
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3SweepAndPrune::LowerBound( r32 x ) const
+{
+	i32 lo = 0;
+	i32 hi = m_proxyCount;
+
+	while ( lo < hi )
+	{
+		i32 mid = (lo + hi) >> 1;
+
+		if ( m_mins[ mid ] < x )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3SweepAndPrune::CountVisits( const q3AABB& aabb ) const
+{
+	i32 first = LowerBound( aabb.min.x - m_maxExtent );
+	i32 i = first;
+
+	while ( i < m_proxyCount && m_mins[ i ] <= aabb.max.x )
+		++i;
+
+	return i - first;
+}
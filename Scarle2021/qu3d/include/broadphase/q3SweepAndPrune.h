@@ -0,0 +1,112 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3SweepAndPrune.h
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#ifndef Q3SWEEPANDPRUNE_H
+#define Q3SWEEPANDPRUNE_H
+
+#include "q3ProxyIndex.h"
+
+//--------------------------------------------------------------------------------------------------
+// q3SweepAndPrune
+//--------------------------------------------------------------------------------------------------
+// Keeps the fat AABBs sorted by their lower bound on the x axis. Moving a
+// proxy re-sorts it with a few insertion sort swaps, which is cheap since
+// proxies rarely travel past many neighbours in one step. A query binary
+// searches the first proxy that can reach it, using the widest proxy on
+// the axis, and sweeps until the lower bounds pass the query.
+class q3SweepAndPrune : public q3ProxyIndex
+{
+public:
+	q3SweepAndPrune( );
+	virtual ~q3SweepAndPrune( );
+
+	virtual i32 Insert( const q3AABB& aabb, void *userData );
+	virtual void Remove( i32 id );
+	virtual bool Update( i32 id, const q3AABB& aabb );
+	virtual void SetFatAABB( i32 id, const q3AABB& fatAABB );
+
+	virtual void *GetUserData( i32 id ) const;
+	virtual const q3AABB& GetFatAABB( i32 id ) const;
+	virtual i32 GetProxyCount( ) const;
+
+	// q3ProxyIndex queries, these run the templated queries below
+	virtual void Query( q3ProxyCallback *cb, const q3AABB& aabb ) const;
+	virtual void Query( q3ProxyCallback *cb, q3RaycastData& rayCast ) const;
+	virtual void Query( q3ProxyBatchCallback *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const;
+
+	// Take callbacks deriving from, or shaped like, q3ProxyCallback and
+	// q3ProxyBatchCallback. A batch runs one query per entry.
+	template <typename T>
+	void Query( T *cb, const q3AABB& aabb ) const;
+	template <typename T>
+	void Query( T *cb, q3RaycastData& rayCast ) const;
+	template <typename T>
+	void Query( T *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const;
+
+	virtual r32 ComputeAverageQueryVisits( ) const;
+
+	virtual void Validate( ) const;
+
+private:
+	struct Proxy
+	{
+		q3AABB aabb;
+		void *userData;
+
+		// Position in the sorted arrays, Null for free proxies
+		i32 slot;
+		i32 next; // free list
+
+		static const i32 Null = -1;
+	};
+
+	i32 AllocateProxy( );
+	void Sort( i32 slot );
+	void Widen( const q3AABB& aabb );
+	void ComputeMaxExtent( );
+
+	// First slot whose lower bound is not below x
+	i32 LowerBound( r32 x ) const;
+	i32 CountVisits( const q3AABB& aabb ) const;
+
+	Proxy *m_proxies;
+	i32 m_capacity;
+	i32 m_freeList;
+
+	// Sorted by lower bound, m_proxyCount entries each
+	r32 *m_mins;
+	i32 *m_order;
+	i32 m_proxyCount;
+
+	// Upper bound of max.x - min.x over all proxies
+	r32 m_maxExtent;
+};
+
+#include "q3SweepAndPrune.inl"
+
+#endif // Q3SWEEPANDPRUNE_H
@@ -0,0 +1,79 @@
+//--------------------------------------------------------------------------------------------------
+// q3SweepAndPrune.inl
+//
+//	Written for the Scarle2021 fork of qu3e, this file is not part of the
+//	original qu3e by Randy Gaul. It is distributed under the same license.
+//
+//	Copyright (c) the Scarle2021 contributors
+//
+//	This software is provided 'as-is', without any express or implied
+//	warranty. In no event will the authors be held liable for any damages
+//	arising from the use of this software.
+//
+//	Permission is granted to anyone to use this software for any purpose,
+//	including commercial applications, and to alter it and redistribute it
+//	freely, subject to the following restrictions:
+//	  1. The origin of this software must not be misrepresented; you must not
+//	     claim that you wrote the original software. If you use this software
+//	     in a product, an acknowledgment in the product documentation would be
+//	     appreciated but is not required.
+//	  2. Altered source versions must be plainly marked as such, and must not
+//	     be misrepresented as being the original software.
+//	  3. This notice may not be removed or altered from any source distribution.
+//--------------------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------------------
+// q3SweepAndPrune
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3SweepAndPrune::Query( T *cb, const q3AABB& aabb ) const
+{
+	for ( i32 i = LowerBound( aabb.min.x - m_maxExtent ); i < m_proxyCount; ++i )
+	{
+		if ( m_mins[ i ] > aabb.max.x )
+			return;
+
+		i32 id = m_order[ i ];
+		Q3_COUNT_VISIT( cb );
+
+		if ( q3AABBtoAABB( aabb, m_proxies[ id ].aabb ) )
+		{
+			if ( !cb->TreeCallBack( id ) )
+				return;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3SweepAndPrune::Query( T *cb, q3RaycastData& rayCast ) const
+{
+	q3Vec3 p0 = rayCast.start;
+	q3Vec3 p1 = p0 + rayCast.dir * rayCast.t;
+	r32 lo = q3Min( p0.x, p1.x );
+	r32 hi = q3Max( p0.x, p1.x );
+
+	for ( i32 i = LowerBound( lo - m_maxExtent ); i < m_proxyCount; ++i )
+	{
+		if ( m_mins[ i ] > hi )
+			return;
+
+		i32 id = m_order[ i ];
+		Q3_COUNT_VISIT( cb );
+
+		if ( q3SegmentToAABB( p0, p1, m_proxies[ id ].aabb ) )
+		{
+			if ( !cb->TreeCallBack( id ) )
+				return;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+inline void q3SweepAndPrune::Query( T *cb, const q3AABB *aabbs, i32 count, i32 *scratch ) const
+{
+	Q3_UNUSED( scratch );
+
+	q3QueryEach( this, cb, aabbs, count );
+}
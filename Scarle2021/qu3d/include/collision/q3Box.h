@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -56,6 +58,7 @@ struct q3Box
 	r32 restitution;
 	r32 density;
 	i32 broadPhaseIndex;
+	i32 serial;	// Creation order within the scene
 	mutable void* userData;
 	mutable bool sensor;
 
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -31,7 +33,7 @@
 //--------------------------------------------------------------------------------------------------
 // qBoxtoBox
 //--------------------------------------------------------------------------------------------------
-inline bool q3TrackFaceAxis( i32* axis, i32 n, r32 s, r32* sMax, const q3Vec3& normal, q3Vec3* axisNormal )
+inline bool q3TrackFaceAxis( i32* axis, i32 n, r32 s, r32* sMax )
 {
 	if ( s > r32( 0.0 ) )
 		return true;
@@ -40,7 +42,6 @@ inline bool q3TrackFaceAxis( i32* axis, i32 n, r32 s, r32* sMax, const q3Vec3& n
 	{
 		*sMax = s;
 		*axis = n;
-		*axisNormal = normal;
 	}
 
 	return false;
@@ -65,6 +66,51 @@ inline bool q3TrackEdgeAxis( i32* axis, i32 n, r32 s, r32* sMax, const q3Vec3& n
 	return false;
 }
 
+//--------------------------------------------------------------------------------------------------
+// Separation along one of the 15 SAT axes, in the same arithmetic as q3SeparatingAxes.
+// Edge axes are left unnormalized, so only the sign is meaningful for them.
+inline r32 q3AxisSeparation( i32 axis, const q3Vec3& t, const q3Mat3& C, const q3Mat3& absC, const q3Vec3& eA, const q3Vec3& eB )
+{
+	if ( axis < 3 )
+		return q3Abs( t[ axis ] ) - (eA[ axis ] + q3Dot( q3Vec3( absC.ex[ axis ], absC.ey[ axis ], absC.ez[ axis ] ), eB ));
+
+	if ( axis < 6 )
+	{
+		i32 j = axis - 3;
+		return q3Abs( q3Dot( t, C[ j ] ) ) - (eB[ j ] + q3Dot( absC[ j ], eA ));
+	}
+
+	// Cross( a[ i ], b[ j ] )
+	i32 i = (axis - 6) / 3;
+	i32 j = (axis - 6) % 3;
+	i32 i1 = (i + 1) % 3;
+	i32 i2 = (i + 2) % 3;
+	i32 j1 = (j + 1) % 3;
+	i32 j2 = (j + 2) % 3;
+	r32 rA = eA[ i1 ] * absC[ j ][ i2 ] + eA[ i2 ] * absC[ j ][ i1 ];
+	r32 rB = eB[ j1 ] * absC[ j2 ][ i ] + eB[ j2 ] * absC[ j1 ][ i ];
+	return q3Abs( t[ i2 ] * C[ j ][ i1 ] - t[ i1 ] * C[ j ][ i2 ] ) - (rA + rB);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Whether B's pose in A's space is still within the manifold cache tolerances
+inline bool q3ManifoldCacheValid( const q3Manifold* m, const q3Mat3& C, const q3Vec3& t )
+{
+	for ( i32 i = 0; i < 3; ++i )
+	{
+		if ( q3Abs( t[ i ] - m->cacheTranslation[ i ] ) > Q3_MANIFOLD_CACHE_LINEAR )
+			return false;
+
+		for ( i32 j = 0; j < 3; ++j )
+		{
+			if ( q3Abs( C[ i ][ j ] - m->cacheRotation[ i ][ j ] ) > Q3_MANIFOLD_CACHE_ANGULAR )
+				return false;
+		}
+	}
+
+	return true;
+}
+
 //--------------------------------------------------------------------------------------------------
 struct q3ClipVertex
 {
@@ -473,85 +519,47 @@ void q3SupportEdge( const q3Transform& tx, const q3Vec3& e, q3Vec3 n, q3Vec3* aO
 }
 
 //--------------------------------------------------------------------------------------------------
-// Resources:
-// http://www.randygaul.net/2014/05/22/deriving-obb-to-obb-intersection-sat/
-// https://box2d.googlecode.com/files/GDC2007_ErinCatto.zip
-// https://box2d.googlecode.com/files/Box2D_Lite.zip
-void q3BoxtoBox( q3Manifold* m, q3Box* a, q3Box* b )
+i32 q3SeparatingAxes( const q3Vec3& t, const q3Mat3& C, const q3Mat3& absC, const q3Vec3& eA, const q3Vec3& eB, bool parallel, q3AxisQuery* q )
 {
-	q3Transform atx = a->body->GetTransform( );
-	q3Transform btx = b->body->GetTransform( );
-	q3Transform aL = a->local;
-	q3Transform bL = b->local;
-	atx = q3Mul( atx, aL );
-	btx = q3Mul( btx, bL );
-	q3Vec3 eA = a->e;
-	q3Vec3 eB = b->e;
-
-	// B's frame in A's space
-	q3Mat3 C = q3Transpose( atx.rotation ) * btx.rotation;
-
-	q3Mat3 absC;
-	bool parallel = false;
-	const r32 kCosTol = r32( 1.0e-6 );
-	for ( i32 i = 0; i < 3; ++i )
-	{
-		for ( i32 j = 0; j < 3; ++j )
-		{
-			r32 val = q3Abs( C[ i ][ j ] );
-			absC[ i ][ j ] = val;
-
-			if ( val + kCosTol >= r32( 1.0 ) )
-				parallel = true;
-		}
-	}
-
-	// Vector from center A to center B in A's space
-	q3Vec3 t = q3MulT( atx.rotation, btx.position - atx.position );
-
-	// Query states
 	r32 s;
-	r32 aMax = -Q3_R32_MAX;
-	r32 bMax = -Q3_R32_MAX;
-	r32 eMax = -Q3_R32_MAX;
-	i32 aAxis = ~0;
-	i32 bAxis = ~0;
-	i32 eAxis = ~0;
-	q3Vec3 nA;
-	q3Vec3 nB;
-	q3Vec3 nE;
+	q->aMax = -Q3_R32_MAX;
+	q->bMax = -Q3_R32_MAX;
+	q->eMax = -Q3_R32_MAX;
+	q->aAxis = ~0;
+	q->bAxis = ~0;
+	q->eAxis = ~0;
 
 	// Face axis checks
 
 	// a's x axis
 	s = q3Abs( t.x ) - (eA.x + q3Dot( absC.Column0( ), eB ));
-	if ( q3TrackFaceAxis( &aAxis, 0, s, &aMax, atx.rotation.ex, &nA ) )
-		return;
+	if ( q3TrackFaceAxis( &q->aAxis, 0, s, &q->aMax ) )
+		return 0;
 
 	// a's y axis
 	s = q3Abs( t.y ) - (eA.y + q3Dot( absC.Column1( ), eB ));
-	if ( q3TrackFaceAxis( &aAxis, 1, s, &aMax, atx.rotation.ey, &nA ) )
-		return;
+	if ( q3TrackFaceAxis( &q->aAxis, 1, s, &q->aMax ) )
+		return 1;
 
 	// a's z axis
 	s = q3Abs( t.z ) - (eA.z + q3Dot( absC.Column2( ), eB ));
-	if ( q3TrackFaceAxis( &aAxis, 2, s, &aMax, atx.rotation.ez, &nA ) )
-		return;
+	if ( q3TrackFaceAxis( &q->aAxis, 2, s, &q->aMax ) )
+		return 2;
 
 	// b's x axis
 	s = q3Abs( q3Dot( t, C.ex ) ) - (eB.x + q3Dot( absC.ex, eA ));
-	if ( q3TrackFaceAxis( &bAxis, 3, s, &bMax, btx.rotation.ex, &nB ) )
-		return;
+	if ( q3TrackFaceAxis( &q->bAxis, 3, s, &q->bMax ) )
+		return 3;
 
 	// b's y axis
 	s = q3Abs( q3Dot( t, C.ey ) ) - (eB.y + q3Dot( absC.ey, eA ));
-	if ( q3TrackFaceAxis( &bAxis, 4, s, &bMax, btx.rotation.ey, &nB ) )
-		return;
+	if ( q3TrackFaceAxis( &q->bAxis, 4, s, &q->bMax ) )
+		return 4;
 
 	// b's z axis
 	s = q3Abs( q3Dot( t, C.ez ) ) - (eB.z + q3Dot( absC.ez, eA ));
-	if ( q3TrackFaceAxis( &bAxis, 5, s, &bMax, btx.rotation.ez, &nB ) )
-		return;
+	if ( q3TrackFaceAxis( &q->bAxis, 5, s, &q->bMax ) )
+		return 5;
 
 	if ( !parallel )
 	{
@@ -563,64 +571,245 @@ void q3BoxtoBox( q3Manifold* m, q3Box* a, q3Box* b )
 		rA = eA.y * absC[ 0 ][ 2 ] + eA.z * absC[ 0 ][ 1 ];
 		rB = eB.y * absC[ 2 ][ 0 ] + eB.z * absC[ 1 ][ 0 ];
 		s = q3Abs( t.z * C[ 0 ][ 1 ] - t.y * C[ 0 ][ 2 ] ) - (rA + rB);
-		if ( q3TrackEdgeAxis( &eAxis, 6, s, &eMax, q3Vec3( r32( 0.0 ), -C[ 0 ][ 2 ], C[ 0 ][ 1 ] ), &nE ) )
-			return;
+		if ( q3TrackEdgeAxis( &q->eAxis, 6, s, &q->eMax, q3Vec3( r32( 0.0 ), -C[ 0 ][ 2 ], C[ 0 ][ 1 ] ), &q->nE ) )
+			return 6;
 
 		// Cross( a.x, b.y )
 		rA = eA.y * absC[ 1 ][ 2 ] + eA.z * absC[ 1 ][ 1 ];
 		rB = eB.x * absC[ 2 ][ 0 ] + eB.z * absC[ 0 ][ 0 ];
 		s = q3Abs( t.z * C[ 1 ][ 1 ] - t.y * C[ 1 ][ 2 ] ) - (rA + rB);
-		if ( q3TrackEdgeAxis( &eAxis, 7, s, &eMax, q3Vec3( r32( 0.0 ), -C[ 1 ][ 2 ], C[ 1 ][ 1 ] ), &nE ) )
-			return;
+		if ( q3TrackEdgeAxis( &q->eAxis, 7, s, &q->eMax, q3Vec3( r32( 0.0 ), -C[ 1 ][ 2 ], C[ 1 ][ 1 ] ), &q->nE ) )
+			return 7;
 
 		// Cross( a.x, b.z )
 		rA = eA.y * absC[ 2 ][ 2 ] + eA.z * absC[ 2 ][ 1 ];
 		rB = eB.x * absC[ 1 ][ 0 ] + eB.y * absC[ 0 ][ 0 ];
 		s = q3Abs( t.z * C[ 2 ][ 1 ] - t.y * C[ 2 ][ 2 ] ) - (rA + rB);
-		if ( q3TrackEdgeAxis( &eAxis, 8, s, &eMax, q3Vec3( r32( 0.0 ), -C[ 2 ][ 2 ], C[ 2 ][ 1 ] ), &nE ) )
-			return;
+		if ( q3TrackEdgeAxis( &q->eAxis, 8, s, &q->eMax, q3Vec3( r32( 0.0 ), -C[ 2 ][ 2 ], C[ 2 ][ 1 ] ), &q->nE ) )
+			return 8;
 
 		// Cross( a.y, b.x )
 		rA = eA.x * absC[ 0 ][ 2 ] + eA.z * absC[ 0 ][ 0 ];
 		rB = eB.y * absC[ 2 ][ 1 ] + eB.z * absC[ 1 ][ 1 ];
 		s = q3Abs( t.x * C[ 0 ][ 2 ] - t.z * C[ 0 ][ 0 ] ) - (rA + rB);
-		if ( q3TrackEdgeAxis( &eAxis, 9, s, &eMax, q3Vec3( C[ 0 ][ 2 ], r32( 0.0 ), -C[ 0 ][ 0 ] ), &nE ) )
-			return;
+		if ( q3TrackEdgeAxis( &q->eAxis, 9, s, &q->eMax, q3Vec3( C[ 0 ][ 2 ], r32( 0.0 ), -C[ 0 ][ 0 ] ), &q->nE ) )
+			return 9;
 
 		// Cross( a.y, b.y )
 		rA = eA.x * absC[ 1 ][ 2 ] + eA.z * absC[ 1 ][ 0 ];
 		rB = eB.x * absC[ 2 ][ 1 ] + eB.z * absC[ 0 ][ 1 ];
 		s = q3Abs( t.x * C[ 1 ][ 2 ] - t.z * C[ 1 ][ 0 ] ) - (rA + rB);
-		if ( q3TrackEdgeAxis( &eAxis, 10, s, &eMax, q3Vec3( C[ 1 ][ 2 ], r32( 0.0 ), -C[ 1 ][ 0 ] ), &nE ) )
-			return;
+		if ( q3TrackEdgeAxis( &q->eAxis, 10, s, &q->eMax, q3Vec3( C[ 1 ][ 2 ], r32( 0.0 ), -C[ 1 ][ 0 ] ), &q->nE ) )
+			return 10;
 
 		// Cross( a.y, b.z )
 		rA = eA.x * absC[ 2 ][ 2 ] + eA.z * absC[ 2 ][ 0 ];
 		rB = eB.x * absC[ 1 ][ 1 ] + eB.y * absC[ 0 ][ 1 ];
 		s = q3Abs( t.x * C[ 2 ][ 2 ] - t.z * C[ 2 ][ 0 ] ) - (rA + rB);
-		if ( q3TrackEdgeAxis( &eAxis, 11, s, &eMax, q3Vec3( C[ 2 ][ 2 ], r32( 0.0 ), -C[ 2 ][ 0 ] ), &nE ) )
-			return;
+		if ( q3TrackEdgeAxis( &q->eAxis, 11, s, &q->eMax, q3Vec3( C[ 2 ][ 2 ], r32( 0.0 ), -C[ 2 ][ 0 ] ), &q->nE ) )
+			return 11;
 
 		// Cross( a.z, b.x )
 		rA = eA.x * absC[ 0 ][ 1 ] + eA.y * absC[ 0 ][ 0 ];
 		rB = eB.y * absC[ 2 ][ 2 ] + eB.z * absC[ 1 ][ 2 ];
 		s = q3Abs( t.y * C[ 0 ][ 0 ] - t.x * C[ 0 ][ 1 ] ) - (rA + rB);
-		if ( q3TrackEdgeAxis( &eAxis, 12, s, &eMax, q3Vec3( -C[ 0 ][ 1 ], C[ 0 ][ 0 ], r32( 0.0 ) ), &nE ) )
-			return;
+		if ( q3TrackEdgeAxis( &q->eAxis, 12, s, &q->eMax, q3Vec3( -C[ 0 ][ 1 ], C[ 0 ][ 0 ], r32( 0.0 ) ), &q->nE ) )
+			return 12;
 
 		// Cross( a.z, b.y )
 		rA = eA.x * absC[ 1 ][ 1 ] + eA.y * absC[ 1 ][ 0 ];
 		rB = eB.x * absC[ 2 ][ 2 ] + eB.z * absC[ 0 ][ 2 ];
 		s = q3Abs( t.y * C[ 1 ][ 0 ] - t.x * C[ 1 ][ 1 ] ) - (rA + rB);
-		if ( q3TrackEdgeAxis( &eAxis, 13, s, &eMax, q3Vec3( -C[ 1 ][ 1 ], C[ 1 ][ 0 ], r32( 0.0 ) ), &nE ) )
-			return;
+		if ( q3TrackEdgeAxis( &q->eAxis, 13, s, &q->eMax, q3Vec3( -C[ 1 ][ 1 ], C[ 1 ][ 0 ], r32( 0.0 ) ), &q->nE ) )
+			return 13;
 
 		// Cross( a.z, b.z )
 		rA = eA.x * absC[ 2 ][ 1 ] + eA.y * absC[ 2 ][ 0 ];
 		rB = eB.x * absC[ 1 ][ 2 ] + eB.y * absC[ 0 ][ 2 ];
 		s = q3Abs( t.y * C[ 2 ][ 0 ] - t.x * C[ 2 ][ 1 ] ) - (rA + rB);
-		if ( q3TrackEdgeAxis( &eAxis, 14, s, &eMax, q3Vec3( -C[ 2 ][ 1 ], C[ 2 ][ 0 ], r32( 0.0 ) ), &nE ) )
+		if ( q3TrackEdgeAxis( &q->eAxis, 14, s, &q->eMax, q3Vec3( -C[ 2 ][ 1 ], C[ 2 ][ 0 ], r32( 0.0 ) ), &q->nE ) )
+			return 14;
+	}
+
+	return ~0;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Boxes whose frames differ by a signed permutation are two AABBs in A's
+// space. The face axes decide separation and the manifold is the overlap of
+// B's face with A's reference face, so no edge axes or clipping are needed.
+inline void q3AlignedBoxtoBox( q3Manifold* m, const q3Transform& atx, const q3Transform& btx, const q3Vec3& t, const q3Mat3& C, const q3Mat3& absC, const q3Vec3& eA, const q3Vec3& eB )
+{
+	// B's extents in A's space
+	q3Vec3 e( q3Dot( absC.Column0( ), eB ), q3Dot( absC.Column1( ), eB ), q3Dot( absC.Column2( ), eB ) );
+
+	i32 axis = ~0;
+	r32 sMax = -Q3_R32_MAX;
+	for ( i32 i = 0; i < 3; ++i )
+	{
+		r32 s = q3Abs( t[ i ] ) - (eA[ i ] + e[ i ]);
+
+		if ( s > r32( 0.0 ) )
+		{
+			m->cacheAxis = i;
 			return;
+		}
+
+		if ( s > sMax )
+		{
+			sMax = s;
+			axis = i;
+		}
+	}
+
+	i32 u = (axis + 1) % 3;
+	i32 v = (axis + 2) % 3;
+	r32 sign = t[ axis ] < r32( 0.0 ) ? r32( -1.0 ) : r32( 1.0 );
+
+	// Overlap of the two face rectangles, and which bounds are A's
+	r32 lo[ 2 ] = { q3Max( -eA[ u ], t[ u ] - e[ u ] ), q3Max( -eA[ v ], t[ v ] - e[ v ] ) };
+	r32 hi[ 2 ] = { q3Min( eA[ u ], t[ u ] + e[ u ] ), q3Min( eA[ v ], t[ v ] + e[ v ] ) };
+	i32 loA = (-eA[ u ] >= t[ u ] - e[ u ] ? 1 : 0) | (-eA[ v ] >= t[ v ] - e[ v ] ? 2 : 0);
+	i32 hiA = (eA[ u ] <= t[ u ] + e[ u ] ? 1 : 0) | (eA[ v ] <= t[ v ] + e[ v ] ? 2 : 0);
+
+	q3Vec3 n( r32( 0.0 ), r32( 0.0 ), r32( 0.0 ) );
+	n[ axis ] = sign;
+
+	m->contactCount = 4;
+	m->normal = atx.rotation * n;
+	m->cacheRotation = C;
+	m->cacheTranslation = t;
+	m->cacheNormal = n;
+	m->cacheAxis = axis;
+	m->cacheCount = 4;
+
+	for ( i32 i = 0; i < 4; ++i )
+	{
+		i32 uHi = i & 1;
+		i32 vHi = (i >> 1) & 1;
+
+		q3Vec3 p;
+		p[ axis ] = t[ axis ] - sign * e[ axis ];
+		p[ u ] = uHi ? hi[ 0 ] : lo[ 0 ];
+		p[ v ] = vHi ? hi[ 1 ] : lo[ 1 ];
+
+		q3FeaturePair pair;
+		pair.inR = u8( i );
+		pair.outR = u8( ((uHi ? hiA : loA) & 1) | ((vHi ? hiA : loA) & 2) );
+		pair.inI = u8( axis );
+		pair.outI = u8( sign > r32( 0.0 ) ? 1 : 0 );
+
+		q3Contact* c = m->contacts + i;
+		c->fp = pair;
+		c->position = q3Mul( atx, p );
+		c->penetration = sMax;
+		c->localPosition = q3MulT( btx, c->position );
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Resources:
+// http://www.randygaul.net/2014/05/22/deriving-obb-to-obb-intersection-sat/
+// https://box2d.googlecode.com/files/GDC2007_ErinCatto.zip
+// https://box2d.googlecode.com/files/Box2D_Lite.zip
+void q3BoxtoBox( q3Manifold* m, q3Box* a, q3Box* b )
+{
+	q3Transform atx = a->body->GetTransform( );
+	q3Transform btx = b->body->GetTransform( );
+	q3Transform aL = a->local;
+	q3Transform bL = b->local;
+	atx = q3Mul( atx, aL );
+	btx = q3Mul( btx, bL );
+	q3Vec3 eA = a->e;
+	q3Vec3 eB = b->e;
+
+	// B's frame in A's space
+	q3Mat3 C = q3Transpose( atx.rotation ) * btx.rotation;
+
+	q3Mat3 absC;
+	bool parallel = false;
+	bool aligned = true;
+	const r32 kCosTol = r32( 1.0e-6 );
+	for ( i32 i = 0; i < 3; ++i )
+	{
+		for ( i32 j = 0; j < 3; ++j )
+		{
+			r32 val = q3Abs( C[ i ][ j ] );
+			absC[ i ][ j ] = val;
+
+			if ( val + kCosTol >= r32( 1.0 ) )
+				parallel = true;
+
+			else if ( val > kCosTol )
+				aligned = false;
+		}
+	}
+
+	// Vector from center A to center B in A's space
+	q3Vec3 t = q3MulT( atx.rotation, btx.position - atx.position );
+
+	// Temporal coherence: an axis that separated the boxes last step most
+	// likely still does, so it is tested alone before the full SAT
+	if ( m->cacheAxis != ~0 && !m->cacheCount && (m->cacheAxis < 6 || !parallel) )
+	{
+		if ( q3AxisSeparation( m->cacheAxis, t, C, absC, eA, eB ) > r32( 0.0 ) )
+			return;
+	}
+
+	// A face manifold clipped at nearly the same relative pose is reused,
+	// with its points carried along by the incident box and depths updated
+	if ( m->cacheCount && q3ManifoldCacheValid( m, C, t ) )
+	{
+		i32 axis = m->cacheAxis;
+		bool flip = axis >= 3;
+		const q3Transform& rtx = flip ? btx : atx;
+		const q3Transform& itx = flip ? atx : btx;
+		r32 e = flip ? eB[ axis - 3 ] : eA[ axis ];
+		q3Vec3 n = rtx.rotation * m->cacheNormal;
+		r32 face = q3Dot( n, rtx.position ) + e;
+		i32 i = 0;
+
+		for ( ; i < m->cacheCount; ++i )
+		{
+			q3Contact* c = m->contacts + i;
+			c->position = q3Mul( itx, c->localPosition );
+			c->penetration = q3Dot( n, c->position ) - face;
+
+			// A point leaving the reference face needs a fresh clip
+			if ( c->penetration > r32( 0.0 ) )
+				break;
+		}
+
+		if ( i == m->cacheCount )
+		{
+			m->contactCount = i;
+			m->normal = flip ? -n : n;
+			return;
+		}
+	}
+
+	m->cacheAxis = ~0;
+	m->cacheCount = 0;
+
+	// Blocks snapped to right angles, such as a vehicle resting on the
+	// platform grid, only need the face axes
+	if ( aligned )
+	{
+		q3AlignedBoxtoBox( m, atx, btx, t, C, absC, eA, eB );
+		return;
+	}
+
+	q3AxisQuery query;
+#ifdef Q3_SIMD
+	i32 separating = q3SeparatingAxesSIMD( t, C, absC, eA, eB, parallel, &query );
+#else
+	i32 separating = q3SeparatingAxes( t, C, absC, eA, eB, parallel, &query );
+#endif // Q3_SIMD
+
+	if ( separating != ~0 )
+	{
+		m->cacheAxis = separating;
+		return;
 	}
 
 	// Artificial axis bias to improve frame coherence
@@ -629,37 +818,42 @@ void q3BoxtoBox( q3Manifold* m, q3Box* a, q3Box* b )
 	i32 axis;
 	r32 sMax;
 	q3Vec3 n;
-	r32 faceMax = q3Max( aMax, bMax );
-	if ( kRelTol * eMax > faceMax + kAbsTol )
+	r32 faceMax = q3Max( query.aMax, query.bMax );
+	if ( kRelTol * query.eMax > faceMax + kAbsTol )
 	{
-		axis = eAxis;
-		sMax = eMax;
-		n = nE;
+		axis = query.eAxis;
+		sMax = query.eMax;
+		n = query.nE;
 	}
 
 	else
 	{
-		if ( kRelTol * bMax > aMax + kAbsTol )
+		if ( kRelTol * query.bMax > query.aMax + kAbsTol )
 		{
-			axis = bAxis;
-			sMax = bMax;
-			n = nB;
+			axis = query.bAxis;
+			sMax = query.bMax;
 		}
 
 		else
 		{
-			axis = aAxis;
-			sMax = aMax;
-			n = nA;
+			axis = query.aAxis;
+			sMax = query.aMax;
 		}
 	}
 
-	if ( q3Dot( n, btx.position - atx.position ) < r32( 0.0 ) )
-		n = -n;
-
 	if ( axis == ~0 )
 		return;
 
+	// Face axes are the columns of the boxes' rotations
+	if ( axis < 3 )
+		n = atx.rotation[ axis ];
+
+	else if ( axis < 6 )
+		n = btx.rotation[ axis - 3 ];
+
+	if ( q3Dot( n, btx.position - atx.position ) < r32( 0.0 ) )
+		n = -n;
+
 	if ( axis < 6 )
 	{
 		q3Transform rtx;
@@ -705,6 +899,11 @@ void q3BoxtoBox( q3Manifold* m, q3Box* a, q3Box* b )
 		{
 			m->contactCount = outNum;
 			m->normal = flip ? -n : n;
+			m->cacheRotation = C;
+			m->cacheTranslation = t;
+			m->cacheNormal = q3MulT( rtx.rotation, n );
+			m->cacheAxis = axis;
+			m->cacheCount = outNum;
 
 			for ( i32 i = 0; i < outNum; ++i )
 			{
@@ -721,6 +920,7 @@ void q3BoxtoBox( q3Manifold* m, q3Box* a, q3Box* b )
 				c->fp = out[ i ].f;
 				c->position = out[ i ].v;
 				c->penetration = depths[ i ];
+				c->localPosition = q3MulT( itx, out[ i ].v );
 			}
 		}
 	}
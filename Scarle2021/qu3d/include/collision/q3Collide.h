@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -28,6 +30,7 @@
 #define Q3COLLIDE_H
 
 #include "q3Box.h"
+#include "../common/q3Settings.h"
 
 //--------------------------------------------------------------------------------------------------
 // q3Collide
@@ -36,4 +39,28 @@ struct q3Manifold;
 
 void q3BoxtoBox( q3Manifold* m, q3Box* a, q3Box* b );
 
+// Deepest face and edge axes of two overlapping boxes. Face axes 0-2 are
+// A's, 3-5 are B's, 6-14 are the edge cross products; nE is in A's space.
+struct q3AxisQuery
+{
+	r32 aMax;
+	r32 bMax;
+	r32 eMax;
+	i32 aAxis;
+	i32 bAxis;
+	i32 eAxis;
+	q3Vec3 nE;
+};
+
+// Separating axis test of q3BoxtoBox. t and C are B's center and frame in
+// A's space and absC is |C|; edge axes are skipped when parallel is set.
+// Returns the first separating axis, or ~0 after filling in the query.
+i32 q3SeparatingAxes( const q3Vec3& t, const q3Mat3& C, const q3Mat3& absC, const q3Vec3& eA, const q3Vec3& eB, bool parallel, q3AxisQuery* q );
+
+#ifdef Q3_SIMD
+// Same test with the face and edge axes in SSE2 lanes. The results match
+// q3SeparatingAxes bit for bit. Implemented in q3CollideSIMD.cpp
+i32 q3SeparatingAxesSIMD( const q3Vec3& t, const q3Mat3& C, const q3Mat3& absC, const q3Vec3& eA, const q3Vec3& eB, bool parallel, q3AxisQuery* q );
+#endif // Q3_SIMD
+
 #endif // Q3COLLIDE_H
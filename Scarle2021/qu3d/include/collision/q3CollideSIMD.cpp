@@ -0,0 +1,197 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3CollideSIMD.cpp
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#include "q3Collide.h"
+
+#ifdef Q3_SIMD
+
+#include <emmintrin.h>
+
+//--------------------------------------------------------------------------------------------------
+// Lanes hold one axis each, the fourth lane is padding
+//--------------------------------------------------------------------------------------------------
+inline __m128 q3LanesW( r32 x, r32 y, r32 z )
+{
+	return _mm_set_ps( r32( 0.0 ), z, y, x );
+}
+
+//--------------------------------------------------------------------------------------------------
+inline __m128 q3AbsW( __m128 a )
+{
+	return _mm_andnot_ps( _mm_set1_ps( -0.0f ), a );
+}
+
+//--------------------------------------------------------------------------------------------------
+// Index of the first of count lanes whose separation is positive, or ~0
+inline i32 q3FirstSeparatingW( i32 mask, i32 count )
+{
+	for ( i32 i = 0; i < count; ++i )
+	{
+		if ( mask & (1 << i) )
+			return i;
+	}
+
+	return ~0;
+}
+
+//--------------------------------------------------------------------------------------------------
+// q3SeparatingAxesSIMD
+//--------------------------------------------------------------------------------------------------
+// Every expression repeats the operation order of q3SeparatingAxes so that
+// each lane rounds exactly like the scalar test. Separation is only decided
+// once all lanes are known, the first separating axis in scalar order wins.
+i32 q3SeparatingAxesSIMD( const q3Vec3& t, const q3Mat3& C, const q3Mat3& absC, const q3Vec3& eA, const q3Vec3& eB, bool parallel, q3AxisQuery* q )
+{
+	const __m128 zero = _mm_setzero_ps( );
+
+	// Lane k of Cw[ i ] holds C[ k ][ i ]
+	__m128 Cw[ 3 ];
+	__m128 absCw[ 3 ];
+	for ( i32 i = 0; i < 3; ++i )
+	{
+		Cw[ i ] = q3LanesW( C.ex[ i ], C.ey[ i ], C.ez[ i ] );
+		absCw[ i ] = q3LanesW( absC.ex[ i ], absC.ey[ i ], absC.ez[ i ] );
+	}
+
+	// a's axes
+	__m128 dot = _mm_add_ps( _mm_add_ps(
+		_mm_mul_ps( q3LanesW( absC.ex.x, absC.ex.y, absC.ex.z ), _mm_set1_ps( eB.x ) ),
+		_mm_mul_ps( q3LanesW( absC.ey.x, absC.ey.y, absC.ey.z ), _mm_set1_ps( eB.y ) ) ),
+		_mm_mul_ps( q3LanesW( absC.ez.x, absC.ez.y, absC.ez.z ), _mm_set1_ps( eB.z ) ) );
+	__m128 sA = _mm_sub_ps( q3AbsW( q3LanesW( t.x, t.y, t.z ) ), _mm_add_ps( q3LanesW( eA.x, eA.y, eA.z ), dot ) );
+
+	// b's axes
+	__m128 dotT = _mm_add_ps( _mm_add_ps(
+		_mm_mul_ps( _mm_set1_ps( t.x ), Cw[ 0 ] ),
+		_mm_mul_ps( _mm_set1_ps( t.y ), Cw[ 1 ] ) ),
+		_mm_mul_ps( _mm_set1_ps( t.z ), Cw[ 2 ] ) );
+	dot = _mm_add_ps( _mm_add_ps(
+		_mm_mul_ps( absCw[ 0 ], _mm_set1_ps( eA.x ) ),
+		_mm_mul_ps( absCw[ 1 ], _mm_set1_ps( eA.y ) ) ),
+		_mm_mul_ps( absCw[ 2 ], _mm_set1_ps( eA.z ) ) );
+	__m128 sB = _mm_sub_ps( q3AbsW( dotT ), _mm_add_ps( q3LanesW( eB.x, eB.y, eB.z ), dot ) );
+
+	i32 separating = q3FirstSeparatingW( _mm_movemask_ps( _mm_cmpgt_ps( sA, zero ) ), 3 );
+	if ( separating != ~0 )
+		return separating;
+
+	separating = q3FirstSeparatingW( _mm_movemask_ps( _mm_cmpgt_ps( sB, zero ) ), 3 );
+	if ( separating != ~0 )
+		return 3 + separating;
+
+	r32 s[ 4 ];
+	q->aMax = -Q3_R32_MAX;
+	q->bMax = -Q3_R32_MAX;
+	q->eMax = -Q3_R32_MAX;
+	q->aAxis = ~0;
+	q->bAxis = ~0;
+	q->eAxis = ~0;
+
+	_mm_storeu_ps( s, sA );
+	for ( i32 i = 0; i < 3; ++i )
+	{
+		if ( s[ i ] > q->aMax )
+		{
+			q->aMax = s[ i ];
+			q->aAxis = i;
+		}
+	}
+
+	_mm_storeu_ps( s, sB );
+	for ( i32 i = 0; i < 3; ++i )
+	{
+		if ( s[ i ] > q->bMax )
+		{
+			q->bMax = s[ i ];
+			q->bAxis = 3 + i;
+		}
+	}
+
+	if ( parallel )
+		return ~0;
+
+	// Edge axes, Cross( a[ i ], b[ k ] ) in lane k of row i
+	__m128 eB1 = q3LanesW( eB.y, eB.z, eB.x );
+	__m128 eB2 = q3LanesW( eB.z, eB.x, eB.y );
+	__m128 sE[ 3 ];
+	__m128 nE[ 3 ][ 3 ];
+	i32 mask = 0;
+
+	for ( i32 i = 0; i < 3; ++i )
+	{
+		i32 i1 = (i + 1) % 3;
+		i32 i2 = (i + 2) % 3;
+
+		// absC[ k + 2 ][ i ] and absC[ k + 1 ][ i ]
+		__m128 absC2 = _mm_shuffle_ps( absCw[ i ], absCw[ i ], _MM_SHUFFLE( 3, 1, 0, 2 ) );
+		__m128 absC1 = _mm_shuffle_ps( absCw[ i ], absCw[ i ], _MM_SHUFFLE( 3, 0, 2, 1 ) );
+
+		__m128 rA = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( eA[ i1 ] ), absCw[ i2 ] ), _mm_mul_ps( _mm_set1_ps( eA[ i2 ] ), absCw[ i1 ] ) );
+		__m128 rB = _mm_add_ps( _mm_mul_ps( eB1, absC2 ), _mm_mul_ps( eB2, absC1 ) );
+		__m128 d = _mm_sub_ps( _mm_mul_ps( _mm_set1_ps( t[ i2 ] ), Cw[ i1 ] ), _mm_mul_ps( _mm_set1_ps( t[ i1 ] ), Cw[ i2 ] ) );
+		sE[ i ] = _mm_sub_ps( q3AbsW( d ), _mm_add_ps( rA, rB ) );
+		mask |= (_mm_movemask_ps( _mm_cmpgt_ps( sE[ i ], zero ) ) & 7) << (3 * i);
+
+		nE[ i ][ i ] = zero;
+		nE[ i ][ i1 ] = _mm_xor_ps( Cw[ i2 ], _mm_set1_ps( -0.0f ) );
+		nE[ i ][ i2 ] = Cw[ i1 ];
+	}
+
+	separating = q3FirstSeparatingW( mask, 9 );
+	if ( separating != ~0 )
+		return 6 + separating;
+
+	for ( i32 i = 0; i < 3; ++i )
+	{
+		__m128 lengthSq = _mm_add_ps( _mm_add_ps(
+			_mm_mul_ps( nE[ i ][ 0 ], nE[ i ][ 0 ] ),
+			_mm_mul_ps( nE[ i ][ 1 ], nE[ i ][ 1 ] ) ),
+			_mm_mul_ps( nE[ i ][ 2 ], nE[ i ][ 2 ] ) );
+		__m128 l = _mm_div_ps( _mm_set1_ps( r32( 1.0 ) ), _mm_sqrt_ps( lengthSq ) );
+
+		r32 n[ 3 ][ 4 ];
+		_mm_storeu_ps( s, _mm_mul_ps( sE[ i ], l ) );
+		_mm_storeu_ps( n[ 0 ], _mm_mul_ps( nE[ i ][ 0 ], l ) );
+		_mm_storeu_ps( n[ 1 ], _mm_mul_ps( nE[ i ][ 1 ], l ) );
+		_mm_storeu_ps( n[ 2 ], _mm_mul_ps( nE[ i ][ 2 ], l ) );
+
+		for ( i32 k = 0; k < 3; ++k )
+		{
+			if ( s[ k ] > q->eMax )
+			{
+				q->eMax = s[ k ];
+				q->eAxis = 6 + 3 * i + k;
+				q->nE.Set( n[ 0 ][ k ], n[ 1 ][ k ], n[ 2 ][ k ] );
+			}
+		}
+	}
+
+	return ~0;
+}
+
+#endif // Q3_SIMD
@@ -0,0 +1,77 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3FloatState.h
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#ifndef Q3FLOATSTATE_H
+#define Q3FLOATSTATE_H
+
+#include "q3Settings.h"
+
+#ifdef Q3_SIMD
+	#include <emmintrin.h>
+#else
+	#include <cfenv>
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// q3FloatState
+//--------------------------------------------------------------------------------------------------
+// Floating point control state of the calling thread. With SSE2 this is the
+// MXCSR register: rounding mode, flush-to-zero and denormals-are-zero. Host
+// code (or a DLL it loaded) can change these, which changes the results of
+// every step. Elsewhere only the rounding mode is covered.
+inline u32 q3GetFloatState( )
+{
+#ifdef Q3_SIMD
+	return _mm_getcsr( );
+#else
+	return (u32)fegetround( );
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+inline void q3SetFloatState( u32 state )
+{
+#ifdef Q3_SIMD
+	_mm_setcsr( state );
+#else
+	fesetround( (int)state );
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+// Round to nearest, denormals kept, all exceptions masked
+inline u32 q3DefaultFloatState( )
+{
+#ifdef Q3_SIMD
+	return 0x1F80;
+#else
+	return (u32)FE_TONEAREST;
+#endif
+}
+
+#endif // Q3FLOATSTATE_H
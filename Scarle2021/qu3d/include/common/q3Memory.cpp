@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -37,6 +39,8 @@ q3Stack::q3Stack( )
 	: m_memory( 0 )
 	, m_entries( (q3StackEntry*)q3Alloc( sizeof( q3StackEntry ) * 64 ) )
 	, m_index( 0 )
+	, m_peakIndex( 0 )
+	, m_overflowCount( 0 )
 	, m_allocation( 0 )
 	, m_entryCount( 0 )
 	, m_entryCapacity( 64 )
@@ -57,17 +61,62 @@ void q3Stack::Reserve( u32 size )
 {
 	assert( !m_index );
 
-	if ( size == 0 )
+	if ( size <= m_stackSize )
 		return;
 
-	if ( size >= m_stackSize )
+	++m_overflowCount;
+
+	// Leave some headroom so a slowly growing scene does not reallocate
+	// on every step
+	size += size / 2;
+
+	if ( m_memory ) q3Free( m_memory );
+	m_memory = (u8*)q3Alloc( size );
+	m_stackSize = size;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Stack::SetArena( u32 size )
+{
+	assert( !m_index );
+
+	m_peakIndex = 0;
+	m_overflowCount = 0;
+
+	if ( size != m_stackSize )
 	{
 		if ( m_memory ) q3Free( m_memory );
-		m_memory = (u8*)q3Alloc( size );
+		m_memory = size ? (u8*)q3Alloc( size ) : NULL;
 		m_stackSize = size;
 	}
 }
 
+//--------------------------------------------------------------------------------------------------
+void q3Stack::Reset( )
+{
+	m_index = 0;
+	m_allocation = 0;
+	m_entryCount = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+u32 q3Stack::GetSize( ) const
+{
+	return m_stackSize;
+}
+
+//--------------------------------------------------------------------------------------------------
+u32 q3Stack::GetPeakSize( ) const
+{
+	return m_peakIndex;
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3Stack::GetOverflowCount( ) const
+{
+	return m_overflowCount;
+}
+
 //--------------------------------------------------------------------------------------------------
 void *q3Stack::Allocate( i32 size )
 {
@@ -88,6 +137,9 @@ void *q3Stack::Allocate( i32 size )
 	entry->data = m_memory + m_index;
 	m_index += size;
 
+	if ( m_index > m_peakIndex )
+		m_peakIndex = m_index;
+
 	m_allocation += size;
 	++m_entryCount;
 
@@ -117,30 +169,37 @@ void q3Stack::Free( void *data )
 //--------------------------------------------------------------------------------------------------
 q3Heap::q3Heap( )
 {
-	m_memory = (q3Header*)q3Alloc( q3k_heapSize );
-	m_memory->next = NULL;
-	m_memory->prev = NULL;
-	m_memory->size = q3k_heapSize;
+	m_pages = NULL;
 
 	m_freeBlocks = (q3FreeBlock*)q3Alloc( sizeof( q3FreeBlock ) * q3k_heapInitialCapacity );
-	m_freeBlockCount = 1;
+	m_freeBlockCount = 0;
 	m_freeBlockCapacity = q3k_heapInitialCapacity;
 
-	m_freeBlocks->header = m_memory;
-	m_freeBlocks->size = q3k_heapSize;
+	m_bytesUsed = 0;
+	m_peakBytesUsed = 0;
+	m_bytesReserved = 0;
 }
 
 //--------------------------------------------------------------------------------------------------
 q3Heap::~q3Heap( )
 {
-	q3Free( m_memory );
+	q3Page* page = m_pages;
+
+	while ( page )
+	{
+		q3Page* next = page->next;
+		q3Free( page );
+		page = next;
+	}
+
 	q3Free( m_freeBlocks );
 }
 
 //--------------------------------------------------------------------------------------------------
 void *q3Heap::Allocate( i32 size )
 {
-	i32 sizeNeeded = size + sizeof( q3Header );
+	// Keep every header pointer aligned
+	i32 sizeNeeded = (size + i32( sizeof( q3Header ) ) + 7) & ~7;
 	q3FreeBlock* firstFit = NULL;
 
 	for ( i32 i = 0; i < m_freeBlockCount; ++i )
@@ -155,20 +214,37 @@ void *q3Heap::Allocate( i32 size )
 	}
 
 	if ( !firstFit )
-		return NULL;
+	{
+		AddPage( q3Max( q3k_heapSize, sizeNeeded ) );
+		firstFit = m_freeBlocks + m_freeBlockCount - 1;
+	}
 
 	q3Header* node = firstFit->header;
-	q3Header* newNode = Q3_PTR_ADD( node, sizeNeeded );
-	node->size = sizeNeeded;
 
-	firstFit->size -= sizeNeeded;
-	firstFit->header = newNode;
+	// Hand out the whole block when the rest could not hold another header
+	if ( firstFit->size - sizeNeeded <= i32( sizeof( q3Header ) ) )
+		RemoveFreeBlock( node );
 
-	newNode->next = node->next;
-	if ( node->next )
-		node->next->prev = newNode;
-	node->next = newNode;
-	newNode->prev = node;
+	else
+	{
+		q3Header* newNode = Q3_PTR_ADD( node, sizeNeeded );
+		newNode->size = node->size - sizeNeeded;
+		newNode->freeIndex = node->freeIndex;
+		node->size = sizeNeeded;
+		node->freeIndex = -1;
+
+		firstFit->size = newNode->size;
+		firstFit->header = newNode;
+
+		newNode->next = node->next;
+		if ( node->next )
+			node->next->prev = newNode;
+		node->next = newNode;
+		newNode->prev = node;
+	}
+
+	m_bytesUsed += node->size;
+	m_peakBytesUsed = q3Max( m_peakBytesUsed, m_bytesUsed );
 
 	return Q3_PTR_ADD( node, sizeof( q3Header ) );
 }
@@ -178,98 +254,122 @@ void q3Heap::Free( void *memory )
 {
 	assert( memory );
 	q3Header* node = (q3Header*)Q3_PTR_ADD( memory, -i32( sizeof( q3Header ) ) );
+	assert( node->freeIndex == -1 );
+
+	m_bytesUsed -= node->size;
 
+	// Headers only link to neighbours within the same page
 	q3Header* next = node->next;
 	q3Header* prev = node->prev;
-	q3FreeBlock* nextBlock = NULL;
-	i32 prevBlockIndex = ~0;
-	q3FreeBlock* prevBlock = NULL;
-	i32 freeBlockCount = m_freeBlockCount;
 
-	for ( i32 i = 0; i < freeBlockCount; ++i )
+	if ( prev && prev->freeIndex != -1 )
 	{
-		q3FreeBlock* block = m_freeBlocks + i;
-		q3Header* header = block->header;
-
-		if ( header == next )
-			nextBlock = block;
+		prev->size += node->size;
+		prev->next = next;
+		if ( next )
+			next->prev = prev;
 
-		else if ( header == prev )
-		{
-			prevBlock = block;
-			prevBlockIndex = i;
-		}
+		node = prev;
 	}
 
-	bool merged = false;
+	else
+		AddFreeBlock( node );
 
-	if ( prevBlock )
+	if ( next && next->freeIndex != -1 )
 	{
-		merged = true;
+		RemoveFreeBlock( next );
 
-		prev->next = next;
-		if ( next )
-			next->prev = prev;
+		node->size += next->size;
+		node->next = next->next;
+		if ( next->next )
+			next->next->prev = node;
+	}
 
-		prevBlock->size += node->size;
-		prev->size = prevBlock->size;
+	m_freeBlocks[ node->freeIndex ].size = node->size;
 
-		if ( nextBlock )
-		{
-			nextBlock->header = prev;
-			nextBlock->size += prev->size;
-			prev->size = nextBlock->size;
+	// Give empty pages back to the system, always keeping at least one
+	if ( !node->prev && !node->next && m_pages->next )
+	{
+		q3Page* page = (q3Page*)Q3_PTR_ADD( node, -i32( sizeof( q3Page ) ) );
+		q3Page** link = &m_pages;
 
-			q3Header* nextnext = next->next;
-			prev->next = nextnext;
+		while ( *link != page )
+			link = &(*link)->next;
 
-			if ( nextnext )
-				nextnext->prev = prev;
+		*link = page->next;
+		m_bytesReserved -= page->size;
 
-			// Remove the nextBlock from the freeBlocks array
-			assert( m_freeBlockCount );
-			assert( prevBlockIndex != ~0 );
-			--m_freeBlockCount;
-			m_freeBlocks[ prevBlockIndex ] = m_freeBlocks[ m_freeBlockCount ];
-		}
+		RemoveFreeBlock( node );
+		q3Free( page );
 	}
+}
 
-	else if ( nextBlock )
-	{
-		merged = true;
+//--------------------------------------------------------------------------------------------------
+void q3Heap::GetStats( q3MemoryStats* stats ) const
+{
+	i32 largestFree = 0;
 
-		nextBlock->header = node;
-		nextBlock->size += node->size;
-		node->size = nextBlock->size;
+	for ( i32 i = 0; i < m_freeBlockCount; ++i )
+		largestFree = q3Max( largestFree, m_freeBlocks[ i ].size );
 
-		q3Header* nextnext = next->next;
+	i32 bookkeeping = m_freeBlockCapacity * i32( sizeof( q3FreeBlock ) );
 
-		if ( nextnext )
-			nextnext->prev = node;
+	stats->bytesUsed = m_bytesUsed + bookkeeping;
+	stats->peakBytesUsed = m_peakBytesUsed + bookkeeping;
+	stats->bytesReserved = m_bytesReserved + bookkeeping;
+	stats->bytesFragmented = m_bytesReserved - m_bytesUsed - largestFree;
+}
 
-		node->next = nextnext;
-	}
+//--------------------------------------------------------------------------------------------------
+void q3Heap::AddPage( i32 size )
+{
+	q3Page* page = (q3Page*)q3Alloc( sizeof( q3Page ) + size );
+	page->next = m_pages;
+	page->size = size;
+	m_pages = page;
+	m_bytesReserved += size;
+
+	q3Header* header = (q3Header*)Q3_PTR_ADD( page, sizeof( q3Page ) );
+	header->next = NULL;
+	header->prev = NULL;
+	header->size = size;
+
+	AddFreeBlock( header );
+}
 
-	if ( !merged )
+//--------------------------------------------------------------------------------------------------
+void q3Heap::AddFreeBlock( q3Header* header )
+{
+	if ( m_freeBlockCount == m_freeBlockCapacity )
 	{
-		q3FreeBlock block;
-		block.header = node;
-		block.size = node->size;
+		q3FreeBlock* oldBlocks = m_freeBlocks;
+		i32 oldCapacity = m_freeBlockCapacity;
 
-		if ( m_freeBlockCount == m_freeBlockCapacity )
-		{
-			q3FreeBlock* oldBlocks = m_freeBlocks;
-			i32 oldCapacity = m_freeBlockCapacity;
+		m_freeBlockCapacity *= 2;
+		m_freeBlocks = (q3FreeBlock*)q3Alloc( sizeof( q3FreeBlock ) * m_freeBlockCapacity );
 
-			m_freeBlockCapacity *= 2;
-			m_freeBlocks = (q3FreeBlock*)q3Alloc( sizeof( q3FreeBlock ) * m_freeBlockCapacity );
+		memcpy( m_freeBlocks, oldBlocks, sizeof( q3FreeBlock ) * oldCapacity );
+		q3Free( oldBlocks );
+	}
 
-			memcpy( m_freeBlocks, oldBlocks, sizeof( q3FreeBlock ) * oldCapacity );
-			q3Free( oldBlocks );
-		}
+	header->freeIndex = m_freeBlockCount;
 
-		m_freeBlocks[ m_freeBlockCount++ ] = block;
-	}
+	q3FreeBlock* block = m_freeBlocks + m_freeBlockCount++;
+	block->header = header;
+	block->size = header->size;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Heap::RemoveFreeBlock( q3Header* header )
+{
+	i32 index = header->freeIndex;
+	assert( index >= 0 && index < m_freeBlockCount );
+
+	--m_freeBlockCount;
+	m_freeBlocks[ index ] = m_freeBlocks[ m_freeBlockCount ];
+	m_freeBlocks[ index ].header->freeIndex = index;
+
+	header->freeIndex = -1;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -284,6 +384,9 @@ q3PagedAllocator::q3PagedAllocator( i32 elementSize, i32 elementsPerPage )
 	m_pageCount = 0;
 
 	m_freeList = NULL;
+
+	m_blockCount = 0;
+	m_peakBlockCount = 0;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -295,6 +398,9 @@ q3PagedAllocator::~q3PagedAllocator( )
 //--------------------------------------------------------------------------------------------------
 void* q3PagedAllocator::Allocate( )
 {
+	++m_blockCount;
+	m_peakBlockCount = q3Max( m_peakBlockCount, m_blockCount );
+
 	if ( m_freeList )
 	{
 		q3Block* data = m_freeList;
@@ -350,6 +456,7 @@ void q3PagedAllocator::Free( void* data )
 
 	((q3Block*)data)->next = m_freeList;
 	m_freeList = ((q3Block*)data);
+	--m_blockCount;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -364,6 +471,19 @@ void q3PagedAllocator::Clear( )
 		page = next;
 	}
 
+	m_pages = NULL;
 	m_freeList = NULL;
 	m_pageCount = 0;
+	m_blockCount = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3PagedAllocator::GetStats( q3MemoryStats* stats ) const
+{
+	stats->bytesUsed = m_blockCount * m_blockSize;
+	stats->peakBytesUsed = m_peakBlockCount * m_blockSize;
+	stats->bytesReserved = m_pageCount * (m_blockSize * m_blocksPerPage + i32( sizeof( q3Page ) ));
+
+	// Every free block fits any allocation
+	stats->bytesFragmented = 0;
 }
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -47,6 +49,19 @@ inline void q3Free( void* memory )
 #define Q3_PTR_ADD( P, BYTES ) \
 	((decltype( P ))(((u8 *)P) + (BYTES)))
 
+//--------------------------------------------------------------------------------------------------
+// q3MemoryStats
+//--------------------------------------------------------------------------------------------------
+// All fields are in bytes and include allocator bookkeeping, so stats of
+// several allocators can simply be summed.
+struct q3MemoryStats
+{
+	i32 bytesUsed;			// Handed out and not yet freed
+	i32 peakBytesUsed;		// Largest bytesUsed seen so far
+	i32 bytesReserved;		// Taken from the system
+	i32 bytesFragmented;	// Free, but outside the largest free block
+};
+
 //--------------------------------------------------------------------------------------------------
 // q3Stack
 //--------------------------------------------------------------------------------------------------
@@ -68,11 +83,25 @@ public:
 	void *Allocate( i32 size );
 	void Free( void *data );
 
+	// Frame arena mode. size bytes are reserved once up front and Reserve
+	// only reallocates when a request does not fit, which counts as an
+	// overflow. Zero goes back to reserving on demand.
+	void SetArena( u32 size );
+
+	// Drops every allocation, called at the end of a step
+	void Reset( );
+
+	u32 GetSize( ) const;
+	u32 GetPeakSize( ) const;	// Most bytes allocated at once since SetArena
+	i32 GetOverflowCount( ) const;
+
 private:
 	u8* m_memory;
 	q3StackEntry* m_entries;
 
 	u32 m_index;
+	u32 m_peakIndex;
+	i32 m_overflowCount;
 
 	i32 m_allocation;
 	i32 m_entryCount;
@@ -83,11 +112,15 @@ private:
 //--------------------------------------------------------------------------------------------------
 // q3Heap
 //--------------------------------------------------------------------------------------------------
-// 20 MB heap size, change as necessary
+// 20 MB page size, change as necessary. The first page is only allocated
+// by the first Allocate, and the heap chains on another page whenever no
+// free block is large enough.
 const i32 q3k_heapSize = 1024 * 1024 * 20;
 const i32 q3k_heapInitialCapacity = 1024;
 
-// Operates on first fit basis in attempt to improve cache coherency
+// Operates on first fit basis in attempt to improve cache coherency.
+// Every header knows its slot in the free block array, so Free merges
+// with its neighbours in constant time.
 class q3Heap
 {
 private:
@@ -96,6 +129,7 @@ private:
 		q3Header* next;
 		q3Header* prev;
 		i32 size;
+		i32 freeIndex;	// Slot in m_freeBlocks, -1 while allocated
 	};
 
 	struct q3FreeBlock
@@ -104,6 +138,12 @@ private:
 		i32 size;
 	};
 
+	struct q3Page
+	{
+		q3Page* next;
+		i32 size;
+	};
+
 public:
 	q3Heap( );
 	~q3Heap( );
@@ -111,12 +151,22 @@ public:
 	void *Allocate( i32 size );
 	void Free( void *memory );
 
+	void GetStats( q3MemoryStats* stats ) const;
+
 private:
-	q3Header* m_memory;
+	void AddPage( i32 size );
+	void AddFreeBlock( q3Header* header );
+	void RemoveFreeBlock( q3Header* header );
+
+	q3Page* m_pages;
 
 	q3FreeBlock* m_freeBlocks;
 	i32 m_freeBlockCount;
 	i32 m_freeBlockCapacity;
+
+	i32 m_bytesUsed;
+	i32 m_peakBytesUsed;
+	i32 m_bytesReserved;
 };
 
 //--------------------------------------------------------------------------------------------------
@@ -144,6 +194,8 @@ public:
 
 	void Clear( );
 
+	void GetStats( q3MemoryStats* stats ) const;
+
 private:
 	i32 m_blockSize;
 	i32 m_blocksPerPage;
@@ -152,6 +204,9 @@ private:
 	i32 m_pageCount;
 
 	q3Block *m_freeList;
+
+	i32 m_blockCount;
+	i32 m_peakBlockCount;
 };
 
 #endif // Q3MEMORY_H
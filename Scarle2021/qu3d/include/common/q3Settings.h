@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -41,4 +43,22 @@
 
 #define Q3_PENETRATION_SLOP r32( 0.05 )
 
+// Relative pose drift under which box to box collision reuses its last manifold
+#define Q3_MANIFOLD_CACHE_LINEAR r32( 0.005 )
+
+#define Q3_MANIFOLD_CACHE_ANGULAR r32( 0.001 )
+
+// SSE2 is used for wide solver paths when the target guarantees it
+#if defined( __SSE2__ ) || defined( _M_X64 ) || (defined( _M_IX86_FP ) && _M_IX86_FP >= 2)
+	#define Q3_SIMD
+#endif
+
+#define Q3_SIMD_WIDTH 4
+
+// Step timers and counters, see q3Scene::GetStepStats. Define Q3_NO_PROFILE
+// to compile them out.
+#ifndef Q3_NO_PROFILE
+	#define Q3_PROFILE
+#endif
+
 #endif // Q3SETTINGS_H
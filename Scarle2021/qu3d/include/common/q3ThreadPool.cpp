@@ -0,0 +1,173 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3ThreadPool.cpp
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#include <new>
+
+#include "q3ThreadPool.h"
+#include "q3Memory.h"
+#include "q3FloatState.h"
+#include "../math/q3Math.h"
+
+//--------------------------------------------------------------------------------------------------
+// q3ThreadPool
+//--------------------------------------------------------------------------------------------------
+q3ThreadPool::q3ThreadPool( i32 threadCount )
+	: m_task( NULL )
+	, m_param( NULL )
+	, m_count( 0 )
+	, m_next( 0 )
+	, m_floatState( 0 )
+	, m_generation( 0 )
+	, m_busy( 0 )
+	, m_quit( false )
+{
+	m_workerCount = q3Max( threadCount, 1 ) - 1;
+	m_workers = NULL;
+
+	if ( m_workerCount )
+	{
+		m_workers = (std::thread*)q3Alloc( sizeof( std::thread ) * m_workerCount );
+
+		for ( i32 i = 0; i < m_workerCount; ++i )
+			new (m_workers + i) std::thread( &q3ThreadPool::WorkerMain, this );
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+q3ThreadPool::~q3ThreadPool( )
+{
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_quit = true;
+	}
+
+	m_wake.notify_all( );
+
+	for ( i32 i = 0; i < m_workerCount; ++i )
+	{
+		m_workers[ i ].join( );
+		m_workers[ i ].~thread( );
+	}
+
+	if ( m_workers )
+		q3Free( m_workers );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ThreadPool::ParallelFor( q3TaskFunction task, void* param, i32 count )
+{
+	if ( count <= 0 )
+		return;
+
+	// Not worth waking anybody up
+	if ( !m_workerCount || count == 1 )
+	{
+		for ( i32 i = 0; i < count; ++i )
+			task( param, i );
+
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_task = task;
+		m_param = param;
+		m_count = count;
+		m_next.store( 0 );
+		m_floatState = q3GetFloatState( );
+		m_busy = m_workerCount;
+		++m_generation;
+	}
+
+	m_wake.notify_all( );
+
+	RunTasks( );
+
+	// Wait for the stragglers so the caller may safely read the results
+	std::unique_lock<std::mutex> lock( m_mutex );
+	m_done.wait( lock, [ this ] { return m_busy == 0; } );
+	m_task = NULL;
+	m_param = NULL;
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3ThreadPool::GetThreadCount( ) const
+{
+	return m_workerCount + 1;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ThreadPool::WorkerMain( )
+{
+	u32 generation = 0;
+	u32 floatState = q3GetFloatState( );
+
+	for ( ; ; )
+	{
+		{
+			std::unique_lock<std::mutex> lock( m_mutex );
+			m_wake.wait( lock, [ this, generation ] { return m_quit || m_generation != generation; } );
+
+			if ( m_quit )
+				return;
+
+			generation = m_generation;
+
+			if ( m_floatState != floatState )
+			{
+				floatState = m_floatState;
+				q3SetFloatState( floatState );
+			}
+		}
+
+		RunTasks( );
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			last = --m_busy == 0;
+		}
+
+		if ( last )
+			m_done.notify_one( );
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ThreadPool::RunTasks( )
+{
+	for ( ; ; )
+	{
+		i32 i = m_next.fetch_add( 1 );
+
+		if ( i >= m_count )
+			break;
+
+		m_task( m_param, i );
+	}
+}
@@ -0,0 +1,86 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3ThreadPool.h
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#ifndef Q3THREADPOOL_H
+#define Q3THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "q3Types.h"
+
+//--------------------------------------------------------------------------------------------------
+// q3ThreadPool
+//--------------------------------------------------------------------------------------------------
+// Task signature used by ParallelFor. index is in the range [0, count).
+typedef void (*q3TaskFunction)( void* param, i32 index );
+
+// Small fork-join pool. Workers sleep until ParallelFor hands them a batch,
+// then pull indices from a shared counter until the batch is exhausted. The
+// calling thread works on the batch as well, so a pool of N threads only
+// creates N - 1 workers.
+class q3ThreadPool
+{
+public:
+	q3ThreadPool( i32 threadCount );
+	~q3ThreadPool( );
+
+	// Calls task( param, i ) once for every i in [0, count) and returns after
+	// all calls have finished. Order of execution across indices is not
+	// defined, so tasks must only write to memory owned by their index.
+	// Workers run the batch with the caller's floating point state, see
+	// q3GetFloatState.
+	void ParallelFor( q3TaskFunction task, void* param, i32 count );
+
+	i32 GetThreadCount( ) const;
+
+private:
+	void WorkerMain( );
+	void RunTasks( );
+
+	std::thread* m_workers;
+	i32 m_workerCount;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+
+	q3TaskFunction m_task;
+	void* m_param;
+	i32 m_count;
+	std::atomic<i32> m_next;
+	u32 m_floatState;
+
+	u32 m_generation;
+	i32 m_busy;
+	bool m_quit;
+};
+
+#endif // Q3THREADPOOL_H
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -32,6 +34,10 @@
 
 //--------------------------------------------------------------------------------------------------
 // q3Body
+//--------------------------------------------------------------------------------------------------
+// Removals the running mass sums may take before they are summed again
+const i32 q3k_massRebaseInterval = 64;
+
 //--------------------------------------------------------------------------------------------------
 q3Body::q3Body( const q3BodyDef& def, q3Scene* scene )
 {
@@ -42,12 +48,15 @@ q3Body::q3Body( const q3BodyDef& def, q3Scene* scene )
 	m_q.Set( q3Normalize( def.axis ), def.angle );
 	m_tx.rotation = m_q.ToMat3( );
 	m_tx.position = def.position;
+	m_prevTx = m_tx;
+	m_prevQ = m_q;
 	m_sleepTime = r32( 0.0 );
 	m_gravityScale = def.gravityScale;
 	m_layers = def.layers;
 	m_userData = def.userData;
 	m_scene = scene;
 	m_flags = 0;
+	m_island = NULL;
 	m_linearDamping = def.linearDamping;
 	m_angularDamping = def.angularDamping;
 
@@ -89,13 +98,20 @@ q3Body::q3Body( const q3BodyDef& def, q3Scene* scene )
 
 	m_boxes = NULL;
 	m_contactList = NULL;
+
+	m_boxMass = r32( 0.0 );
+	q3Identity( m_boxMoment );
+	m_boxInertia = q3Diagonal( r32( 0.0 ) );
+	m_massRemovals = 0;
+
+	FinalizeMassData( );
 }
 
 //--------------------------------------------------------------------------------------------------
 const q3Box* q3Body::AddBox( const q3BoxDef& def )
 {
 	q3AABB aabb;
-	q3Box* box = (q3Box*)m_scene->m_heap.Allocate( sizeof( q3Box ) );
+	q3Box* box = (q3Box*)m_scene->m_boxAllocator.Allocate( );
 	box->local = def.m_tx;
 	box->e = def.m_e;
 	box->next = m_boxes;
@@ -107,8 +123,18 @@ const q3Box* q3Body::AddBox( const q3BoxDef& def )
 	box->restitution = def.m_restitution;
 	box->density = def.m_density;
 	box->sensor = def.m_sensor;
+	box->serial = m_scene->m_boxSerial++;
 
-	CalculateMassData( );
+	AccumulateMassData( box, r32( 1.0 ) );
+
+	// Joins the broadphase in EndShapeEdit
+	if ( m_flags & eShapeEdit )
+	{
+		box->broadPhaseIndex = q3k_nullProxyKey;
+		return box;
+	}
+
+	FinalizeMassData( );
 
 	m_scene->m_contactManager.m_broadphase.InsertBox( box, aabb );
 	m_scene->m_newBox = true;
@@ -149,41 +175,108 @@ void q3Body::RemoveBox( const q3Box* box )
 	// This shape was not connected to this body.
 	assert( found );
 
-	// Remove all contacts associated with this shape
-	q3ContactEdge* edge = m_contactList;
-	while ( edge )
+	// Boxes added during a shape edit have no proxy or contacts yet
+	if ( box->broadPhaseIndex != q3k_nullProxyKey )
 	{
-		q3ContactConstraint* contact = edge->constraint;
-		edge = edge->next;
+		// Remove all contacts associated with this shape
+		q3ContactEdge* edge = m_contactList;
+		while ( edge )
+		{
+			q3ContactConstraint* contact = edge->constraint;
+			edge = edge->next;
+
+			q3Box* A = contact->A;
+			q3Box* B = contact->B;
 
-		q3Box* A = contact->A;
-		q3Box* B = contact->B;
+			if ( box == A || box == B )
+				m_scene->m_contactManager.RemoveContact( contact );
+		}
 
-		if ( box == A || box == B )
-			m_scene->m_contactManager.RemoveContact( contact );
+		m_scene->m_contactManager.m_broadphase.RemoveBox( box );
 	}
 
-	m_scene->m_contactManager.m_broadphase.RemoveBox( box );
+	// Subtracting a box that outweighs the rest cancels most of the running
+	// sums, and every removal leaves some rounding behind. The remaining
+	// boxes are summed again from exact zeros then, and after every
+	// q3k_massRebaseInterval removals, so the error stays bounded.
+	r32 massBefore = m_boxMass;
+	AccumulateMassData( box, r32( -1.0 ) );
+	++m_massRemovals;
 
-	CalculateMassData( );
+	if ( !m_boxes || m_boxMass < massBefore - m_boxMass || m_massRemovals >= q3k_massRebaseInterval )
+		SumMassData( );
+
+	if ( !(m_flags & eShapeEdit) )
+		FinalizeMassData( );
 
-	m_scene->m_heap.Free( (void*)box );
+	m_scene->m_boxAllocator.Free( (void*)box );
 }
 
 //--------------------------------------------------------------------------------------------------
 void q3Body::RemoveAllBoxes( )
 {
+	// Contacts are looked up by the proxies of their boxes, so they go first
+	m_scene->m_contactManager.RemoveContactsFromBody( this );
+
 	while ( m_boxes )
 	{
 		q3Box* next = m_boxes->next;
 
-		m_scene->m_contactManager.m_broadphase.RemoveBox( m_boxes );
-		m_scene->m_heap.Free( (void*)m_boxes );
+		if ( m_boxes->broadPhaseIndex != q3k_nullProxyKey )
+			m_scene->m_contactManager.m_broadphase.RemoveBox( m_boxes );
+
+		m_scene->m_boxAllocator.Free( (void*)m_boxes );
 
 		m_boxes = next;
 	}
 
-	m_scene->m_contactManager.RemoveContactsFromBody( this );
+	m_boxMass = r32( 0.0 );
+	q3Identity( m_boxMoment );
+	m_boxInertia = q3Diagonal( r32( 0.0 ) );
+	m_massRemovals = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Body::BeginShapeEdit( )
+{
+	assert( !(m_flags & eShapeEdit) );
+
+	m_flags |= eShapeEdit;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Body::EndShapeEdit( )
+{
+	assert( m_flags & eShapeEdit );
+
+	m_flags &= ~eShapeEdit;
+
+	// One full pass also drops any rounding the running sums picked up
+	CalculateMassData( );
+
+	i32 count = 0;
+	for ( q3Box* box = m_boxes; box; box = box->next )
+	{
+		if ( box->broadPhaseIndex == q3k_nullProxyKey )
+			++count;
+	}
+
+	if ( !count )
+		return;
+
+	q3Box** boxes = (q3Box**)q3Alloc( sizeof( q3Box* ) * count );
+	count = 0;
+
+	for ( q3Box* box = m_boxes; box; box = box->next )
+	{
+		if ( box->broadPhaseIndex == q3k_nullProxyKey )
+			boxes[ count++ ] = box;
+	}
+
+	m_scene->m_contactManager.m_broadphase.InsertBoxes( boxes, count );
+	m_scene->m_newBox = true;
+
+	q3Free( boxes );
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -380,6 +473,9 @@ void q3Body::SetTransform( const q3Vec3& position )
 	m_worldCenter = position;
 
 	SynchronizeProxies( );
+
+	m_prevTx = m_tx;
+	m_prevQ = m_q;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -390,6 +486,9 @@ void q3Body::SetTransform( const q3Vec3& position, const q3Vec3& axis, r32 angle
 	m_tx.rotation = m_q.ToMat3( );
 
 	SynchronizeProxies( );
+
+	m_prevTx = m_tx;
+	m_prevQ = m_q;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -416,6 +515,18 @@ const q3Quaternion q3Body::GetQuaternion( ) const
 	return m_q;
 }
 
+//--------------------------------------------------------------------------------------------------
+const q3Transform q3Body::GetPreviousTransform( ) const
+{
+	return m_prevTx;
+}
+
+//--------------------------------------------------------------------------------------------------
+const q3Quaternion q3Body::GetPreviousQuaternion( ) const
+{
+	return m_prevQ;
+}
+
 //--------------------------------------------------------------------------------------------------
 void* q3Body::GetUserData( ) const
 {
@@ -531,12 +642,45 @@ void q3Body::Dump( FILE* file, i32 index ) const
 //--------------------------------------------------------------------------------------------------
 void q3Body::CalculateMassData( )
 {
-	q3Mat3 inertia = q3Diagonal( r32( 0.0 ) );
+	SumMassData( );
+	FinalizeMassData( );
+}
+
+//--------------------------------------------------------------------------------------------------
+// Walks the box list, which is newest first, so the result can differ in
+// the last bits from running sums built up in insertion order
+void q3Body::SumMassData( )
+{
+	m_boxMass = r32( 0.0 );
+	q3Identity( m_boxMoment );
+	m_boxInertia = q3Diagonal( r32( 0.0 ) );
+	m_massRemovals = 0;
+
+	for ( q3Box* box = m_boxes; box; box = box->next)
+		AccumulateMassData( box, r32( 1.0 ) );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Body::AccumulateMassData( const q3Box* box, r32 sign )
+{
+	if ( box->density == r32( 0.0 ) )
+		return;
+
+	q3MassData md;
+	box->ComputeMass( &md );
+	m_boxMass += md.mass * sign;
+	m_boxInertia += md.inertia * sign;
+	m_boxMoment += md.center * (md.mass * sign);
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Body::FinalizeMassData( )
+{
 	m_invInertiaModel = q3Diagonal( r32( 0.0 ) );
 	m_invInertiaWorld = q3Diagonal( r32( 0.0 ) );
 	m_invMass = r32( 0.0 );
 	m_mass = r32( 0.0 );
-	r32 mass = r32( 0.0 );
+	r32 mass = m_boxMass;
 
 	if ( m_flags & eStatic || m_flags &eKinematic )
 	{
@@ -545,20 +689,7 @@ void q3Body::CalculateMassData( )
 		return;
 	}
 
-	q3Vec3 lc;
-	q3Identity( lc );
-
-	for ( q3Box* box = m_boxes; box; box = box->next)
-	{
-		if ( box->density == r32( 0.0 ) )
-			continue;
-
-		q3MassData md;
-		box->ComputeMass( &md );
-		mass += md.mass;
-		inertia += md.inertia;
-		lc += md.center * md.mass;
-	}
+	q3Vec3 lc = m_boxMoment;
 
 	if ( mass > r32( 0.0 ) )
 	{
@@ -567,8 +698,7 @@ void q3Body::CalculateMassData( )
 		lc *= m_invMass;
 		q3Mat3 identity;
 		q3Identity( identity );
-		inertia -= (identity * q3Dot( lc, lc ) - q3OuterProduct( lc, lc )) * mass;
-		m_invInertiaModel = q3Inverse( inertia );
+		m_invInertiaModel = q3Inverse( m_boxInertia - (identity * q3Dot( lc, lc ) - q3OuterProduct( lc, lc )) * mass );
 
 		if ( m_flags & eLockAxisX )
 			q3Identity( m_invInertiaModel.ex );
@@ -585,6 +715,7 @@ void q3Body::CalculateMassData( )
 		m_invMass = r32( 1.0 );
 		m_invInertiaModel = q3Diagonal( r32( 0.0 ) );
 		m_invInertiaWorld = q3Diagonal( r32( 0.0 ) );
+		q3Identity( lc );
 	}
 
 	m_localCenter = lc;
@@ -604,8 +735,13 @@ void q3Body::SynchronizeProxies( )
 	q3Box* box = m_boxes;
 	while ( box )
 	{
-		box->ComputeAABB( tx, &aabb );
-		broadphase->Update( box->broadPhaseIndex, aabb );
+		// Boxes still waiting for EndShapeEdit get their AABB on insertion
+		if ( box->broadPhaseIndex != q3k_nullProxyKey )
+		{
+			box->ComputeAABB( tx, &aabb );
+			broadphase->Update( box->broadPhaseIndex, aabb );
+		}
+
 		box = box->next;
 	}
 }
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -41,6 +43,7 @@ class q3BoxDef;
 struct q3ContactEdge;
 class q3Render;
 struct q3Box;
+struct q3IslandGroup;
 
 enum q3BodyType
 {
@@ -67,6 +70,16 @@ public:
 	// Removes all boxes from this body and the broadphase.
 	void RemoveAllBoxes( );
 
+	// AddBox and RemoveBox keep running mass, centroid and inertia sums, so
+	// each call costs the same no matter how many boxes the body has.
+	// Between BeginShapeEdit and EndShapeEdit they skip even that work:
+	// mass data is recomputed once and all new boxes enter the broadphase
+	// together in EndShapeEdit. Use this when adding or removing many boxes
+	// at once, e.g. while loading. Do not step the scene or query the
+	// body's boxes before EndShapeEdit is called.
+	void BeginShapeEdit( );
+	void EndShapeEdit( );
+
 	void ApplyLinearForce( const q3Vec3& force );
 	void ApplyForceAtWorldPoint( const q3Vec3& force, const q3Vec3& point );
 	void ApplyLinearImpulse( const q3Vec3& impulse );
@@ -93,6 +106,13 @@ public:
 	i32 GetLayers( ) const;
 	const q3Quaternion GetQuaternion( ) const;
 	void* GetUserData( ) const;	
+
+	// Transform and orientation from before the last q3Scene::Step. Blend
+	// them with the current ones by q3Scene::GetInterpolationAlpha to draw
+	// smoothly when stepping with q3Scene::Advance. SetTransform sets both
+	// to the new transform, so a teleport is not smeared across a frame.
+	const q3Transform GetPreviousTransform( ) const;
+	const q3Quaternion GetPreviousQuaternion( ) const;
   
 	void SetLinearDamping( r32 damping );
 	r32 GetLinearDamping( r32 damping ) const;
@@ -102,7 +122,8 @@ public:
 	// Manipulating the transformation of a body manually will result in
 	// non-physical behavior. Contacts are updated upon the next call to
 	// q3Scene::Step( ). Parameters are in world space. All body types
-	// can be updated.
+	// can be updated. Bodies moved every frame are cheaper to move with
+	// q3Scene::SetTransforms.
 	void SetTransform( const q3Vec3& position );
 	void SetTransform( const q3Vec3& position, const q3Vec3& axis, r32 angle );
 
@@ -129,6 +150,8 @@ private:
 		eLockAxisX	= 0x100,
 		eLockAxisY	= 0x200,
 		eLockAxisZ	= 0x400,
+		eShapeEdit	= 0x800,
+		eUnsynced	= 0x1000,	// Moved by q3Scene::SetTransforms, proxies not updated yet
 	};
 
 	q3Mat3 m_invInertiaModel;
@@ -141,6 +164,8 @@ private:
 	q3Vec3 m_torque;
 	q3Transform m_tx;
 	q3Quaternion m_q;
+	q3Transform m_prevTx;
+	q3Quaternion m_prevQ;
 	q3Vec3 m_localCenter;
 	q3Vec3 m_worldCenter;
 	r32 m_sleepTime;
@@ -154,21 +179,38 @@ private:
 	q3Body* m_next;
 	q3Body* m_prev;
 	i32 m_islandIndex;
+	q3IslandGroup* m_island;	// NULL for static bodies
+	q3Body* m_islandNext;
+	q3Body* m_islandPrev;
+	i32 m_serial;	// Creation order within the scene
 
 	r32 m_linearDamping;
 	r32 m_angularDamping;
 
+	// Running sums over all boxes with density, inertia is about the
+	// body origin and the center is weighted by mass. AddBox adds to them
+	// in insertion order, a full pass sums the box list newest first.
+	r32 m_boxMass;
+	q3Vec3 m_boxMoment;
+	q3Mat3 m_boxInertia;
+	i32 m_massRemovals;	// RemoveBox calls since the sums were last rebuilt
+
 	q3ContactEdge* m_contactList;
 
 	friend class q3Scene;
 	friend struct q3Manifold;
 	friend class q3ContactManager;
+	friend class q3BroadPhase;
 	friend struct q3Island;
 	friend struct q3ContactSolver;
+	friend class q3IslandGraph;
 
 	q3Body( const q3BodyDef& def, q3Scene* scene );
 
 	void CalculateMassData( );
+	void SumMassData( );
+	void AccumulateMassData( const q3Box* box, r32 sign );
+	void FinalizeMassData( );
 	void SynchronizeProxies( );
 };
 
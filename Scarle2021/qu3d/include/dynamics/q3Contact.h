@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -87,6 +89,7 @@ struct q3Contact
 	r32 normalMass;				// Normal constraint mass
 	r32 tangentMass[ 2 ];		// Tangent constraint mass
 	q3FeaturePair fp;			// Features on A and B for this contact
+	q3Vec3 localPosition;		// Contact point in the incident box's space
 	u8 warmStarted;				// Used for debug rendering
 };
 
@@ -102,6 +105,13 @@ struct q3Manifold
 	q3Contact contacts[ 8 ];
 	i32 contactCount;
 
+	// Temporal coherence cache of q3BoxtoBox
+	q3Mat3 cacheRotation;		// B's frame in A's space when the contacts were clipped
+	q3Vec3 cacheTranslation;	// B's center in A's space when the contacts were clipped
+	q3Vec3 cacheNormal;			// Reference face normal in the reference box's space
+	i32 cacheAxis;				// Last separating or reference face axis, ~0 if none
+	i32 cacheCount;				// Contacts clipped against the reference face, 0 if separating
+
 	q3Manifold* next;
 	q3Manifold* prev;
 
@@ -127,6 +137,8 @@ struct q3ContactConstraint
 	q3ContactEdge edgeB;
 	q3ContactConstraint* next;
 	q3ContactConstraint* prev;
+	q3ContactConstraint* islandNext;
+	q3ContactConstraint* islandPrev;
 
 	r32 friction;
 	r32 restitution;
@@ -137,7 +149,8 @@ struct q3ContactConstraint
 	{
 		eColliding    = 0x00000001, // Set when contact collides during a step
 		eWasColliding = 0x00000002, // Set when two objects stop colliding
-		eIsland       = 0x00000004, // For internal marking during island forming
+		eIsland       = 0x00000004, // Set while in the contact list of a q3IslandGroup
+		eRestored     = 0x00000008, // For internal marking in q3Scene::LoadState
 	};
 
 	i32 m_flags;
@@ -146,6 +159,7 @@ struct q3ContactConstraint
 	friend class q3Scene;
 	friend struct q3Island;
 	friend struct q3ContactSolver;
+	friend class q3IslandGraph;
 };
 
 #endif // Q3CONTACT_H
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -30,18 +32,20 @@
 #include "q3Contact.h"
 #include "../scene/q3Scene.h"
 #include "../debug/q3Render.h"
+#include "../common/q3ThreadPool.h"
 
 //--------------------------------------------------------------------------------------------------
 // q3ContactManager
 //--------------------------------------------------------------------------------------------------
-q3ContactManager::q3ContactManager( q3Stack* stack )
+q3ContactManager::q3ContactManager( q3Stack* stack, q3BroadPhaseType broadPhaseType )
 	: m_stack( stack )
 	, m_allocator( sizeof( q3ContactConstraint ), 256 )
-	, m_broadphase( this )
+	, m_broadphase( this, broadPhaseType )
 {
 	m_contactList = NULL;
 	m_contactCount = 0;
 	m_contactListener = NULL;
+	m_threadPool = NULL;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -52,26 +56,19 @@ void q3ContactManager::AddContact( q3Box *A, q3Box *B )
 	if ( !bodyA->CanCollide( bodyB ) )
 		return;
 
-	// Search for existing matching contact
 	// Return if found duplicate to avoid duplicate constraints
-	// Mark pre-existing duplicates as active
-	q3ContactEdge* edge = A->body->m_contactList;
-	while ( edge )
-	{
-		if ( edge->other == bodyB )
-		{
-			q3Box *shapeA = edge->constraint->A;
-			q3Box *shapeB = edge->constraint->B;
+	if ( m_pairTable.Find( A->broadPhaseIndex, B->broadPhaseIndex ) )
+		return;
 
-			// @TODO: Verify this against Box2D; not sure if this is all we need here
-			if( (A == shapeA) && (B == shapeB) )
-				return;
-		}
+	CreateContact( A, B );
+}
 
-		edge = edge->next;
-	}
+//--------------------------------------------------------------------------------------------------
+q3ContactConstraint* q3ContactManager::CreateContact( q3Box *A, q3Box *B )
+{
+	q3Body *bodyA = A->body;
+	q3Body *bodyB = B->body;
 
-	// Create new contact
 	q3ContactConstraint *contact = (q3ContactConstraint*)m_allocator.Allocate( );
 	contact->A = A;
 	contact->B = B;
@@ -82,10 +79,29 @@ void q3ContactManager::AddContact( q3Box *A, q3Box *B )
 	contact->friction = q3MixFriction( A, B );
 	contact->restitution = q3MixRestitution( A, B );
 	contact->manifold.contactCount = 0;
+	contact->manifold.cacheAxis = ~0;
+	contact->manifold.cacheCount = 0;
 
 	for ( i32 i = 0; i < 8; ++i )
 		contact->manifold.contacts[ i ].warmStarted = 0;
 
+	m_pairTable.Insert( A->broadPhaseIndex, B->broadPhaseIndex, contact );
+	LinkContact( contact );
+
+	bodyA->SetToAwake( );
+	bodyB->SetToAwake( );
+
+	++m_contactCount;
+
+	return contact;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ContactManager::LinkContact( q3ContactConstraint *contact )
+{
+	q3Body *bodyA = contact->bodyA;
+	q3Body *bodyB = contact->bodyB;
+
 	contact->prev = NULL;
 	contact->next = m_contactList;
 	if ( m_contactList )
@@ -111,11 +127,6 @@ void q3ContactManager::AddContact( q3Box *A, q3Box *B )
 	if ( bodyB->m_contactList )
 		bodyB->m_contactList->prev = &contact->edgeB;
 	bodyB->m_contactList = &contact->edgeB;
-
-	bodyA->SetToAwake( );
-	bodyB->SetToAwake( );
-
-	++m_contactCount;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -130,6 +141,9 @@ void q3ContactManager::RemoveContact( q3ContactConstraint *contact )
 	q3Body *A = contact->bodyA;
 	q3Body *B = contact->bodyB;
 
+	m_islandGraph.UnlinkContact( contact );
+	m_pairTable.Remove( contact->A->broadPhaseIndex, contact->B->broadPhaseIndex );
+
 	// Remove from A
 	if ( contact->edgeA.prev )
 		contact->edgeA.prev->next = contact->edgeA.next;
@@ -196,6 +210,13 @@ void q3ContactManager::RemoveFromBroadphase( q3Body *body )
 //--------------------------------------------------------------------------------------------------
 void q3ContactManager::TestCollisions( void )
 {
+	// Removals wake bodies up, which decides whether later contacts in the
+	// list are updated, so this pass stays serial and in list order. The
+	// surviving contacts are gathered for the narrowphase.
+	m_stack->Reserve( sizeof( q3ContactConstraint* ) * m_contactCount );
+	q3ContactConstraint** constraints = (q3ContactConstraint**)m_stack->Allocate( sizeof( q3ContactConstraint* ) * m_contactCount );
+	i32 count = 0;
+
 	q3ContactConstraint* constraint = m_contactList;
 
 	while( constraint )
@@ -205,9 +226,12 @@ void q3ContactManager::TestCollisions( void )
 		q3Body *bodyA = A->body;
 		q3Body *bodyB = B->body;
 
-		constraint->m_flags &= ~q3ContactConstraint::eIsland;
+		// Static bodies take the sleep state of the last island touching
+		// them, which says nothing about the body on the other side
+		bool awakeA = bodyA->IsAwake( ) && !(bodyA->m_flags & q3Body::eStatic);
+		bool awakeB = bodyB->IsAwake( ) && !(bodyB->m_flags & q3Body::eStatic);
 
-		if( !bodyA->IsAwake( ) && !bodyB->IsAwake( ) )
+		if( !awakeA && !awakeB )
 		{
 			constraint = constraint->next;
 			continue;
@@ -229,50 +253,91 @@ void q3ContactManager::TestCollisions( void )
 			constraint = next;
 			continue;
 		}
-		q3Manifold* manifold = &constraint->manifold;
-		q3Manifold oldManifold = constraint->manifold;
-		q3Vec3 ot0 = oldManifold.tangentVectors[ 0 ];
-		q3Vec3 ot1 = oldManifold.tangentVectors[ 1 ];
-		constraint->SolveCollision( );
-		q3ComputeBasis( manifold->normal, manifold->tangentVectors, manifold->tangentVectors + 1 );
-
-		for ( i32 i = 0; i < manifold->contactCount; ++i )
-		{
-			q3Contact *c = manifold->contacts + i;
-			c->tangentImpulse[ 0 ] = c->tangentImpulse[ 1 ] = c->normalImpulse = r32( 0.0 );
-			u8 oldWarmStart = c->warmStarted;
-			c->warmStarted = u8( 0 );
 
-			for ( i32 j = 0; j < oldManifold.contactCount; ++j )
-			{
-				q3Contact *oc = oldManifold.contacts + j;
-				if ( c->fp.key == oc->fp.key )
-				{
-					c->normalImpulse = oc->normalImpulse;
-
-					// Attempt to re-project old friction solutions
-					q3Vec3 friction = ot0 * oc->tangentImpulse[ 0 ] + ot1 * oc->tangentImpulse[ 1 ];
-					c->tangentImpulse[ 0 ] = q3Dot( friction, manifold->tangentVectors[ 0 ] );
-					c->tangentImpulse[ 1 ] = q3Dot( friction, manifold->tangentVectors[ 1 ] );
-					c->warmStarted = q3Max( oldWarmStart, u8( oldWarmStart + 1 ) );
-					break;
-				}
-			}
-		}
+		constraints[ count++ ] = constraint;
+		constraint = constraint->next;
+	}
 
-		if ( m_contactListener )
-		{
-			i32 now_colliding = constraint->m_flags & q3ContactConstraint::eColliding;
-			i32 was_colliding = constraint->m_flags & q3ContactConstraint::eWasColliding;
+	// Every contact only touches its own manifold and flags
+	if ( m_threadPool )
+		m_threadPool->ParallelFor( SolveCollision, constraints, count );
 
-			if ( now_colliding && !was_colliding )
-				m_contactListener->BeginContact( constraint );
+	else
+	{
+		for ( i32 i = 0; i < count; ++i )
+			SolveCollision( constraints, i );
+	}
 
-			else if ( !now_colliding && was_colliding )
-				m_contactListener->EndContact( constraint );
-		}
+	// Islands are updated and listener events go out in list order
+	for ( i32 i = 0; i < count; ++i )
+	{
+		constraint = constraints[ i ];
+		i32 now_colliding = constraint->m_flags & q3ContactConstraint::eColliding;
+		i32 was_colliding = constraint->m_flags & q3ContactConstraint::eWasColliding;
+		i32 linked = constraint->m_flags & q3ContactConstraint::eIsland;
 
-		constraint = constraint->next;
+		// Goes by the island flag rather than was_colliding, a contact can
+		// stop and start touching again without the latter noticing
+		if ( now_colliding && !linked )
+			m_islandGraph.LinkContact( constraint );
+
+		else if ( !now_colliding && linked )
+			m_islandGraph.UnlinkContact( constraint );
+
+		if ( !m_contactListener )
+			continue;
+
+		if ( now_colliding && !was_colliding )
+			m_contactListener->BeginContact( constraint );
+
+		else if ( !now_colliding && was_colliding )
+			m_contactListener->EndContact( constraint );
+	}
+
+	m_stack->Free( constraints );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ContactManager::SolveCollision( void* param, i32 index )
+{
+	q3ContactConstraint* constraint = ((q3ContactConstraint**)param)[ index ];
+
+	q3Manifold* manifold = &constraint->manifold;
+	q3Vec3 ot0 = manifold->tangentVectors[ 0 ];
+	q3Vec3 ot1 = manifold->tangentVectors[ 1 ];
+
+	// Only the live contacts are kept for warm starting, the manifold is
+	// mostly collision cache
+	i32 oldCount = manifold->contactCount;
+	q3Contact oldContacts[ 8 ];
+	for ( i32 i = 0; i < oldCount; ++i )
+		oldContacts[ i ] = manifold->contacts[ i ];
+
+	constraint->SolveCollision( );
+	q3ComputeBasis( manifold->normal, manifold->tangentVectors, manifold->tangentVectors + 1 );
+
+	for ( i32 i = 0; i < manifold->contactCount; ++i )
+	{
+		q3Contact *c = manifold->contacts + i;
+		c->tangentImpulse[ 0 ] = c->tangentImpulse[ 1 ] = c->normalImpulse = r32( 0.0 );
+		u8 oldWarmStart = c->warmStarted;
+		c->warmStarted = u8( 0 );
+
+		for ( i32 j = 0; j < oldCount; ++j )
+		{
+			q3Contact *oc = oldContacts + j;
+			if ( c->fp.key == oc->fp.key )
+			{
+				c->normalImpulse = oc->normalImpulse;
+
+				// Attempt to re-project old friction solutions
+				q3Vec3 friction = ot0 * oc->tangentImpulse[ 0 ] + ot1 * oc->tangentImpulse[ 1 ];
+				c->tangentImpulse[ 0 ] = q3Dot( friction, manifold->tangentVectors[ 0 ] );
+				c->tangentImpulse[ 1 ] = q3Dot( friction, manifold->tangentVectors[ 1 ] );
+				c->warmStarted = q3Max( oldWarmStart, u8( oldWarmStart + 1 ) );
+				break;
+			}
+		}
 	}
 }
 
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -29,7 +31,9 @@
 
 #include "../common/q3Types.h"
 #include "../broadphase/q3BroadPhase.h"
+#include "../broadphase/q3PairTable.h"
 #include "../common/q3Memory.h"
+#include "q3IslandGraph.h"
 
 //--------------------------------------------------------------------------------------------------
 // q3ContactManager
@@ -40,16 +44,25 @@ struct q3Box;
 class q3Body;
 class q3Render;
 class q3Stack;
+class q3ThreadPool;
 
 class q3ContactManager
 {
 public:
-	q3ContactManager( q3Stack* stack );
+	q3ContactManager( q3Stack* stack, q3BroadPhaseType broadPhaseType );
 
 	// Add a new contact constraint for a pair of objects
 	// unless the contact constraint already exists
 	void AddContact( q3Box *A, q3Box *B );
 
+	// Creates the contact constraint for a pair without checking whether the
+	// boxes can collide or already have a contact
+	q3ContactConstraint* CreateContact( q3Box *A, q3Box *B );
+
+	// Pushes a contact to the front of the contact list and the contact
+	// lists of both bodies. Does not touch the pair table.
+	void LinkContact( q3ContactConstraint *contact );
+
 	// Has broadphase find all contacts and call AddContact on the
 	// ContactManager for each pair found
 	void FindNewContacts( void );
@@ -64,7 +77,10 @@ public:
 	// Remove contacts without broadphase overlap
 	// Solves contact manifolds
 	void TestCollisions( void );
-	static void SolveCollision( void* param );
+
+	// Runs the narrowphase and warm start matching for one contact of the
+	// array gathered by TestCollisions, param is that array
+	static void SolveCollision( void* param, i32 index );
 
 	void RenderContacts( q3Render* debugDrawer ) const;
 
@@ -73,8 +89,11 @@ private:
 	i32 m_contactCount;
 	q3Stack* m_stack;
 	q3PagedAllocator m_allocator;
+	q3PairTable m_pairTable;		// Proxy keys of A and B to their contact
 	q3BroadPhase m_broadphase;
+	q3IslandGraph m_islandGraph;	// Touching contacts and their bodies
 	q3ContactListener *m_contactListener;
+	q3ThreadPool* m_threadPool;
 
 	friend class q3BroadPhase;
 	friend class q3Scene;
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -31,6 +33,47 @@
 #include "q3Body.h"
 #include "../common/q3Geometry.h"
 #include "../common/q3Settings.h"
+#include "../common/q3ThreadPool.h"
+
+//--------------------------------------------------------------------------------------------------
+// Schedule entries handed to one thread at a time when a level is solved
+// in parallel
+const i32 q3k_solverChunkSize = 8;
+
+struct q3SolverChunkTask
+{
+	q3ContactSolver *solver;
+	i32 first;
+	i32 last;
+	bool preSolve;
+
+	// Largest velocity change of the level, merged from all chunks. The
+	// maximum does not depend on the order chunks finish in.
+	std::atomic<r32> maxDelta;
+};
+
+//--------------------------------------------------------------------------------------------------
+static void q3SolveChunkTask( void* param, i32 index )
+{
+	q3SolverChunkTask* task = (q3SolverChunkTask*)param;
+	i32 first = task->first + index * q3k_solverChunkSize;
+	i32 last = q3Min( first + q3k_solverChunkSize, task->last );
+	r32 maxDelta = r32( 0.0 );
+
+	for ( i32 i = first; i < last; ++i )
+	{
+		if ( task->preSolve )
+			task->solver->PreSolveEntry( task->solver->m_schedule[ i ] );
+
+		else
+			maxDelta = q3Max( maxDelta, task->solver->SolveEntry( task->solver->m_schedule[ i ] ) );
+	}
+
+	r32 old = task->maxDelta.load( std::memory_order_relaxed );
+	while ( maxDelta > old && !task->maxDelta.compare_exchange_weak( old, maxDelta, std::memory_order_relaxed ) )
+	{
+	}
+}
 
 //--------------------------------------------------------------------------------------------------
 // q3ContactSolver
@@ -42,11 +85,33 @@ void q3ContactSolver::Initialize( q3Island *island )
 	m_contacts = island->m_contactStates;
 	m_velocities = m_island->m_velocities;
 	m_enableFriction = island->m_enableFriction;
+	m_relaxation = island->m_relaxation;
+	m_schedule = NULL;
+	m_scheduleCount = 0;
+	m_levelStarts = NULL;
+	m_levelCount = 0;
+	m_batches = NULL;
+	m_batchCount = 0;
+	m_threadPool = island->m_threadPool;
+	m_dt = island->m_dt;
+
+	bool batch = false;
+#ifdef Q3_SIMD
+	batch = island->m_enableSIMD;
+#endif // Q3_SIMD
+
+	if ( (batch || m_threadPool) && m_contactCount > 1 )
+		BuildSchedule( batch );
 }
 
 //--------------------------------------------------------------------------------------------------
 void q3ContactSolver::ShutDown( void )
 {
+#ifdef Q3_SIMD
+	for ( i32 i = 0; i < m_batchCount; ++i )
+		UnpackBatch( m_batches + i );
+#endif // Q3_SIMD
+
 	for ( i32 i = 0; i < m_contactCount; ++i )
 	{
 		q3ContactConstraintState *c = m_contacts + i;
@@ -64,133 +129,311 @@ void q3ContactSolver::ShutDown( void )
 }
 
 //--------------------------------------------------------------------------------------------------
-void q3ContactSolver::PreSolve( r32 dt )
+void q3ContactSolver::BuildSchedule( bool batch )
 {
+	// Level every constraint one past the last constraint touching either
+	// of its dynamic bodies. Constraints on one level share no dynamic
+	// body, and each body still sees its constraints in island order, so
+	// solving level by level gives the same result as the scalar loop.
+	// Static and kinematic bodies are never written to by the solver and
+	// do not count as conflicts.
+	i32 bodyCount = m_island->m_bodyCount;
+	i32 *bodyLevels = m_island->m_solverScratch;
+	i32 *levels = bodyLevels + bodyCount;
+	i32 *levelStarts = levels + m_contactCount;
+	i32 *order = levelStarts + m_contactCount + 1;
+
+	for ( i32 i = 0; i < bodyCount; ++i )
+		bodyLevels[ i ] = 0;
+
+	for ( i32 i = 0; i <= m_contactCount; ++i )
+		levelStarts[ i ] = 0;
+
+	i32 levelCount = 0;
+
 	for ( i32 i = 0; i < m_contactCount; ++i )
 	{
 		q3ContactConstraintState *cs = m_contacts + i;
+		bool dynamicA = (m_island->m_bodies[ cs->indexA ]->m_flags & q3Body::eDynamic) != 0;
+		bool dynamicB = (m_island->m_bodies[ cs->indexB ]->m_flags & q3Body::eDynamic) != 0;
 
-		q3Vec3 vA = m_velocities[ cs->indexA ].v;
-		q3Vec3 wA = m_velocities[ cs->indexA ].w;
-		q3Vec3 vB = m_velocities[ cs->indexB ].v;
-		q3Vec3 wB = m_velocities[ cs->indexB ].w;
+		i32 level = 0;
 
-		for ( i32 j = 0; j < cs->contactCount; ++j )
-		{
-			q3ContactState *c = cs->contacts + j;
+		if ( dynamicA )
+			level = q3Max( level, bodyLevels[ cs->indexA ] );
 
-			// Precalculate JM^-1JT for contact and friction constraints
-			q3Vec3 raCn = q3Cross( c->ra, cs->normal );
-			q3Vec3 rbCn = q3Cross( c->rb, cs->normal );
-			r32 nm = cs->mA + cs->mB;
-			r32 tm[ 2 ];
-			tm[ 0 ] = nm;
-			tm[ 1 ] = nm;
+		if ( dynamicB )
+			level = q3Max( level, bodyLevels[ cs->indexB ] );
 
-			nm += q3Dot( raCn, cs->iA * raCn ) + q3Dot( rbCn, cs->iB * rbCn );
-			c->normalMass = q3Invert( nm );
+		if ( dynamicA )
+			bodyLevels[ cs->indexA ] = level + 1;
 
-			for ( i32 i = 0; i < 2; ++i )
-			{
-				q3Vec3 raCt = q3Cross( cs->tangentVectors[ i ], c->ra );
-				q3Vec3 rbCt = q3Cross( cs->tangentVectors[ i ], c->rb );
-				tm[ i ] += q3Dot( raCt, cs->iA * raCt ) + q3Dot( rbCt, cs->iB * rbCt );
-				c->tangentMass[ i ] = q3Invert( tm[ i ] );
-			}
+		if ( dynamicB )
+			bodyLevels[ cs->indexB ] = level + 1;
+
+		levels[ i ] = level;
+		++levelStarts[ level + 1 ];
+		levelCount = q3Max( levelCount, level + 1 );
+	}
+
+	// Counting sort keeps island order inside each level
+	for ( i32 i = 0; i < levelCount; ++i )
+		levelStarts[ i + 1 ] += levelStarts[ i ];
+
+	for ( i32 i = 0; i < m_contactCount; ++i )
+		order[ levelStarts[ levels[ i ] ]++ ] = i;
+
+	// The counting pass left every start at the end of its level. The
+	// level array is no longer needed and now holds the schedule, and the
+	// level starts are rewritten to index the schedule.
+	m_schedule = levels;
+	m_levelStarts = levelStarts;
+	m_levelCount = levelCount;
+	m_batches = m_island->m_contactBatches;
+
+	i32 first = 0;
+	for ( i32 level = 0; level < levelCount; ++level )
+	{
+		i32 last = levelStarts[ level ];
+		m_levelStarts[ level ] = m_scheduleCount;
 
-			// Precalculate bias factor
-			c->bias = -Q3_BAUMGARTE * (r32( 1.0 ) / dt) * q3Min( r32( 0.0 ), c->penetration + Q3_PENETRATION_SLOP );
+		while ( first < last )
+		{
+			i32 laneCount = batch ? q3Min( last - first, Q3_SIMD_WIDTH ) : 1;
 
-			// Warm start contact
-			q3Vec3 P = cs->normal * c->normalImpulse;
+			if ( laneCount == 1 )
+				m_schedule[ m_scheduleCount++ ] = order[ first ];
 
-			if ( m_enableFriction )
+			else
 			{
-				P += cs->tangentVectors[ 0 ] * c->tangentImpulse[ 0 ];
-				P += cs->tangentVectors[ 1 ] * c->tangentImpulse[ 1 ];
+				assert( m_batchCount < m_contactCount / 2 );
+				q3ContactBatch *batch = m_batches + m_batchCount;
+				m_schedule[ m_scheduleCount++ ] = ~m_batchCount;
+				++m_batchCount;
+
+				batch->laneCount = laneCount;
+				for ( i32 lane = 0; lane < Q3_SIMD_WIDTH; ++lane )
+					batch->constraints[ lane ] = lane < laneCount ? order[ first + lane ] : -1;
 			}
 
-			vA -= P * cs->mA;
-			wA -= cs->iA * q3Cross( c->ra, P );
+			first += laneCount;
+		}
+	}
 
-			vB += P * cs->mB;
-			wB += cs->iB * q3Cross( c->rb, P );
+	m_levelStarts[ levelCount ] = m_scheduleCount;
 
-			// Add in restitution bias
-			r32 dv = q3Dot( vB + q3Cross( wB, c->rb ) - vA - q3Cross( wA, c->ra ), cs->normal );
+	// Nothing to gain from the schedule, solve in plain scalar order
+	if ( m_batchCount == 0 && !m_threadPool )
+	{
+		m_schedule = NULL;
+		m_scheduleCount = 0;
+		m_levelStarts = NULL;
+		m_levelCount = 0;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ContactSolver::PreSolve( r32 dt )
+{
+	m_dt = dt;
+
+	if ( m_scheduleCount )
+	{
+		RunSchedule( true );
+		return;
+	}
+
+	for ( i32 i = 0; i < m_contactCount; ++i )
+		PreSolveConstraint( m_contacts + i, dt );
+}
+
+//--------------------------------------------------------------------------------------------------
+r32 q3ContactSolver::Solve( )
+{
+	if ( m_scheduleCount )
+		return RunSchedule( false );
 
-			if ( dv < -r32( 1.0 ) )
-				c->bias += -(cs->restitution) * dv;
+	r32 maxDelta = r32( 0.0 );
+
+	for ( i32 i = 0; i < m_contactCount; ++i )
+		maxDelta = q3Max( maxDelta, SolveConstraint( m_contacts + i ) );
+
+	return maxDelta;
+}
+
+//--------------------------------------------------------------------------------------------------
+r32 q3ContactSolver::RunSchedule( bool preSolve )
+{
+	r32 maxDelta = r32( 0.0 );
+
+	if ( !m_threadPool )
+	{
+		for ( i32 i = 0; i < m_scheduleCount; ++i )
+		{
+			if ( preSolve )
+				PreSolveEntry( m_schedule[ i ] );
+
+			else
+				maxDelta = q3Max( maxDelta, SolveEntry( m_schedule[ i ] ) );
 		}
 
+		return maxDelta;
+	}
+
+	// Levels run one after the other, the entries within a level touch
+	// disjoint dynamic bodies and can run at the same time
+	q3SolverChunkTask task;
+	task.solver = this;
+	task.preSolve = preSolve;
+
+	for ( i32 i = 0; i < m_levelCount; ++i )
+	{
+		task.first = m_levelStarts[ i ];
+		task.last = m_levelStarts[ i + 1 ];
+		task.maxDelta.store( r32( 0.0 ), std::memory_order_relaxed );
+
+		i32 chunkCount = (task.last - task.first + q3k_solverChunkSize - 1) / q3k_solverChunkSize;
+		m_threadPool->ParallelFor( q3SolveChunkTask, &task, chunkCount );
+
+		maxDelta = q3Max( maxDelta, task.maxDelta.load( std::memory_order_relaxed ) );
+	}
+
+	return maxDelta;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ContactSolver::PreSolveEntry( i32 entry )
+{
+	if ( entry >= 0 )
+	{
+		PreSolveConstraint( m_contacts + entry, m_dt );
+		return;
+	}
+
+#ifdef Q3_SIMD
+	PackBatch( m_batches + ~entry );
+	PreSolveBatch( m_batches + ~entry, m_dt );
+#endif // Q3_SIMD
+}
+
+//--------------------------------------------------------------------------------------------------
+r32 q3ContactSolver::SolveEntry( i32 entry )
+{
+	if ( entry >= 0 )
+		return SolveConstraint( m_contacts + entry );
+
+#ifdef Q3_SIMD
+	return SolveBatch( m_batches + ~entry );
+#else
+	return r32( 0.0 );
+#endif // Q3_SIMD
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ContactSolver::PreSolveConstraint( q3ContactConstraintState *cs, r32 dt )
+{
+	q3Vec3 vA = m_velocities[ cs->indexA ].v;
+	q3Vec3 wA = m_velocities[ cs->indexA ].w;
+	q3Vec3 vB = m_velocities[ cs->indexB ].v;
+	q3Vec3 wB = m_velocities[ cs->indexB ].w;
+
+	for ( i32 j = 0; j < cs->contactCount; ++j )
+	{
+		q3ContactState *c = cs->contacts + j;
+
+		// Precalculate JM^-1JT for contact and friction constraints
+		q3Vec3 raCn = q3Cross( c->ra, cs->normal );
+		q3Vec3 rbCn = q3Cross( c->rb, cs->normal );
+		r32 nm = cs->mA + cs->mB;
+		r32 tm[ 2 ];
+		tm[ 0 ] = nm;
+		tm[ 1 ] = nm;
+
+		nm += q3Dot( raCn, cs->iA * raCn ) + q3Dot( rbCn, cs->iB * rbCn );
+		c->normalMass = q3Invert( nm );
+
+		for ( i32 i = 0; i < 2; ++i )
+		{
+			q3Vec3 raCt = q3Cross( cs->tangentVectors[ i ], c->ra );
+			q3Vec3 rbCt = q3Cross( cs->tangentVectors[ i ], c->rb );
+			tm[ i ] += q3Dot( raCt, cs->iA * raCt ) + q3Dot( rbCt, cs->iB * rbCt );
+			c->tangentMass[ i ] = q3Invert( tm[ i ] );
+		}
+
+		// Precalculate bias factor
+		c->bias = -Q3_BAUMGARTE * (r32( 1.0 ) / dt) * q3Min( r32( 0.0 ), c->penetration + Q3_PENETRATION_SLOP );
+
+		// Warm start contact
+		q3Vec3 P = cs->normal * c->normalImpulse;
+
+		if ( m_enableFriction )
+		{
+			P += cs->tangentVectors[ 0 ] * c->tangentImpulse[ 0 ];
+			P += cs->tangentVectors[ 1 ] * c->tangentImpulse[ 1 ];
+		}
+
+		vA -= P * cs->mA;
+		wA -= cs->iA * q3Cross( c->ra, P );
+
+		vB += P * cs->mB;
+		wB += cs->iB * q3Cross( c->rb, P );
+
+		// Add in restitution bias
+		r32 dv = q3Dot( vB + q3Cross( wB, c->rb ) - vA - q3Cross( wA, c->ra ), cs->normal );
+
+		if ( dv < -r32( 1.0 ) )
+			c->bias += -(cs->restitution) * dv;
+	}
+
+	// Bodies without mass are never moved by a contact. Leaving their
+	// slots alone lets constraints sharing a static body run in parallel.
+	if ( cs->mA != r32( 0.0 ) )
+	{
 		m_velocities[ cs->indexA ].v = vA;
 		m_velocities[ cs->indexA ].w = wA;
+	}
+
+	if ( cs->mB != r32( 0.0 ) )
+	{
 		m_velocities[ cs->indexB ].v = vB;
 		m_velocities[ cs->indexB ].w = wB;
 	}
 }
 
 //--------------------------------------------------------------------------------------------------
-void q3ContactSolver::Solve( )
+r32 q3ContactSolver::SolveConstraint( q3ContactConstraintState *cs )
 {
-	for ( i32 i = 0; i < m_contactCount; ++i )
+	q3Vec3 vA = m_velocities[ cs->indexA ].v;
+	q3Vec3 wA = m_velocities[ cs->indexA ].w;
+	q3Vec3 vB = m_velocities[ cs->indexB ].v;
+	q3Vec3 wB = m_velocities[ cs->indexB ].w;
+	r32 maxLambda = r32( 0.0 );
+
+	for ( i32 j = 0; j < cs->contactCount; ++j )
 	{
-		q3ContactConstraintState *cs = m_contacts + i;
+		q3ContactState *c = cs->contacts + j;
 
-		q3Vec3 vA = m_velocities[ cs->indexA ].v;
-		q3Vec3 wA = m_velocities[ cs->indexA ].w;
-		q3Vec3 vB = m_velocities[ cs->indexB ].v;
-		q3Vec3 wB = m_velocities[ cs->indexB ].w;
+		// relative velocity at contact
+		q3Vec3 dv = vB + q3Cross( wB, c->rb ) - vA - q3Cross( wA, c->ra );
 
-		for ( i32 j = 0; j < cs->contactCount; ++j )
+		// Friction
+		if ( m_enableFriction )
 		{
-			q3ContactState *c = cs->contacts + j;
-
-			// relative velocity at contact
-			q3Vec3 dv = vB + q3Cross( wB, c->rb ) - vA - q3Cross( wA, c->ra );
-
-			// Friction
-			if ( m_enableFriction )
-			{
-				for ( i32 i = 0; i < 2; ++i )
-				{
-					r32 lambda = -q3Dot( dv, cs->tangentVectors[ i ] ) * c->tangentMass[ i ];
-
-					// Calculate frictional impulse
-					r32 maxLambda = cs->friction * c->normalImpulse;
-
-					// Clamp frictional impulse
-					r32 oldPT = c->tangentImpulse[ i ];
-					c->tangentImpulse[ i ] = q3Clamp( -maxLambda, maxLambda, oldPT + lambda );
-					lambda = c->tangentImpulse[ i ] - oldPT;
-
-					// Apply friction impulse
-					q3Vec3 impulse = cs->tangentVectors[ i ] * lambda;
-					vA -= impulse * cs->mA;
-					wA -= cs->iA * q3Cross( c->ra, impulse );
-
-					vB += impulse * cs->mB;
-					wB += cs->iB * q3Cross( c->rb, impulse );
-				}
-			}
-
-			// Normal
+			for ( i32 i = 0; i < 2; ++i )
 			{
-				dv = vB + q3Cross( wB, c->rb ) - vA - q3Cross( wA, c->ra );
-
-				// Normal impulse
-				r32 vn = q3Dot( dv, cs->normal );
+				r32 lambda = -q3Dot( dv, cs->tangentVectors[ i ] ) * c->tangentMass[ i ] * m_relaxation;
 
-				// Factor in positional bias to calculate impulse scalar j
-				r32 lambda = c->normalMass * (-vn + c->bias);
+				// Calculate frictional impulse
+				r32 maxPT = cs->friction * c->normalImpulse;
 
-				// Clamp impulse
-				r32 tempPN = c->normalImpulse;
-				c->normalImpulse = q3Max( tempPN + lambda, r32( 0.0 ) );
-				lambda = c->normalImpulse - tempPN;
+				// Clamp frictional impulse
+				r32 oldPT = c->tangentImpulse[ i ];
+				c->tangentImpulse[ i ] = q3Clamp( -maxPT, maxPT, oldPT + lambda );
+				lambda = c->tangentImpulse[ i ] - oldPT;
+				maxLambda = q3Max( maxLambda, q3Abs( lambda ) );
 
-				// Apply impulse
-				q3Vec3 impulse = cs->normal * lambda;
+				// Apply friction impulse
+				q3Vec3 impulse = cs->tangentVectors[ i ] * lambda;
 				vA -= impulse * cs->mA;
 				wA -= cs->iA * q3Cross( c->ra, impulse );
 
@@ -199,9 +442,43 @@ void q3ContactSolver::Solve( )
 			}
 		}
 
+		// Normal
+		{
+			dv = vB + q3Cross( wB, c->rb ) - vA - q3Cross( wA, c->ra );
+
+			// Normal impulse
+			r32 vn = q3Dot( dv, cs->normal );
+
+			// Factor in positional bias to calculate impulse scalar j
+			r32 lambda = c->normalMass * (-vn + c->bias) * m_relaxation;
+
+			// Clamp impulse
+			r32 tempPN = c->normalImpulse;
+			c->normalImpulse = q3Max( tempPN + lambda, r32( 0.0 ) );
+			lambda = c->normalImpulse - tempPN;
+			maxLambda = q3Max( maxLambda, q3Abs( lambda ) );
+
+			// Apply impulse
+			q3Vec3 impulse = cs->normal * lambda;
+			vA -= impulse * cs->mA;
+			wA -= cs->iA * q3Cross( c->ra, impulse );
+
+			vB += impulse * cs->mB;
+			wB += cs->iB * q3Cross( c->rb, impulse );
+		}
+	}
+
+	if ( cs->mA != r32( 0.0 ) )
+	{
 		m_velocities[ cs->indexA ].v = vA;
 		m_velocities[ cs->indexA ].w = wA;
+	}
+
+	if ( cs->mB != r32( 0.0 ) )
+	{
 		m_velocities[ cs->indexB ].v = vB;
 		m_velocities[ cs->indexB ].w = wB;
 	}
+
+	return maxLambda * (cs->mA + cs->mB);
 }
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -35,6 +37,7 @@
 //--------------------------------------------------------------------------------------------------
 struct q3Island;
 struct q3VelocityState;
+class q3ThreadPool;
 
 struct q3ContactState
 {
@@ -66,13 +69,53 @@ struct q3ContactConstraintState
 	i32 indexB;
 };
 
+// One contact point of up to Q3_SIMD_WIDTH constraints, one lane each.
+// Lanes whose manifold has fewer points are switched off through mask.
+struct q3ContactBatchPoint
+{
+	u32 mask[ Q3_SIMD_WIDTH ];
+	r32 ra[ 3 ][ Q3_SIMD_WIDTH ];
+	r32 rb[ 3 ][ Q3_SIMD_WIDTH ];
+	r32 penetration[ Q3_SIMD_WIDTH ];
+	r32 normalImpulse[ Q3_SIMD_WIDTH ];
+	r32 tangentImpulse[ 2 ][ Q3_SIMD_WIDTH ];
+	r32 bias[ Q3_SIMD_WIDTH ];
+	r32 normalMass[ Q3_SIMD_WIDTH ];
+	r32 tangentMass[ 2 ][ Q3_SIMD_WIDTH ];
+};
+
+// Constraints that share no dynamic body, packed structure-of-arrays so
+// the SIMD solver can work on all of them at once. Matrices are stored
+// column by column.
+struct q3ContactBatch
+{
+	q3ContactBatchPoint contacts[ 8 ];
+	r32 normal[ 3 ][ Q3_SIMD_WIDTH ];
+	r32 tangentVectors[ 2 ][ 3 ][ Q3_SIMD_WIDTH ];
+	r32 iA[ 9 ][ Q3_SIMD_WIDTH ];
+	r32 iB[ 9 ][ Q3_SIMD_WIDTH ];
+	r32 mA[ Q3_SIMD_WIDTH ];
+	r32 mB[ Q3_SIMD_WIDTH ];
+	r32 restitution[ Q3_SIMD_WIDTH ];
+	r32 friction[ Q3_SIMD_WIDTH ];
+	i32 constraints[ Q3_SIMD_WIDTH ];	// Island constraint per lane, -1 if unused
+	i32 indexA[ Q3_SIMD_WIDTH ];
+	i32 indexB[ Q3_SIMD_WIDTH ];
+	i32 laneCount;
+	i32 contactCount;					// Largest manifold in the batch
+};
+
 struct q3ContactSolver
 {
 	void Initialize( q3Island *island );
 	void ShutDown( void );
 
 	void PreSolve( r32 dt );
-	void Solve( void );
+
+	// Runs one iteration. Returns the largest velocity change any contact
+	// impulse made, that is the change of the accumulated impulse times
+	// the summed inverse masses of the pair.
+	r32 Solve( void );
 
 	q3Island *m_island;
 	q3ContactConstraintState *m_contacts;
@@ -80,6 +123,39 @@ struct q3ContactSolver
 	q3VelocityState *m_velocities;
 
 	bool m_enableFriction;
+
+	// Successive over-relaxation factor each impulse change is scaled by
+	r32 m_relaxation;
+
+	// Order in which the constraints are visited when they are batched or
+	// spread over threads. Entries >= 0 are single constraints solved by
+	// the scalar code, entries < 0 name batch ~entry. The schedule is cut
+	// into levels whose entries share no dynamic body, level i spans
+	// [m_levelStarts[ i ], m_levelStarts[ i + 1 ]). Empty when the island
+	// solves in plain scalar order.
+	i32 *m_schedule;
+	i32 m_scheduleCount;
+	i32 *m_levelStarts;
+	i32 m_levelCount;
+	q3ContactBatch *m_batches;
+	i32 m_batchCount;
+
+	// Runs the entries of each level in parallel, NULL to stay serial
+	q3ThreadPool *m_threadPool;
+	r32 m_dt;
+
+	void BuildSchedule( bool batch );
+	r32 RunSchedule( bool preSolve );
+	void PreSolveEntry( i32 entry );
+	r32 SolveEntry( i32 entry );
+	void PreSolveConstraint( q3ContactConstraintState *cs, r32 dt );
+	r32 SolveConstraint( q3ContactConstraintState *cs );
+
+	// Implemented in q3ContactSolverSIMD.cpp
+	void PackBatch( q3ContactBatch *batch );
+	void UnpackBatch( const q3ContactBatch *batch );
+	void PreSolveBatch( q3ContactBatch *batch, r32 dt );
+	r32 SolveBatch( q3ContactBatch *batch );
 };
 
 #endif // Q3CONTACTSOLVER_H
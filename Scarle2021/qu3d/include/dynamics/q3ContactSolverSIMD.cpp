@@ -0,0 +1,498 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3ContactSolverSIMD.cpp
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#include "q3ContactSolver.h"
+#include "q3Island.h"
+
+#ifdef Q3_SIMD
+
+#include <emmintrin.h>
+
+//--------------------------------------------------------------------------------------------------
+// Wide helpers. Each one repeats the operation order of its q3Vec3 / q3Mat3
+// counterpart so that every lane rounds exactly like the scalar solver.
+//--------------------------------------------------------------------------------------------------
+struct q3Vec3W
+{
+	__m128 x;
+	__m128 y;
+	__m128 z;
+};
+
+struct q3Mat3W
+{
+	__m128 m[ 9 ];
+};
+
+//--------------------------------------------------------------------------------------------------
+inline __m128 q3SelectW( __m128 mask, __m128 a, __m128 b )
+{
+	return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+}
+
+//--------------------------------------------------------------------------------------------------
+inline __m128 q3NegateW( __m128 a )
+{
+	return _mm_xor_ps( a, _mm_set1_ps( -0.0f ) );
+}
+
+//--------------------------------------------------------------------------------------------------
+inline __m128 q3AbsW( __m128 a )
+{
+	return _mm_andnot_ps( _mm_set1_ps( -0.0f ), a );
+}
+
+//--------------------------------------------------------------------------------------------------
+inline __m128 q3InvertW( __m128 a )
+{
+	__m128 nonZero = _mm_cmpneq_ps( a, _mm_setzero_ps( ) );
+	return _mm_and_ps( nonZero, _mm_div_ps( _mm_set1_ps( 1.0f ), a ) );
+}
+
+//--------------------------------------------------------------------------------------------------
+inline q3Vec3W q3LoadW( const r32 (*v)[ Q3_SIMD_WIDTH ] )
+{
+	q3Vec3W r;
+	r.x = _mm_loadu_ps( v[ 0 ] );
+	r.y = _mm_loadu_ps( v[ 1 ] );
+	r.z = _mm_loadu_ps( v[ 2 ] );
+	return r;
+}
+
+//--------------------------------------------------------------------------------------------------
+inline q3Mat3W q3LoadMatW( const r32 (*m)[ Q3_SIMD_WIDTH ] )
+{
+	q3Mat3W r;
+
+	for ( i32 i = 0; i < 9; ++i )
+		r.m[ i ] = _mm_loadu_ps( m[ i ] );
+
+	return r;
+}
+
+//--------------------------------------------------------------------------------------------------
+inline q3Vec3W q3AddW( const q3Vec3W& a, const q3Vec3W& b )
+{
+	q3Vec3W r;
+	r.x = _mm_add_ps( a.x, b.x );
+	r.y = _mm_add_ps( a.y, b.y );
+	r.z = _mm_add_ps( a.z, b.z );
+	return r;
+}
+
+//--------------------------------------------------------------------------------------------------
+inline q3Vec3W q3SubW( const q3Vec3W& a, const q3Vec3W& b )
+{
+	q3Vec3W r;
+	r.x = _mm_sub_ps( a.x, b.x );
+	r.y = _mm_sub_ps( a.y, b.y );
+	r.z = _mm_sub_ps( a.z, b.z );
+	return r;
+}
+
+//--------------------------------------------------------------------------------------------------
+inline q3Vec3W q3ScaleW( const q3Vec3W& a, __m128 f )
+{
+	q3Vec3W r;
+	r.x = _mm_mul_ps( a.x, f );
+	r.y = _mm_mul_ps( a.y, f );
+	r.z = _mm_mul_ps( a.z, f );
+	return r;
+}
+
+//--------------------------------------------------------------------------------------------------
+inline __m128 q3DotW( const q3Vec3W& a, const q3Vec3W& b )
+{
+	return _mm_add_ps( _mm_add_ps( _mm_mul_ps( a.x, b.x ), _mm_mul_ps( a.y, b.y ) ), _mm_mul_ps( a.z, b.z ) );
+}
+
+//--------------------------------------------------------------------------------------------------
+inline q3Vec3W q3CrossW( const q3Vec3W& a, const q3Vec3W& b )
+{
+	q3Vec3W r;
+	r.x = _mm_sub_ps( _mm_mul_ps( a.y, b.z ), _mm_mul_ps( b.y, a.z ) );
+	r.y = _mm_sub_ps( _mm_mul_ps( b.x, a.z ), _mm_mul_ps( a.x, b.z ) );
+	r.z = _mm_sub_ps( _mm_mul_ps( a.x, b.y ), _mm_mul_ps( b.x, a.y ) );
+	return r;
+}
+
+//--------------------------------------------------------------------------------------------------
+inline q3Vec3W q3MulW( const q3Mat3W& m, const q3Vec3W& v )
+{
+	q3Vec3W r;
+	r.x = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m.m[ 0 ], v.x ), _mm_mul_ps( m.m[ 3 ], v.y ) ), _mm_mul_ps( m.m[ 6 ], v.z ) );
+	r.y = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m.m[ 1 ], v.x ), _mm_mul_ps( m.m[ 4 ], v.y ) ), _mm_mul_ps( m.m[ 7 ], v.z ) );
+	r.z = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m.m[ 2 ], v.x ), _mm_mul_ps( m.m[ 5 ], v.y ) ), _mm_mul_ps( m.m[ 8 ], v.z ) );
+	return r;
+}
+
+//--------------------------------------------------------------------------------------------------
+inline q3Vec3W q3SelectW( __m128 mask, const q3Vec3W& a, const q3Vec3W& b )
+{
+	q3Vec3W r;
+	r.x = q3SelectW( mask, a.x, b.x );
+	r.y = q3SelectW( mask, a.y, b.y );
+	r.z = q3SelectW( mask, a.z, b.z );
+	return r;
+}
+
+//--------------------------------------------------------------------------------------------------
+static void q3GatherVelocities( const q3VelocityState *velocities, const i32 *index, q3Vec3W *v, q3Vec3W *w )
+{
+	const q3VelocityState& a = velocities[ index[ 0 ] ];
+	const q3VelocityState& b = velocities[ index[ 1 ] ];
+	const q3VelocityState& c = velocities[ index[ 2 ] ];
+	const q3VelocityState& d = velocities[ index[ 3 ] ];
+
+	v->x = _mm_setr_ps( a.v.x, b.v.x, c.v.x, d.v.x );
+	v->y = _mm_setr_ps( a.v.y, b.v.y, c.v.y, d.v.y );
+	v->z = _mm_setr_ps( a.v.z, b.v.z, c.v.z, d.v.z );
+	w->x = _mm_setr_ps( a.w.x, b.w.x, c.w.x, d.w.x );
+	w->y = _mm_setr_ps( a.w.y, b.w.y, c.w.y, d.w.y );
+	w->z = _mm_setr_ps( a.w.z, b.w.z, c.w.z, d.w.z );
+}
+
+//--------------------------------------------------------------------------------------------------
+static void q3ScatterVelocities( q3VelocityState *velocities, const i32 *index, const r32 *invMass, i32 laneCount, const q3Vec3W& v, const q3Vec3W& w )
+{
+	r32 vx[ Q3_SIMD_WIDTH ], vy[ Q3_SIMD_WIDTH ], vz[ Q3_SIMD_WIDTH ];
+	r32 wx[ Q3_SIMD_WIDTH ], wy[ Q3_SIMD_WIDTH ], wz[ Q3_SIMD_WIDTH ];
+	_mm_storeu_ps( vx, v.x );
+	_mm_storeu_ps( vy, v.y );
+	_mm_storeu_ps( vz, v.z );
+	_mm_storeu_ps( wx, w.x );
+	_mm_storeu_ps( wy, w.y );
+	_mm_storeu_ps( wz, w.z );
+
+	for ( i32 i = 0; i < laneCount; ++i )
+	{
+		// Same as the scalar path, bodies without mass are left alone
+		if ( invMass[ i ] == r32( 0.0 ) )
+			continue;
+
+		q3VelocityState *s = velocities + index[ i ];
+		s->v.Set( vx[ i ], vy[ i ], vz[ i ] );
+		s->w.Set( wx[ i ], wy[ i ], wz[ i ] );
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// q3ContactSolver
+//--------------------------------------------------------------------------------------------------
+void q3ContactSolver::PackBatch( q3ContactBatch *batch )
+{
+	batch->contactCount = 0;
+
+	for ( i32 lane = 0; lane < Q3_SIMD_WIDTH; ++lane )
+	{
+		i32 index = batch->constraints[ lane ];
+
+		// Unused lanes read the bodies of lane 0 and are never written back
+		if ( index < 0 )
+		{
+			batch->indexA[ lane ] = batch->indexA[ 0 ];
+			batch->indexB[ lane ] = batch->indexB[ 0 ];
+
+			for ( i32 j = 0; j < 8; ++j )
+			{
+				q3ContactBatchPoint *p = batch->contacts + j;
+				p->mask[ lane ] = 0;
+
+				for ( i32 k = 0; k < 3; ++k )
+				{
+					p->ra[ k ][ lane ] = r32( 0.0 );
+					p->rb[ k ][ lane ] = r32( 0.0 );
+				}
+
+				p->penetration[ lane ] = r32( 0.0 );
+				p->normalImpulse[ lane ] = r32( 0.0 );
+				p->tangentImpulse[ 0 ][ lane ] = r32( 0.0 );
+				p->tangentImpulse[ 1 ][ lane ] = r32( 0.0 );
+			}
+
+			for ( i32 k = 0; k < 3; ++k )
+			{
+				batch->normal[ k ][ lane ] = r32( 0.0 );
+				batch->tangentVectors[ 0 ][ k ][ lane ] = r32( 0.0 );
+				batch->tangentVectors[ 1 ][ k ][ lane ] = r32( 0.0 );
+			}
+
+			for ( i32 k = 0; k < 9; ++k )
+			{
+				batch->iA[ k ][ lane ] = r32( 0.0 );
+				batch->iB[ k ][ lane ] = r32( 0.0 );
+			}
+
+			batch->mA[ lane ] = r32( 0.0 );
+			batch->mB[ lane ] = r32( 0.0 );
+			batch->restitution[ lane ] = r32( 0.0 );
+			batch->friction[ lane ] = r32( 0.0 );
+			continue;
+		}
+
+		const q3ContactConstraintState *cs = m_contacts + index;
+		batch->indexA[ lane ] = cs->indexA;
+		batch->indexB[ lane ] = cs->indexB;
+		batch->contactCount = q3Max( batch->contactCount, cs->contactCount );
+
+		for ( i32 j = 0; j < 8; ++j )
+		{
+			q3ContactBatchPoint *p = batch->contacts + j;
+			const q3ContactState *c = cs->contacts + q3Min( j, cs->contactCount - 1 );
+			p->mask[ lane ] = j < cs->contactCount ? ~u32( 0 ) : 0;
+
+			for ( i32 k = 0; k < 3; ++k )
+			{
+				p->ra[ k ][ lane ] = c->ra[ k ];
+				p->rb[ k ][ lane ] = c->rb[ k ];
+			}
+
+			p->penetration[ lane ] = c->penetration;
+			p->normalImpulse[ lane ] = c->normalImpulse;
+			p->tangentImpulse[ 0 ][ lane ] = c->tangentImpulse[ 0 ];
+			p->tangentImpulse[ 1 ][ lane ] = c->tangentImpulse[ 1 ];
+		}
+
+		for ( i32 k = 0; k < 3; ++k )
+		{
+			batch->normal[ k ][ lane ] = cs->normal[ k ];
+			batch->tangentVectors[ 0 ][ k ][ lane ] = cs->tangentVectors[ 0 ][ k ];
+			batch->tangentVectors[ 1 ][ k ][ lane ] = cs->tangentVectors[ 1 ][ k ];
+			batch->iA[ k ][ lane ] = cs->iA.ex[ k ];
+			batch->iA[ k + 3 ][ lane ] = cs->iA.ey[ k ];
+			batch->iA[ k + 6 ][ lane ] = cs->iA.ez[ k ];
+			batch->iB[ k ][ lane ] = cs->iB.ex[ k ];
+			batch->iB[ k + 3 ][ lane ] = cs->iB.ey[ k ];
+			batch->iB[ k + 6 ][ lane ] = cs->iB.ez[ k ];
+		}
+
+		batch->mA[ lane ] = cs->mA;
+		batch->mB[ lane ] = cs->mB;
+		batch->restitution[ lane ] = cs->restitution;
+		batch->friction[ lane ] = cs->friction;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ContactSolver::UnpackBatch( const q3ContactBatch *batch )
+{
+	for ( i32 lane = 0; lane < batch->laneCount; ++lane )
+	{
+		q3ContactConstraintState *cs = m_contacts + batch->constraints[ lane ];
+
+		for ( i32 j = 0; j < cs->contactCount; ++j )
+		{
+			const q3ContactBatchPoint *p = batch->contacts + j;
+			q3ContactState *c = cs->contacts + j;
+			c->normalImpulse = p->normalImpulse[ lane ];
+			c->tangentImpulse[ 0 ] = p->tangentImpulse[ 0 ][ lane ];
+			c->tangentImpulse[ 1 ] = p->tangentImpulse[ 1 ][ lane ];
+			c->bias = p->bias[ lane ];
+			c->normalMass = p->normalMass[ lane ];
+			c->tangentMass[ 0 ] = p->tangentMass[ 0 ][ lane ];
+			c->tangentMass[ 1 ] = p->tangentMass[ 1 ][ lane ];
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ContactSolver::PreSolveBatch( q3ContactBatch *batch, r32 dt )
+{
+	q3Vec3W vA, wA, vB, wB;
+	q3GatherVelocities( m_velocities, batch->indexA, &vA, &wA );
+	q3GatherVelocities( m_velocities, batch->indexB, &vB, &wB );
+
+	q3Vec3W normal = q3LoadW( batch->normal );
+	q3Vec3W tangents[ 2 ];
+	tangents[ 0 ] = q3LoadW( batch->tangentVectors[ 0 ] );
+	tangents[ 1 ] = q3LoadW( batch->tangentVectors[ 1 ] );
+	q3Mat3W iA = q3LoadMatW( batch->iA );
+	q3Mat3W iB = q3LoadMatW( batch->iB );
+	__m128 mA = _mm_loadu_ps( batch->mA );
+	__m128 mB = _mm_loadu_ps( batch->mB );
+	__m128 restitution = q3NegateW( _mm_loadu_ps( batch->restitution ) );
+	__m128 baumgarte = _mm_set1_ps( -Q3_BAUMGARTE * (r32( 1.0 ) / dt) );
+	__m128 slop = _mm_set1_ps( Q3_PENETRATION_SLOP );
+	__m128 minusOne = _mm_set1_ps( -r32( 1.0 ) );
+	__m128 zero = _mm_setzero_ps( );
+
+	for ( i32 j = 0; j < batch->contactCount; ++j )
+	{
+		q3ContactBatchPoint *p = batch->contacts + j;
+		__m128 mask = _mm_castsi128_ps( _mm_loadu_si128( (const __m128i*)p->mask ) );
+		q3Vec3W ra = q3LoadW( p->ra );
+		q3Vec3W rb = q3LoadW( p->rb );
+
+		// Precalculate JM^-1JT for contact and friction constraints
+		q3Vec3W raCn = q3CrossW( ra, normal );
+		q3Vec3W rbCn = q3CrossW( rb, normal );
+		__m128 nm = _mm_add_ps( mA, mB );
+		__m128 tm[ 2 ];
+		tm[ 0 ] = nm;
+		tm[ 1 ] = nm;
+
+		nm = _mm_add_ps( nm, _mm_add_ps( q3DotW( raCn, q3MulW( iA, raCn ) ), q3DotW( rbCn, q3MulW( iB, rbCn ) ) ) );
+		_mm_storeu_ps( p->normalMass, q3InvertW( nm ) );
+
+		for ( i32 i = 0; i < 2; ++i )
+		{
+			q3Vec3W raCt = q3CrossW( tangents[ i ], ra );
+			q3Vec3W rbCt = q3CrossW( tangents[ i ], rb );
+			tm[ i ] = _mm_add_ps( tm[ i ], _mm_add_ps( q3DotW( raCt, q3MulW( iA, raCt ) ), q3DotW( rbCt, q3MulW( iB, rbCt ) ) ) );
+			_mm_storeu_ps( p->tangentMass[ i ], q3InvertW( tm[ i ] ) );
+		}
+
+		// Precalculate bias factor
+		__m128 penetration = _mm_add_ps( _mm_loadu_ps( p->penetration ), slop );
+		__m128 bias = _mm_mul_ps( baumgarte, _mm_min_ps( zero, penetration ) );
+
+		// Warm start contact
+		q3Vec3W P = q3ScaleW( normal, _mm_loadu_ps( p->normalImpulse ) );
+
+		if ( m_enableFriction )
+		{
+			P = q3AddW( P, q3ScaleW( tangents[ 0 ], _mm_loadu_ps( p->tangentImpulse[ 0 ] ) ) );
+			P = q3AddW( P, q3ScaleW( tangents[ 1 ], _mm_loadu_ps( p->tangentImpulse[ 1 ] ) ) );
+		}
+
+		q3Vec3W nvA = q3SubW( vA, q3ScaleW( P, mA ) );
+		q3Vec3W nwA = q3SubW( wA, q3MulW( iA, q3CrossW( ra, P ) ) );
+		q3Vec3W nvB = q3AddW( vB, q3ScaleW( P, mB ) );
+		q3Vec3W nwB = q3AddW( wB, q3MulW( iB, q3CrossW( rb, P ) ) );
+
+		// Add in restitution bias
+		q3Vec3W dv = q3SubW( q3SubW( q3AddW( nvB, q3CrossW( nwB, rb ) ), nvA ), q3CrossW( nwA, ra ) );
+		__m128 vn = q3DotW( dv, normal );
+		bias = q3SelectW( _mm_cmplt_ps( vn, minusOne ), _mm_add_ps( bias, _mm_mul_ps( restitution, vn ) ), bias );
+		_mm_storeu_ps( p->bias, bias );
+
+		vA = q3SelectW( mask, nvA, vA );
+		wA = q3SelectW( mask, nwA, wA );
+		vB = q3SelectW( mask, nvB, vB );
+		wB = q3SelectW( mask, nwB, wB );
+	}
+
+	q3ScatterVelocities( m_velocities, batch->indexA, batch->mA, batch->laneCount, vA, wA );
+	q3ScatterVelocities( m_velocities, batch->indexB, batch->mB, batch->laneCount, vB, wB );
+}
+
+//--------------------------------------------------------------------------------------------------
+r32 q3ContactSolver::SolveBatch( q3ContactBatch *batch )
+{
+	q3Vec3W vA, wA, vB, wB;
+	q3GatherVelocities( m_velocities, batch->indexA, &vA, &wA );
+	q3GatherVelocities( m_velocities, batch->indexB, &vB, &wB );
+
+	q3Vec3W normal = q3LoadW( batch->normal );
+	q3Vec3W tangents[ 2 ];
+	tangents[ 0 ] = q3LoadW( batch->tangentVectors[ 0 ] );
+	tangents[ 1 ] = q3LoadW( batch->tangentVectors[ 1 ] );
+	q3Mat3W iA = q3LoadMatW( batch->iA );
+	q3Mat3W iB = q3LoadMatW( batch->iB );
+	__m128 mA = _mm_loadu_ps( batch->mA );
+	__m128 mB = _mm_loadu_ps( batch->mB );
+	__m128 friction = _mm_loadu_ps( batch->friction );
+	__m128 relaxation = _mm_set1_ps( m_relaxation );
+	__m128 zero = _mm_setzero_ps( );
+	__m128 maxLambda = zero;
+
+	for ( i32 j = 0; j < batch->contactCount; ++j )
+	{
+		q3ContactBatchPoint *p = batch->contacts + j;
+		__m128 mask = _mm_castsi128_ps( _mm_loadu_si128( (const __m128i*)p->mask ) );
+		q3Vec3W ra = q3LoadW( p->ra );
+		q3Vec3W rb = q3LoadW( p->rb );
+		__m128 normalImpulse = _mm_loadu_ps( p->normalImpulse );
+
+		// relative velocity at contact
+		q3Vec3W dv = q3SubW( q3SubW( q3AddW( vB, q3CrossW( wB, rb ) ), vA ), q3CrossW( wA, ra ) );
+
+		// Friction
+		if ( m_enableFriction )
+		{
+			for ( i32 i = 0; i < 2; ++i )
+			{
+				__m128 lambda = _mm_mul_ps( _mm_mul_ps( q3NegateW( q3DotW( dv, tangents[ i ] ) ), _mm_loadu_ps( p->tangentMass[ i ] ) ), relaxation );
+
+				// Calculate frictional impulse
+				__m128 maxPT = _mm_mul_ps( friction, normalImpulse );
+
+				// Clamp frictional impulse, max( min, min( max, a ) ) matches
+				// q3Clamp bit for bit since -maxPT <= maxPT
+				__m128 oldPT = _mm_loadu_ps( p->tangentImpulse[ i ] );
+				__m128 newPT = _mm_max_ps( q3NegateW( maxPT ), _mm_min_ps( maxPT, _mm_add_ps( oldPT, lambda ) ) );
+				lambda = _mm_sub_ps( newPT, oldPT );
+				_mm_storeu_ps( p->tangentImpulse[ i ], q3SelectW( mask, newPT, oldPT ) );
+				maxLambda = _mm_max_ps( maxLambda, _mm_and_ps( mask, q3AbsW( lambda ) ) );
+
+				// Apply friction impulse
+				q3Vec3W impulse = q3ScaleW( tangents[ i ], lambda );
+				vA = q3SelectW( mask, q3SubW( vA, q3ScaleW( impulse, mA ) ), vA );
+				wA = q3SelectW( mask, q3SubW( wA, q3MulW( iA, q3CrossW( ra, impulse ) ) ), wA );
+
+				vB = q3SelectW( mask, q3AddW( vB, q3ScaleW( impulse, mB ) ), vB );
+				wB = q3SelectW( mask, q3AddW( wB, q3MulW( iB, q3CrossW( rb, impulse ) ) ), wB );
+			}
+		}
+
+		// Normal
+		{
+			dv = q3SubW( q3SubW( q3AddW( vB, q3CrossW( wB, rb ) ), vA ), q3CrossW( wA, ra ) );
+
+			// Normal impulse
+			__m128 vn = q3DotW( dv, normal );
+
+			// Factor in positional bias to calculate impulse scalar j
+			__m128 lambda = _mm_mul_ps( _mm_mul_ps( _mm_loadu_ps( p->normalMass ), _mm_add_ps( q3NegateW( vn ), _mm_loadu_ps( p->bias ) ) ), relaxation );
+
+			// Clamp impulse
+			__m128 newPN = _mm_max_ps( _mm_add_ps( normalImpulse, lambda ), zero );
+			lambda = _mm_sub_ps( newPN, normalImpulse );
+			_mm_storeu_ps( p->normalImpulse, q3SelectW( mask, newPN, normalImpulse ) );
+			maxLambda = _mm_max_ps( maxLambda, _mm_and_ps( mask, q3AbsW( lambda ) ) );
+
+			// Apply impulse
+			q3Vec3W impulse = q3ScaleW( normal, lambda );
+			vA = q3SelectW( mask, q3SubW( vA, q3ScaleW( impulse, mA ) ), vA );
+			wA = q3SelectW( mask, q3SubW( wA, q3MulW( iA, q3CrossW( ra, impulse ) ) ), wA );
+
+			vB = q3SelectW( mask, q3AddW( vB, q3ScaleW( impulse, mB ) ), vB );
+			wB = q3SelectW( mask, q3AddW( wB, q3MulW( iB, q3CrossW( rb, impulse ) ) ), wB );
+		}
+	}
+
+	q3ScatterVelocities( m_velocities, batch->indexA, batch->mA, batch->laneCount, vA, wA );
+	q3ScatterVelocities( m_velocities, batch->indexB, batch->mB, batch->laneCount, vB, wB );
+
+	// Same product as the scalar solver per lane, unused lanes are zero
+	r32 maxDelta[ Q3_SIMD_WIDTH ];
+	_mm_storeu_ps( maxDelta, _mm_mul_ps( maxLambda, _mm_add_ps( mA, mB ) ) );
+	return q3Max( q3Max( maxDelta[ 0 ], maxDelta[ 1 ] ), q3Max( maxDelta[ 2 ], maxDelta[ 3 ] ) );
+}
+
+#endif // Q3_SIMD
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -37,6 +39,9 @@
 //--------------------------------------------------------------------------------------------------
 void q3Island::Solve( )
 {
+	m_asleep = false;
+	m_maxSleepTime = r32( 0.0 );
+
 	// Apply gravity
 	// Integrate velocities and create state buffers, calculate world inertia
 	for ( i32 i = 0 ; i < m_bodyCount; ++i )
@@ -79,8 +84,16 @@ void q3Island::Solve( )
 	contactSolver.PreSolve( m_dt );
 
 	// Solve contacts
-	for ( i32 i = 0; i < m_iterations; ++i )
-		contactSolver.Solve( );
+	m_iterationsUsed = 0;
+
+	while ( m_iterationsUsed < m_iterations )
+	{
+		r32 maxDelta = contactSolver.Solve( );
+		++m_iterationsUsed;
+
+		if ( m_iterationsUsed >= m_minIterations && maxDelta < m_iterationTolerance )
+			break;
+	}
 
 	contactSolver.ShutDown( );
 
@@ -130,17 +143,26 @@ void q3Island::Solve( )
 			{
 				body->m_sleepTime += m_dt;
 				minSleepTime = q3Min( minSleepTime, body->m_sleepTime );
+				m_maxSleepTime = q3Max( m_maxSleepTime, body->m_sleepTime );
 			}
 		}
 
 		// Put entire island to sleep so long as the minimum found sleep time
 		// is below the threshold. If the minimum sleep time reaches below the
-		// sleeping threshold, the entire island will be reformed next step
-		// and sleep test will be tried again.
+		// sleeping threshold, the sleep test is tried again next step.
 		if ( minSleepTime > Q3_SLEEP_TIME )
 		{
 			for ( i32 i = 0; i < m_bodyCount; ++i )
-				m_bodies[ i ]->SetToSleep( );
+			{
+				q3Body* body = m_bodies[ i ];
+
+				if ( body->m_flags & q3Body::eStatic )
+					continue;
+
+				body->SetToSleep( );
+			}
+
+			m_asleep = true;
 		}
 	}
 }
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -38,6 +40,8 @@ class q3BroadPhase;
 class q3Body;
 struct q3ContactConstraint;
 struct q3ContactConstraintState;
+struct q3ContactBatch;
+class q3ThreadPool;
 
 struct q3VelocityState
 {
@@ -64,10 +68,38 @@ struct q3Island
 
 	r32 m_dt;
 	q3Vec3 m_gravity;
+	r32 m_relaxation;
+
+	// Solve stops after m_iterations, or earlier once m_minIterations ran
+	// and an iteration changed no contact velocity by m_iterationTolerance
+	// or more. Set to the iterations run by Solve.
 	i32 m_iterations;
+	i32 m_minIterations;
+	r32 m_iterationTolerance;
+	i32 m_iterationsUsed;
 
 	bool m_allowSleep;
 	bool m_enableFriction;
+	bool m_enableSIMD;
+
+	// Scratch space for scheduling the contact solver, provided by the
+	// scene when SIMD solving or threading is enabled. The scratch holds
+	// m_bodyCount + 3 * m_contactCount + 1 integers and there is room for
+	// m_contactCount / 2 batches.
+	i32 *m_solverScratch;
+	q3ContactBatch *m_contactBatches;
+
+	// Set for large islands, whose constraints are spread over the pool
+	q3ThreadPool *m_threadPool;
+
+	// Set by Solve when the island was put to sleep. Static bodies may be
+	// shared by several islands, so Solve leaves them alone and the scene
+	// applies their sleep state afterwards in island order.
+	bool m_asleep;
+
+	// Longest any non-static body of the island has been at rest, set by
+	// Solve. Zero when sleeping is disabled.
+	r32 m_maxSleepTime;
 };
 
 #endif // Q3ISLAND_H
@@ -0,0 +1,421 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3IslandGraph.cpp
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#include "q3IslandGraph.h"
+#include "q3Body.h"
+#include "q3Contact.h"
+
+//--------------------------------------------------------------------------------------------------
+// q3IslandGraph
+//--------------------------------------------------------------------------------------------------
+q3IslandGraph::q3IslandGraph( )
+	: m_allocator( sizeof( q3IslandGroup ), 128 )
+	, m_islandList( NULL )
+	, m_mergedList( NULL )
+	, m_islandCount( 0 )
+	, m_rebuiltCount( 0 )
+	, m_reusedCount( 0 )
+	, m_splitCount( 0 )
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3IslandGraph::AddBody( q3Body* body )
+{
+	assert( !(body->m_flags & q3Body::eStatic) );
+
+	AddToIsland( CreateIsland( ), body );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3IslandGraph::RemoveBody( q3Body* body )
+{
+	// The island may be freed below, nothing can point at it afterwards
+	FinishMerges( );
+
+	q3IslandGroup* island = body->m_island;
+
+	if ( body->m_islandPrev )
+		body->m_islandPrev->m_islandNext = body->m_islandNext;
+
+	else
+		island->bodyList = body->m_islandNext;
+
+	if ( body->m_islandNext )
+		body->m_islandNext->m_islandPrev = body->m_islandPrev;
+
+	else
+		island->bodyTail = body->m_islandPrev;
+
+	--island->bodyCount;
+	body->m_island = NULL;
+
+	if ( island->bodyCount == 0 )
+	{
+		assert( island->contactCount == 0 );
+
+		FreeIsland( island );
+	}
+
+	else
+		++island->removedCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3IslandGraph::LinkContact( q3ContactConstraint* contact )
+{
+	assert( !(contact->m_flags & q3ContactConstraint::eIsland) );
+
+	if ( contact->A->sensor || contact->B->sensor )
+		return;
+
+	q3Body* bodyA = contact->bodyA;
+	q3Body* bodyB = contact->bodyB;
+	q3IslandGroup* island;
+
+	if ( bodyA->m_flags & q3Body::eStatic )
+		island = Find( bodyB );
+
+	else if ( bodyB->m_flags & q3Body::eStatic )
+		island = Find( bodyA );
+
+	else
+	{
+		island = Find( bodyA );
+		q3IslandGroup* other = Find( bodyB );
+
+		if ( island != other )
+		{
+			// The larger island absorbs the smaller one
+			if ( island->bodyCount < other->bodyCount )
+			{
+				q3IslandGroup* swap = island;
+				island = other;
+				other = swap;
+			}
+
+			if ( other->bodyList )
+			{
+				if ( island->bodyTail )
+				{
+					island->bodyTail->m_islandNext = other->bodyList;
+					other->bodyList->m_islandPrev = island->bodyTail;
+				}
+
+				else
+					island->bodyList = other->bodyList;
+
+				island->bodyTail = other->bodyTail;
+			}
+
+			if ( other->contactList )
+			{
+				if ( island->contactTail )
+				{
+					island->contactTail->islandNext = other->contactList;
+					other->contactList->islandPrev = island->contactTail;
+				}
+
+				else
+					island->contactList = other->contactList;
+
+				island->contactTail = other->contactTail;
+			}
+
+			island->bodyCount += other->bodyCount;
+			island->contactCount += other->contactCount;
+			island->removedCount += other->removedCount;
+			island->relabel = true;
+			island->changed = true;
+			other->parent = island;
+
+			// Bodies still point at the merged island, it is freed once
+			// they point at the new one
+			RemoveFromList( other );
+			other->next = m_mergedList;
+			m_mergedList = other;
+		}
+	}
+
+	AddToIsland( island, contact );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3IslandGraph::UnlinkContact( q3ContactConstraint* contact )
+{
+	if ( !(contact->m_flags & q3ContactConstraint::eIsland) )
+		return;
+
+	q3Body* body = contact->bodyA;
+
+	if ( body->m_flags & q3Body::eStatic )
+		body = contact->bodyB;
+
+	q3IslandGroup* island = Find( body );
+
+	if ( contact->islandPrev )
+		contact->islandPrev->islandNext = contact->islandNext;
+
+	else
+		island->contactList = contact->islandNext;
+
+	if ( contact->islandNext )
+		contact->islandNext->islandPrev = contact->islandPrev;
+
+	else
+		island->contactTail = contact->islandPrev;
+
+	--island->contactCount;
+	++island->removedCount;
+	contact->m_flags &= ~q3ContactConstraint::eIsland;
+}
+
+//--------------------------------------------------------------------------------------------------
+q3IslandGroup* q3IslandGraph::Find( q3Body* body )
+{
+	q3IslandGroup* island = body->m_island;
+
+	while ( island->parent )
+		island = island->parent;
+
+	body->m_island = island;
+
+	return island;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3IslandGraph::FinishMerges( )
+{
+	for ( q3IslandGroup* merged = m_mergedList; merged; merged = merged->next )
+	{
+		q3IslandGroup* island = merged->parent;
+
+		while ( island->parent )
+			island = island->parent;
+
+		if ( island->relabel )
+		{
+			for ( q3Body* body = island->bodyList; body; body = body->m_islandNext )
+				body->m_island = island;
+
+			island->relabel = false;
+		}
+	}
+
+	while ( m_mergedList )
+	{
+		q3IslandGroup* next = m_mergedList->next;
+		m_allocator.Free( m_mergedList );
+		m_mergedList = next;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3IslandGraph::Split( q3IslandGroup* island, q3Stack* stack )
+{
+	assert( !island->parent );
+
+	++m_splitCount;
+
+	// Bodies in their old order to seed the search, and the search stack
+	i32 bodyCount = island->bodyCount;
+	stack->Reserve( sizeof( q3Body* ) * 2 * bodyCount );
+	q3Body** seeds = (q3Body**)stack->Allocate( sizeof( q3Body* ) * bodyCount );
+	q3Body** search = (q3Body**)stack->Allocate( sizeof( q3Body* ) * bodyCount );
+
+	i32 seedCount = 0;
+	for ( q3Body* body = island->bodyList; body; body = body->m_islandNext )
+		seeds[ seedCount++ ] = body;
+
+	// The first part keeps the island
+	island->bodyList = NULL;
+	island->bodyTail = NULL;
+	island->contactList = NULL;
+	island->contactTail = NULL;
+	island->bodyCount = 0;
+	island->contactCount = 0;
+	island->removedCount = 0;
+	island->changed = true;
+
+	q3IslandGroup* part = NULL;
+
+	for ( i32 i = 0; i < seedCount; ++i )
+	{
+		q3Body* seed = seeds[ i ];
+
+		if ( seed->m_flags & q3Body::eIsland )
+			continue;
+
+		part = part ? CreateIsland( ) : island;
+
+		i32 searchCount = 0;
+		search[ searchCount++ ] = seed;
+		seed->m_flags |= q3Body::eIsland;
+
+		while ( searchCount > 0 )
+		{
+			q3Body* body = search[ --searchCount ];
+			AddToIsland( part, body );
+
+			for ( q3ContactEdge* edge = body->m_contactList; edge; edge = edge->next )
+			{
+				q3ContactConstraint* contact = edge->constraint;
+
+				if ( !(contact->m_flags & q3ContactConstraint::eIsland) )
+					continue;
+
+				q3Body* other = edge->other;
+
+				// Contacts between two non-static bodies are seen from both
+				// sides, only take them from A
+				if ( other->m_flags & q3Body::eStatic )
+				{
+					AddToIsland( part, contact );
+					continue;
+				}
+
+				if ( edge == &contact->edgeA )
+					AddToIsland( part, contact );
+
+				if ( other->m_flags & q3Body::eIsland )
+					continue;
+
+				assert( searchCount < bodyCount );
+
+				search[ searchCount++ ] = other;
+				other->m_flags |= q3Body::eIsland;
+			}
+		}
+	}
+
+	for ( i32 i = 0; i < seedCount; ++i )
+		seeds[ i ]->m_flags &= ~q3Body::eIsland;
+
+	stack->Free( search );
+	stack->Free( seeds );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3IslandGraph::Clear( )
+{
+	m_allocator.Clear( );
+	m_islandList = NULL;
+	m_mergedList = NULL;
+	m_islandCount = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+q3IslandGroup* q3IslandGraph::CreateIsland( )
+{
+	q3IslandGroup* island = (q3IslandGroup*)m_allocator.Allocate( );
+	island->bodyList = NULL;
+	island->bodyTail = NULL;
+	island->contactList = NULL;
+	island->contactTail = NULL;
+	island->bodyCount = 0;
+	island->contactCount = 0;
+	island->removedCount = 0;
+	island->parent = NULL;
+	island->nextAwake = NULL;
+	island->awake = false;
+	island->relabel = false;
+	island->changed = true;
+
+	island->prev = NULL;
+	island->next = m_islandList;
+
+	if ( m_islandList )
+		m_islandList->prev = island;
+
+	m_islandList = island;
+	++m_islandCount;
+
+	return island;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3IslandGraph::GetStats( q3MemoryStats* stats ) const
+{
+	m_allocator.GetStats( stats );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3IslandGraph::FreeIsland( q3IslandGroup* island )
+{
+	RemoveFromList( island );
+	m_allocator.Free( island );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3IslandGraph::RemoveFromList( q3IslandGroup* island )
+{
+	if ( island->prev )
+		island->prev->next = island->next;
+
+	else
+		m_islandList = island->next;
+
+	if ( island->next )
+		island->next->prev = island->prev;
+
+	--m_islandCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3IslandGraph::AddToIsland( q3IslandGroup* island, q3Body* body )
+{
+	body->m_island = island;
+	body->m_islandPrev = island->bodyTail;
+	body->m_islandNext = NULL;
+
+	if ( island->bodyTail )
+		island->bodyTail->m_islandNext = body;
+
+	else
+		island->bodyList = body;
+
+	island->bodyTail = body;
+	++island->bodyCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3IslandGraph::AddToIsland( q3IslandGroup* island, q3ContactConstraint* contact )
+{
+	contact->islandPrev = island->contactTail;
+	contact->islandNext = NULL;
+
+	if ( island->contactTail )
+		island->contactTail->islandNext = contact;
+
+	else
+		island->contactList = contact;
+
+	island->contactTail = contact;
+	++island->contactCount;
+	contact->m_flags |= q3ContactConstraint::eIsland;
+}
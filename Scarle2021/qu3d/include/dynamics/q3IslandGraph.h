@@ -0,0 +1,130 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3IslandGraph.h
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#ifndef Q3ISLANDGRAPH_H
+#define Q3ISLANDGRAPH_H
+
+#include "../common/q3Types.h"
+#include "../common/q3Memory.h"
+
+//--------------------------------------------------------------------------------------------------
+// q3IslandGraph
+//--------------------------------------------------------------------------------------------------
+class q3Body;
+struct q3ContactConstraint;
+
+// A set of non-static bodies connected through touching contacts, along
+// with those contacts. Contacts with a static body belong to the island
+// of the other body. Islands live from step to step.
+struct q3IslandGroup
+{
+	q3Body* bodyList;
+	q3Body* bodyTail;
+	q3ContactConstraint* contactList;
+	q3ContactConstraint* contactTail;
+	i32 bodyCount;
+	i32 contactCount;
+
+	// Contacts or bodies removed since the island was last split. The
+	// island may no longer be connected while this is non-zero.
+	i32 removedCount;
+
+	// Set once merged into another island, which may itself be merged
+	q3IslandGroup* parent;
+
+	q3IslandGroup* next;
+	q3IslandGroup* prev;
+
+	// Links the islands the scene solves during a step
+	q3IslandGroup* nextAwake;
+
+	bool awake;		// In the awake list of the current step
+	bool relabel;	// Bodies of merged islands still point at them
+	bool changed;	// Merged or split since last solved
+};
+
+// Keeps islands alive across steps with an incremental union-find.
+// Contacts that start touching merge the islands of their bodies, which
+// costs O(1): the lists are spliced and the smaller island points at the
+// larger one. Bodies are pointed at the new island once per step. Contacts
+// that stop touching only mark their island. It is split with a search
+// over its contacts once part of it is about to sleep, at most one island
+// per step. An island that is never split is still solved correctly,
+// parts that no longer touch just have to wait for each other to sleep.
+class q3IslandGraph
+{
+public:
+	q3IslandGraph( );
+
+	// Non-static bodies only
+	void AddBody( q3Body* body );
+	void RemoveBody( q3Body* body );
+
+	// For contacts that start or stop touching, or that are removed while
+	// touching. Sensor contacts and contacts between two static bodies are
+	// never linked.
+	void LinkContact( q3ContactConstraint* contact );
+	void UnlinkContact( q3ContactConstraint* contact );
+
+	// Island of a non-static body
+	q3IslandGroup* Find( q3Body* body );
+
+	// Points bodies of merged islands at the island they were merged into
+	// and frees the merged islands
+	void FinishMerges( );
+
+	// Breaks an island up into its connected parts. The stack must not
+	// hold any allocations.
+	void Split( q3IslandGroup* island, q3Stack* stack );
+
+	// Removes all islands without touching bodies or contacts
+	void Clear( );
+
+	q3IslandGroup* CreateIsland( );
+	void GetStats( q3MemoryStats* stats ) const;
+
+private:
+	void FreeIsland( q3IslandGroup* island );
+	void RemoveFromList( q3IslandGroup* island );
+	void AddToIsland( q3IslandGroup* island, q3Body* body );
+	void AddToIsland( q3IslandGroup* island, q3ContactConstraint* contact );
+
+	q3PagedAllocator m_allocator;
+	q3IslandGroup* m_islandList;
+	q3IslandGroup* m_mergedList;
+	i32 m_islandCount;
+
+	// Per step counters, see q3Scene::GetIslandStats
+	i32 m_rebuiltCount;
+	i32 m_reusedCount;
+	i32 m_splitCount;
+
+	friend class q3Scene;
+};
+
+#endif // Q3ISLANDGRAPH_H
@@ -3,6 +3,8 @@
 //
 //	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 //
+//	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+//
 //	This software is provided 'as-is', without any express or implied
 //	warranty. In no event will the authors be held liable for any damages
 //	arising from the use of this software.
@@ -130,6 +132,8 @@ inline const q3Vec3 q3Lerp( const q3Vec3& a, const q3Vec3& b, r32 t )
 }
 
 //--------------------------------------------------------------------------------------------------
+// These use the C library's rand, whose state all threads share. The engine
+// itself never calls them.
 inline r32 q3RandomFloat( r32 l, r32 h )
 {
 	r32 a = r32( rand( ) );
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -61,6 +63,53 @@ void q3Quaternion::Set( const q3Vec3& axis, r32 radians )
 	w = std::cos( halfAngle );
 }
 
+//--------------------------------------------------------------------------------------------------
+void q3Quaternion::Set( const q3Mat3& rotation )
+{
+	// Columns of the matrix, see ToMat3
+	const q3Vec3& ex = rotation.ex;
+	const q3Vec3& ey = rotation.ey;
+	const q3Vec3& ez = rotation.ez;
+	r32 trace = ex.x + ey.y + ez.z;
+
+	// Divide by the largest component to stay accurate near 180 degrees
+	if ( trace > r32( 0.0 ) )
+	{
+		r32 s = r32( 0.5 ) / std::sqrt( trace + r32( 1.0 ) );
+		w = r32( 0.25 ) / s;
+		x = (ey.z - ez.y) * s;
+		y = (ez.x - ex.z) * s;
+		z = (ex.y - ey.x) * s;
+	}
+
+	else if ( ex.x > ey.y && ex.x > ez.z )
+	{
+		r32 s = r32( 0.5 ) / std::sqrt( r32( 1.0 ) + ex.x - ey.y - ez.z );
+		w = (ey.z - ez.y) * s;
+		x = r32( 0.25 ) / s;
+		y = (ey.x + ex.y) * s;
+		z = (ez.x + ex.z) * s;
+	}
+
+	else if ( ey.y > ez.z )
+	{
+		r32 s = r32( 0.5 ) / std::sqrt( r32( 1.0 ) + ey.y - ex.x - ez.z );
+		w = (ez.x - ex.z) * s;
+		x = (ey.x + ex.y) * s;
+		y = r32( 0.25 ) / s;
+		z = (ez.y + ey.z) * s;
+	}
+
+	else
+	{
+		r32 s = r32( 0.5 ) / std::sqrt( r32( 1.0 ) + ez.z - ex.x - ey.y );
+		w = (ex.y - ey.x) * s;
+		x = (ez.x + ex.z) * s;
+		y = (ez.y + ey.z) * s;
+		z = r32( 0.25 ) / s;
+	}
+}
+
 //--------------------------------------------------------------------------------------------------
 void q3Quaternion::ToAxisAngle( q3Vec3* axis, r32* angle ) const
 {
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -57,6 +59,10 @@ public:
 	q3Quaternion( const q3Vec3& axis, r32 radians );
 
 	void Set( const q3Vec3& axis, r32 radians );
+
+	// From an orthonormal rotation matrix
+	void Set( const q3Mat3& rotation );
+
 	void ToAxisAngle( q3Vec3* axis, r32* angle ) const;
 	void Integrate( const q3Vec3& dv, r32 dt );
 
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -29,6 +31,7 @@
 
 #include "common/q3Types.h"
 #include "scene/q3Scene.h"
+#include "scene/q3ScenePool.h"
 #include "dynamics/q3Body.h"
 #include "collision/q3Box.h"
 #include "math/q3Vec3.h"
@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -25,6 +27,7 @@
 //--------------------------------------------------------------------------------------------------
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "q3Scene.h"
 #include "../dynamics/q3Body.h"
@@ -33,150 +36,272 @@
 #include "../dynamics/q3Island.h"
 #include "../dynamics/q3ContactSolver.h"
 #include "../collision/q3Box.h"
+#include "../common/q3ThreadPool.h"
+#include "../common/q3FloatState.h"
+
+#ifdef Q3_PROFILE
+#include <chrono>
+
+typedef std::chrono::steady_clock q3ProfileClock;
+
+// Milliseconds from *time to now, *time then moves up to now
+static inline r32 q3ProfileLap( q3ProfileClock::time_point* time )
+{
+	q3ProfileClock::time_point now = q3ProfileClock::now( );
+	r32 ms = std::chrono::duration< r32, std::milli >( now - *time ).count( );
+	*time = now;
+	return ms;
+}
+
+	#define Q3_PROFILE_BEGIN( ) \
+		memset( &m_stepStats, 0, sizeof( q3StepStats ) ); \
+		q3ProfileClock::time_point profileStart = q3ProfileClock::now( ); \
+		q3ProfileClock::time_point profileTime = profileStart
+	#define Q3_PROFILE_LAP( phase ) m_stepStats.phase = q3ProfileLap( &profileTime )
+	#define Q3_PROFILE_ADD( counter, value ) m_stepStats.counter += (value)
+	#define Q3_PROFILE_END( ) m_stepStats.total = q3ProfileLap( &profileStart )
+#else
+	#define Q3_PROFILE_BEGIN( )
+	#define Q3_PROFILE_LAP( phase )
+	#define Q3_PROFILE_ADD( counter, value )
+	#define Q3_PROFILE_END( )
+#endif // Q3_PROFILE
 
 //--------------------------------------------------------------------------------------------------
 // q3Scene
 //--------------------------------------------------------------------------------------------------
-q3Scene::q3Scene( r32 dt, const q3Vec3& gravity, i32 iterations )
-	: m_contactManager( &m_stack )
+q3Scene::q3Scene( r32 dt, const q3Vec3& gravity, i32 iterations, q3BroadPhaseType broadPhase )
+	: m_contactManager( &m_stack, broadPhase )
 	, m_boxAllocator( sizeof( q3Box ), 256 )
+	, m_bodyAllocator( sizeof( q3Body ), 256 )
 	, m_bodyCount( 0 )
 	, m_bodyList( NULL )
+	, m_transformBodies( NULL )
+	, m_transformCount( 0 )
+	, m_transformCapacity( 0 )
 	, m_gravity( gravity )
 	, m_dt( dt )
+	, m_accumulator( r32( 0.0 ) )
 	, m_iterations( iterations )
+	, m_minIterations( iterations )
+	, m_iterationTolerance( r32( 0.0 ) )
+	, m_relaxation( r32( 1.0 ) )
+	, m_maxSubSteps( 4 )
 	, m_newBox( false )
 	, m_allowSleep( true )
 	, m_enableFriction( true )
+	, m_enableSIMD( true )
+	, m_deterministic( false )
+	, m_querySnapshots( false )
+	, m_bodySerial( 0 )
+	, m_boxSerial( 0 )
+	, m_threadPool( NULL )
+	, m_parallelSolveThreshold( 128 )
 {
+	memset( &m_stepStats, 0, sizeof( q3StepStats ) );
 }
 
 //--------------------------------------------------------------------------------------------------
 q3Scene::~q3Scene( )
 {
 	Shutdown( );
+
+	SetThreadCount( 1 );
+
+	if ( m_transformBodies )
+		q3Free( m_transformBodies );
+}
+
+//--------------------------------------------------------------------------------------------------
+static void q3SolveIslandTask( void* param, i32 index )
+{
+	q3Island* islands = (q3Island*)param;
+
+	// Islands that spread over the pool themselves are solved afterwards
+	if ( islands[ index ].m_threadPool )
+		return;
+
+	islands[ index ].Solve( );
 }
 
 //--------------------------------------------------------------------------------------------------
 void q3Scene::Step( )
 {
+	u32 floatState = q3GetFloatState( );
+
+	if ( m_deterministic )
+		q3SetFloatState( q3DefaultFloatState( ) );
+
+	Q3_PROFILE_BEGIN( );
+
+	q3BroadPhase* broadPhase = &m_contactManager.m_broadphase;
+
+	SynchronizeTransforms( );
+
 	if ( m_newBox )
 	{
-		m_contactManager.m_broadphase.UpdatePairs( );
+		broadPhase->UpdatePairs( );
 		m_newBox = false;
+
+		Q3_PROFILE_ADD( pairCount, broadPhase->m_pairCount );
+		Q3_PROFILE_ADD( treeVisits, broadPhase->m_queryVisits );
 	}
 
+	Q3_PROFILE_LAP( updatePairs );
+
 	m_contactManager.TestCollisions( );
 
-	for ( q3Body* body = m_bodyList; body; body = body->m_next )
-		body->m_flags &= ~q3Body::eIsland;
+	Q3_PROFILE_LAP( testCollisions );
 
-	// Size the stack island, pick worst case size
-	m_stack.Reserve(
-		sizeof( q3Body* ) * m_bodyCount
-		+ sizeof( q3VelocityState ) * m_bodyCount
-		+ sizeof( q3ContactConstraint* ) * m_contactManager.m_contactCount
-		+ sizeof( q3ContactConstraintState ) * m_contactManager.m_contactCount
-		+ sizeof( q3Body* ) * m_bodyCount
-	);
+	q3IslandGraph* graph = &m_contactManager.m_islandGraph;
+	graph->FinishMerges( );
+	graph->m_rebuiltCount = 0;
+	graph->m_reusedCount = 0;
+	graph->m_splitCount = 0;
 
-	q3Island island;
-	island.m_bodyCapacity = m_bodyCount;
-	island.m_contactCapacity = m_contactManager.m_contactCount;
-	island.m_bodies = (q3Body**)m_stack.Allocate( sizeof( q3Body* ) * m_bodyCount );
-	island.m_velocities = (q3VelocityState *)m_stack.Allocate( sizeof( q3VelocityState ) * m_bodyCount );
-	island.m_contacts = (q3ContactConstraint **)m_stack.Allocate( sizeof( q3ContactConstraint* ) * island.m_contactCapacity );
-	island.m_contactStates = (q3ContactConstraintState *)m_stack.Allocate( sizeof( q3ContactConstraintState ) * island.m_contactCapacity );
-	island.m_allowSleep = m_allowSleep;
-	island.m_enableFriction = m_enableFriction;
-	island.m_bodyCount = 0;
-	island.m_contactCount = 0;
-	island.m_dt = m_dt;
-	island.m_gravity = m_gravity;
-	island.m_iterations = m_iterations;
-
-	// Build each active island and then solve each built island
-	i32 stackSize = m_bodyCount;
-	q3Body** stack = (q3Body**)m_stack.Allocate( sizeof( q3Body* ) * stackSize );
-	for ( q3Body* seed = m_bodyList; seed; seed = seed->m_next )
-	{
-		// Seed cannot be apart of an island already
-		if ( seed->m_flags & q3Body::eIsland )
-			continue;
+	// Every island with an awake body is solved, in the order its first
+	// awake body has in the body list. Islands of sleeping bodies are not
+	// touched at all.
+	q3IslandGroup* awakeList = NULL;
+	q3IslandGroup* awakeTail = NULL;
+	i32 islandCapacity = 0;
+	i32 contactCount = 0;
+	i32 bodySlots = 0;
+
+	for ( q3Body* body = m_bodyList; body; body = body->m_next )
+	{
+		body->m_prevTx = body->m_tx;
+		body->m_prevQ = body->m_q;
 
-		// Seed must be awake
-		if ( !(seed->m_flags & q3Body::eAwake) )
+		if ( (body->m_flags & q3Body::eStatic) || !(body->m_flags & q3Body::eAwake) )
 			continue;
 
-		// Seed cannot be a static body in order to keep islands
-		// as small as possible
-		if ( seed->m_flags & q3Body::eStatic )
+		q3IslandGroup* group = body->m_island;
+		assert( !group->parent );
+
+		if ( group->awake )
 			continue;
 
-		i32 stackCount = 0;
-		stack[ stackCount++ ] = seed;
-		island.m_bodyCount = 0;
-		island.m_contactCount = 0;
+		group->awake = true;
 
-		// Mark seed as apart of island
-		seed->m_flags |= q3Body::eIsland;
+		if ( awakeTail )
+			awakeTail->nextAwake = group;
 
-		// Perform DFS on constraint graph
-		while( stackCount > 0 )
-		{
-			// Decrement stack to implement iterative backtracking
-			q3Body *body = stack[ --stackCount ];
-			island.Add( body );
+		else
+			awakeList = group;
 
-			// Awaken all bodies connected to the island
-			body->SetToAwake( );
+		awakeTail = group;
+		++islandCapacity;
 
-			// Do not search across static bodies to keep island
-			// formations as small as possible, however the static
-			// body itself should be apart of the island in order
-			// to properly represent a full contact
-			if ( body->m_flags & q3Body::eStatic )
-				continue;
+		// Static bodies only show up through a contact, so bodies +
+		// contacts bounds the body slots of the island
+		bodySlots += group->bodyCount + group->contactCount;
+		contactCount += group->contactCount;
+	}
 
-			// Search all contacts connected to this body
-			q3ContactEdge* contacts = body->m_contactList;
-			for ( q3ContactEdge* edge = contacts; edge; edge = edge->next )
-			{
-				q3ContactConstraint *contact = edge->constraint;
+	// Scheduling the contact solver needs per island scratch, see q3Island
+	bool scheduled = m_enableSIMD || m_threadPool;
+	i32 scratchSize = 0;
+	i32 batchCapacity = 0;
 
-				// Skip contacts that have been added to an island already
-				if ( contact->m_flags & q3ContactConstraint::eIsland )
-					continue;
+	if ( scheduled )
+	{
+		scratchSize = bodySlots + 3 * contactCount + islandCapacity;
+		batchCapacity = contactCount / 2;
+	}
 
-				// Can safely skip this contact if it didn't actually collide with anything
-				if ( !(contact->m_flags & q3ContactConstraint::eColliding) )
-					continue;
+	// Every island gets its own slice of the body and contact buffers so
+	// that islands can be solved independently of one another
+	m_stack.Reserve(
+		sizeof( q3Island ) * islandCapacity
+		+ sizeof( q3Body* ) * bodySlots
+		+ sizeof( q3VelocityState ) * bodySlots
+		+ sizeof( q3ContactConstraint* ) * contactCount
+		+ sizeof( q3ContactConstraintState ) * contactCount
+		+ sizeof( i32 ) * scratchSize
+		+ sizeof( q3ContactBatch ) * batchCapacity
+	);
 
-				// Skip sensors
-				if ( contact->A->sensor || contact->B->sensor )
-					continue;
+	q3Island* islands = (q3Island*)m_stack.Allocate( sizeof( q3Island ) * islandCapacity );
+	q3Body** islandBodies = (q3Body**)m_stack.Allocate( sizeof( q3Body* ) * bodySlots );
+	q3VelocityState* islandVelocities = (q3VelocityState *)m_stack.Allocate( sizeof( q3VelocityState ) * bodySlots );
+	q3ContactConstraint** islandContacts = (q3ContactConstraint **)m_stack.Allocate( sizeof( q3ContactConstraint* ) * contactCount );
+	q3ContactConstraintState* islandContactStates = (q3ContactConstraintState *)m_stack.Allocate( sizeof( q3ContactConstraintState ) * contactCount );
+	i32* islandScratch = (i32 *)m_stack.Allocate( sizeof( i32 ) * scratchSize );
+	q3ContactBatch* islandBatches = (q3ContactBatch *)m_stack.Allocate( sizeof( q3ContactBatch ) * batchCapacity );
+	i32 islandCount = 0;
+	i32 bodyOffset = 0;
+	i32 contactOffset = 0;
+	i32 batchOffset = 0;
+
+	// Fill in every awake island up front
+	for ( q3IslandGroup* group = awakeList; group; group = group->nextAwake )
+	{
+		q3Island& island = islands[ islandCount++ ];
+		island.m_bodies = islandBodies + bodyOffset;
+		island.m_velocities = islandVelocities + bodyOffset;
+		island.m_bodyCapacity = bodySlots - bodyOffset;
+		island.m_contacts = islandContacts + contactOffset;
+		island.m_contactStates = islandContactStates + contactOffset;
+		island.m_contactCapacity = contactCount - contactOffset;
+		island.m_allowSleep = m_allowSleep;
+		island.m_enableFriction = m_enableFriction;
+		island.m_enableSIMD = m_enableSIMD;
+		island.m_solverScratch = scheduled ? islandScratch + bodyOffset + 3 * contactOffset + islandCount - 1 : NULL;
+		island.m_contactBatches = scheduled ? islandBatches + batchOffset : NULL;
+		island.m_threadPool = NULL;
+		island.m_bodyCount = 0;
+		island.m_contactCount = 0;
+		island.m_dt = m_dt;
+		island.m_gravity = m_gravity;
+		island.m_relaxation = m_relaxation;
+		island.m_iterations = m_iterations;
+		island.m_minIterations = m_minIterations;
+		island.m_iterationTolerance = m_iterationTolerance;
+		island.m_iterationsUsed = 0;
+		island.m_asleep = false;
+
+		for ( q3Body* body = group->bodyList; body; body = body->m_islandNext )
+		{
+			island.Add( body );
 
-				// Mark island flag and add to island
-				contact->m_flags |= q3ContactConstraint::eIsland;
-				island.Add( contact );
+			// Awaken all bodies connected to the island
+			body->SetToAwake( );
+		}
 
-				// Attempt to add the other body in the contact to the island
-				// to simulate contact awakening propogation
-				q3Body* other = edge->other;
-				if ( other->m_flags & q3Body::eIsland )
-					continue;
+		for ( q3ContactConstraint* contact = group->contactList; contact; contact = contact->islandNext )
+		{
+			// Static bodies are not part of the group, but they should be
+			// apart of the island in order to properly represent a full
+			// contact
+			q3Body* bodies[ 2 ] = { contact->bodyA, contact->bodyB };
 
-				assert( stackCount < stackSize );
+			for ( i32 i = 0; i < 2; ++i )
+			{
+				q3Body* body = bodies[ i ];
 
-				stack[ stackCount++ ] = other;
-				other->m_flags |= q3Body::eIsland;
+				if ( (body->m_flags & q3Body::eStatic) && !(body->m_flags & q3Body::eIsland) )
+				{
+					body->m_flags |= q3Body::eIsland;
+					island.Add( body );
+				}
 			}
+
+			island.Add( contact );
 		}
 
 		assert( island.m_bodyCount != 0 );
 
+		// Island indices of shared static bodies are only valid until the
+		// next island is built, so the contact states are filled in now
 		island.Initialize( );
-		island.Solve( );
+
+		if ( m_threadPool && island.m_contactCount >= m_parallelSolveThreshold )
+			island.m_threadPool = m_threadPool;
+
+		bodyOffset += island.m_bodyCount;
+		contactOffset += island.m_contactCount;
+		batchOffset += island.m_contactCount / 2;
 
 		// Reset all static island flags
 		// This allows static bodies to participate in other island formations
@@ -187,39 +312,171 @@ void q3Scene::Step( )
 			if ( body->m_flags & q3Body::eStatic )
 				body->m_flags &= ~q3Body::eIsland;
 		}
+
+		if ( group->changed )
+			++graph->m_rebuiltCount;
+
+		else
+			++graph->m_reusedCount;
+
+		group->changed = false;
+	}
+
+	Q3_PROFILE_LAP( islandBuild );
+	Q3_PROFILE_ADD( islandCount, islandCount );
+	Q3_PROFILE_ADD( solvedContactCount, contactOffset );
+
+	// Solve each built island. Large islands use the pool on their own
+	// and are skipped by the task.
+	if ( m_threadPool )
+	{
+		m_threadPool->ParallelFor( q3SolveIslandTask, islands, islandCount );
+
+		for ( i32 i = 0; i < islandCount; ++i )
+		{
+			if ( islands[ i ].m_threadPool )
+				islands[ i ].Solve( );
+		}
+	}
+
+	else
+	{
+		for ( i32 i = 0; i < islandCount; ++i )
+			islands[ i ].Solve( );
 	}
 
-	m_stack.Free( stack );
-	m_stack.Free( island.m_contactStates );
-	m_stack.Free( island.m_contacts );
-	m_stack.Free( island.m_velocities );
-	m_stack.Free( island.m_bodies );
+	// Apply the sleep state of shared static bodies in island order. The
+	// last island touching a static body decides whether it sleeps.
+	q3IslandGroup* group = awakeList;
+	q3IslandGroup* splitGroup = NULL;
+	r32 splitSleepTime = Q3_SLEEP_TIME;
 
-	// Update the broadphase AABBs
-	for ( q3Body* body = m_bodyList; body; body = body->m_next )
+	for ( i32 i = 0; i < islandCount; ++i, group = group->nextAwake )
 	{
-		if ( body->m_flags & q3Body::eStatic )
-			continue;
+		q3Island& island = islands[ i ];
+
+		Q3_PROFILE_ADD( iterations, island.m_iterationsUsed );
+
+		for ( i32 j = 0; j < island.m_bodyCount; ++j )
+		{
+			q3Body *body = island.m_bodies[ j ];
+
+			if ( !(body->m_flags & q3Body::eStatic) )
+				continue;
+
+			body->SetToAwake( );
+
+			if ( island.m_asleep )
+				body->SetToSleep( );
+		}
+
+		// An island that lost contacts may have come apart. Once some of it
+		// is at rest it is split, so that part can go to sleep on its own.
+		// Only the island closest to sleep is split each step.
+		if ( group->removedCount && island.m_maxSleepTime > splitSleepTime )
+		{
+			splitGroup = group;
+			splitSleepTime = island.m_maxSleepTime;
+		}
+	}
+
+	m_stack.Free( islandBatches );
+	m_stack.Free( islandScratch );
+	m_stack.Free( islandContactStates );
+	m_stack.Free( islandContacts );
+	m_stack.Free( islandVelocities );
+	m_stack.Free( islandBodies );
+	m_stack.Free( islands );
+
+	Q3_PROFILE_LAP( islandSolve );
+
+	// Update the broadphase AABBs. Only bodies of solved islands moved,
+	// including the ones that just went to sleep.
+	while ( awakeList )
+	{
+		group = awakeList;
+		awakeList = group->nextAwake;
+
+		group->awake = false;
+		group->nextAwake = NULL;
 
-		body->SynchronizeProxies( );
+		for ( q3Body* body = group->bodyList; body; body = body->m_islandNext )
+			body->SynchronizeProxies( );
 	}
 
+	Q3_PROFILE_LAP( synchronizeProxies );
+
+	if ( splitGroup )
+		graph->Split( splitGroup, &m_stack );
+
+	Q3_PROFILE_LAP( islandSplit );
+
 	// Look for new contacts
 	m_contactManager.FindNewContacts( );
 
+	Q3_PROFILE_LAP( findNewContacts );
+	Q3_PROFILE_ADD( pairCount, broadPhase->m_pairCount );
+	Q3_PROFILE_ADD( treeVisits, broadPhase->m_queryVisits );
+	Q3_PROFILE_ADD( contactCount, m_contactManager.m_contactCount );
+
+	if ( m_querySnapshots )
+		broadPhase->UpdateSnapshots( );
+
 	// Clear all forces
 	for ( q3Body* body = m_bodyList; body; body = body->m_next )
 	{
 		q3Identity( body->m_force );
 		q3Identity( body->m_torque );
 	}
+
+	Q3_PROFILE_END( );
+
+	m_stack.Reset( );
+
+	if ( m_deterministic )
+		q3SetFloatState( floatState );
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3Scene::Advance( r32 realDt )
+{
+	m_accumulator += q3Max( realDt, r32( 0.0 ) );
+
+	i32 steps = 0;
+
+	while ( m_accumulator >= m_dt && steps < m_maxSubSteps )
+	{
+		Step( );
+		m_accumulator -= m_dt;
+		++steps;
+	}
+
+	// Out of sub steps, drop the whole steps still owed so that one slow
+	// frame does not leave every following frame behind as well
+	if ( m_accumulator >= m_dt )
+		m_accumulator = std::fmod( m_accumulator, m_dt );
+
+	return steps;
+}
+
+//--------------------------------------------------------------------------------------------------
+r32 q3Scene::GetInterpolationAlpha( ) const
+{
+	return q3Min( m_accumulator / m_dt, r32( 1.0 ) );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::SetMaxSubSteps( i32 maxSubSteps )
+{
+	m_maxSubSteps = q3Max( 1, maxSubSteps );
 }
 
 //--------------------------------------------------------------------------------------------------
 q3Body* q3Scene::CreateBody( const q3BodyDef& def )
 {
-	q3Body* body = (q3Body*)m_heap.Allocate( sizeof( q3Body ) );
+	q3Body* body = (q3Body*)m_bodyAllocator.Allocate( );
 	new (body) q3Body( def, this );
+	body->m_serial = m_bodySerial++;
 
 	// Add body to scene bodyList
 	body->m_prev = NULL;
@@ -231,6 +488,9 @@ q3Body* q3Scene::CreateBody( const q3BodyDef& def )
 	m_bodyList = body;
 	++m_bodyCount;
 
+	if ( !(body->m_flags & q3Body::eStatic) )
+		m_contactManager.m_islandGraph.AddBody( body );
+
 	return body;
 }
 
@@ -243,6 +503,21 @@ void q3Scene::RemoveBody( q3Body* body )
 
 	body->RemoveAllBoxes( );
 
+	if ( !(body->m_flags & q3Body::eStatic) )
+		m_contactManager.m_islandGraph.RemoveBody( body );
+
+	if ( body->m_flags & q3Body::eUnsynced )
+	{
+		for ( i32 i = 0; i < m_transformCount; ++i )
+		{
+			if ( m_transformBodies[ i ] == body )
+			{
+				m_transformBodies[ i ] = m_transformBodies[ --m_transformCount ];
+				break;
+			}
+		}
+	}
+
 	// Remove body from scene bodyList
 	if ( body->m_next )
 		body->m_next->m_prev = body->m_prev;
@@ -255,7 +530,7 @@ void q3Scene::RemoveBody( q3Body* body )
 
 	--m_bodyCount;
 
-	m_heap.Free( body );
+	m_bodyAllocator.Free( body );
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -269,12 +544,125 @@ void q3Scene::RemoveAllBodies( )
 
 		body->RemoveAllBoxes( );
 
-		m_heap.Free( body );
+		m_bodyAllocator.Free( body );
 
 		body = next;
 	}
 
 	m_bodyList = NULL;
+	m_bodyCount = 0;
+	m_transformCount = 0;
+	m_contactManager.m_islandGraph.Clear( );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::SetTransforms( q3Body** bodies, const q3Transform* transforms, i32 count )
+{
+	for ( i32 i = 0; i < count; ++i )
+	{
+		q3Body* body = bodies[ i ];
+		assert( body->m_scene == this );
+
+		// Rotation goes through the quaternion so the two agree, like in
+		// q3Body::SetTransform
+		body->m_q.Set( transforms[ i ].rotation );
+		body->m_q = q3Normalize( body->m_q );
+		body->m_tx.rotation = body->m_q.ToMat3( );
+		body->m_tx.position = transforms[ i ].position;
+		body->m_worldCenter = q3Mul( body->m_tx, body->m_localCenter );
+		body->m_prevTx = body->m_tx;
+		body->m_prevQ = body->m_q;
+
+		if ( !(body->m_flags & q3Body::eUnsynced) )
+		{
+			body->m_flags |= q3Body::eUnsynced;
+			AddUnsynced( body );
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::AddUnsynced( q3Body* body )
+{
+	if ( m_transformCount == m_transformCapacity )
+	{
+		q3Body** oldBodies = m_transformBodies;
+		m_transformCapacity = q3Max( 2 * m_transformCapacity, 16 );
+		m_transformBodies = (q3Body**)q3Alloc( m_transformCapacity * sizeof( q3Body* ) );
+
+		if ( oldBodies )
+		{
+			memcpy( m_transformBodies, oldBodies, m_transformCount * sizeof( q3Body* ) );
+			q3Free( oldBodies );
+		}
+	}
+
+	m_transformBodies[ m_transformCount++ ] = body;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::SynchronizeTransforms( )
+{
+	if ( !m_transformCount )
+		return;
+
+	// Boxes of static bodies live in the static index, so they are
+	// gathered in front of the others and each index is updated once
+	i32 boxCount = 0;
+
+	for ( i32 i = 0; i < m_transformCount; ++i )
+	{
+		for ( q3Box* box = m_transformBodies[ i ]->m_boxes; box; box = box->next )
+		{
+			if ( box->broadPhaseIndex != q3k_nullProxyKey )
+				++boxCount;
+		}
+	}
+
+	m_stack.Reserve( boxCount * (sizeof( q3AABB ) + 2 * sizeof( i32 ) + sizeof( bool )) );
+	q3AABB* aabbs = (q3AABB*)m_stack.Allocate( sizeof( q3AABB ) * boxCount );
+	i32* keys = (i32*)m_stack.Allocate( sizeof( i32 ) * boxCount );
+	i32* ids = (i32*)m_stack.Allocate( sizeof( i32 ) * boxCount );
+	bool* moved = (bool*)m_stack.Allocate( sizeof( bool ) * boxCount );
+	i32 staticCount = 0;
+	i32 count = 0;
+
+	for ( i32 pass = 0; pass < 2; ++pass )
+	{
+		for ( i32 i = 0; i < m_transformCount; ++i )
+		{
+			q3Body* body = m_transformBodies[ i ];
+
+			if ( ((body->m_flags & q3Body::eStatic) != 0) != (pass == 0) )
+				continue;
+
+			// Boxes still waiting for EndShapeEdit get their AABB on insertion
+			for ( q3Box* box = body->m_boxes; box; box = box->next )
+			{
+				if ( box->broadPhaseIndex == q3k_nullProxyKey )
+					continue;
+
+				box->ComputeAABB( body->m_tx, aabbs + count );
+				keys[ count++ ] = box->broadPhaseIndex;
+			}
+
+			body->m_flags &= ~q3Body::eUnsynced;
+		}
+
+		if ( pass == 0 )
+			staticCount = count;
+	}
+
+	q3BroadPhase* broadPhase = &m_contactManager.m_broadphase;
+	broadPhase->Update( keys, aabbs, staticCount, ids, moved );
+	broadPhase->Update( keys + staticCount, aabbs + staticCount, count - staticCount, ids, moved );
+
+	m_stack.Free( moved );
+	m_stack.Free( ids );
+	m_stack.Free( keys );
+	m_stack.Free( aabbs );
+
+	m_transformCount = 0;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -295,12 +683,107 @@ void q3Scene::SetIterations( i32 iterations )
 	m_iterations = q3Max( 1, iterations );
 }
 
+//--------------------------------------------------------------------------------------------------
+void q3Scene::SetAdaptiveIterations( i32 minIterations, r32 tolerance )
+{
+	m_minIterations = q3Max( 1, minIterations );
+	m_iterationTolerance = q3Max( r32( 0.0 ), tolerance );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::SetRelaxation( r32 relaxation )
+{
+	m_relaxation = q3Clamp( r32( 0.1 ), r32( 1.9 ), relaxation );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::SetThreadCount( i32 threadCount )
+{
+	threadCount = q3Max( 1, threadCount );
+
+	if ( threadCount == GetThreadCount( ) )
+		return;
+
+	if ( m_threadPool )
+	{
+		m_threadPool->~q3ThreadPool( );
+		q3Free( m_threadPool );
+		m_threadPool = NULL;
+	}
+
+	if ( threadCount > 1 )
+	{
+		m_threadPool = (q3ThreadPool*)q3Alloc( sizeof( q3ThreadPool ) );
+		new (m_threadPool) q3ThreadPool( threadCount );
+	}
+
+	m_contactManager.m_threadPool = m_threadPool;
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3Scene::GetThreadCount( ) const
+{
+	return m_threadPool ? m_threadPool->GetThreadCount( ) : 1;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::SetParallelSolveThreshold( i32 contactCount )
+{
+	m_parallelSolveThreshold = q3Max( 1, contactCount );
+}
+
 //--------------------------------------------------------------------------------------------------
 void q3Scene::SetEnableFriction( bool enabled )
 {
 	m_enableFriction = enabled;
 }
 
+//--------------------------------------------------------------------------------------------------
+void q3Scene::SetEnableSIMD( bool enabled )
+{
+	m_enableSIMD = enabled;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::SetDeterministic( bool enabled )
+{
+	m_deterministic = enabled;
+	m_contactManager.m_broadphase.SetDeterministic( enabled );
+}
+
+//--------------------------------------------------------------------------------------------------
+static void q3HashBytes( u64& hash, const void* data, i32 size )
+{
+	const u8* bytes = (const u8*)data;
+
+	for ( i32 i = 0; i < size; ++i )
+	{
+		hash ^= bytes[ i ];
+		hash *= 1099511628211ULL;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+u64 q3Scene::ComputeStateHash( ) const
+{
+	u64 hash = 14695981039346656037ULL;
+
+	for ( const q3Body* body = m_bodyList; body; body = body->m_next )
+	{
+		// Component by component, padding would hash garbage
+		const r32 state[ 13 ] = {
+			body->m_tx.position.x, body->m_tx.position.y, body->m_tx.position.z,
+			body->m_q.x, body->m_q.y, body->m_q.z, body->m_q.w,
+			body->m_linearVelocity.x, body->m_linearVelocity.y, body->m_linearVelocity.z,
+			body->m_angularVelocity.x, body->m_angularVelocity.y, body->m_angularVelocity.z
+		};
+
+		q3HashBytes( hash, state, sizeof( state ) );
+	}
+
+	return hash;
+}
+
 //--------------------------------------------------------------------------------------------------
 void q3Scene::Render( q3Render* render ) const
 {
@@ -313,7 +796,7 @@ void q3Scene::Render( q3Render* render ) const
 	}
 
 	m_contactManager.RenderContacts( render );
-	//m_contactManager.m_broadphase.m_tree.Render( render );
+	//m_contactManager.m_broadphase.m_dynamicTree.Render( render );
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -334,6 +817,69 @@ void q3Scene::Shutdown( )
 	RemoveAllBodies( );
 
 	m_boxAllocator.Clear( );
+	m_bodyAllocator.Clear( );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::GetIslandStats( q3IslandStats* stats ) const
+{
+	const q3IslandGraph& graph = m_contactManager.m_islandGraph;
+
+	stats->islandCount = graph.m_islandCount;
+	stats->rebuiltCount = graph.m_rebuiltCount;
+	stats->reusedCount = graph.m_reusedCount;
+	stats->splitCount = graph.m_splitCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::GetStepStats( q3StepStats* stats ) const
+{
+	*stats = m_stepStats;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::GetMemoryStats( q3MemoryStats* stats ) const
+{
+	const i32 count = 4;
+	q3MemoryStats parts[ count ];
+	m_bodyAllocator.GetStats( parts + 0 );
+	m_boxAllocator.GetStats( parts + 1 );
+	m_contactManager.m_allocator.GetStats( parts + 2 );
+	m_contactManager.m_islandGraph.GetStats( parts + 3 );
+
+	stats->bytesUsed = 0;
+	stats->peakBytesUsed = 0;
+	stats->bytesReserved = 0;
+	stats->bytesFragmented = 0;
+
+	for ( i32 i = 0; i < count; ++i )
+	{
+		stats->bytesUsed += parts[ i ].bytesUsed;
+		stats->peakBytesUsed += parts[ i ].peakBytesUsed;
+		stats->bytesReserved += parts[ i ].bytesReserved;
+		stats->bytesFragmented += parts[ i ].bytesFragmented;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::SetFrameArena( const q3FrameArenaDef& def )
+{
+	m_stack.SetArena( u32( q3Max( 0, def.bytes ) ) );
+	m_contactManager.m_broadphase.ReserveBuffers( def.pairCapacity, def.moveCapacity );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::GetFrameArenaStats( q3FrameArenaStats* stats ) const
+{
+	const q3BroadPhase* broadPhase = &m_contactManager.m_broadphase;
+
+	stats->capacity.bytes = i32( m_stack.GetSize( ) );
+	stats->capacity.pairCapacity = broadPhase->m_pairCapacity;
+	stats->capacity.moveCapacity = broadPhase->m_moveCapacity;
+	stats->peak.bytes = i32( m_stack.GetPeakSize( ) );
+	stats->peak.pairCapacity = broadPhase->m_peakPairCount;
+	stats->peak.moveCapacity = broadPhase->m_peakMoveCount;
+	stats->overflowCount = m_stack.GetOverflowCount( ) + broadPhase->m_overflowCount;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -350,7 +896,7 @@ void q3Scene::QueryAABB( q3QueryCallback *cb, const q3AABB& aabb ) const
 		bool TreeCallBack( i32 id )
 		{
 			q3AABB aabb;
-			q3Box *box = (q3Box *)broadPhase->m_tree.GetUserData( id );
+			q3Box *box = (q3Box *)broadPhase->GetUserData( id );
 
 			box->ComputeAABB( box->body->GetTransform( ), &aabb );
 
@@ -371,20 +917,138 @@ void q3Scene::QueryAABB( q3QueryCallback *cb, const q3AABB& aabb ) const
 	wrapper.m_aabb = aabb;
 	wrapper.broadPhase = &m_contactManager.m_broadphase;
 	wrapper.cb = cb;
-	m_contactManager.m_broadphase.m_tree.Query( &wrapper, aabb );
+	m_contactManager.m_broadphase.Query( &wrapper, aabb );
 }
 
 //--------------------------------------------------------------------------------------------------
-void q3Scene::QueryPoint( q3QueryCallback *cb, const q3Vec3& point ) const
+// Scratch for batched queries lives on the call stack unless the batch or
+// the trees are large
+const i32 q3k_batchQueryScratch = 512;
+
+//--------------------------------------------------------------------------------------------------
+i32 q3Scene::QueryAABBs( const q3AABB *aabbs, i32 count, q3QueryHit *hits, i32 hitCapacity ) const
 {
 	struct SceneQueryWrapper
 	{
-		bool TreeCallBack( i32 id )
+		bool TreeCallBack( i32 queryIndex, i32 id )
 		{
-			q3Box *box = (q3Box *)broadPhase->m_tree.GetUserData( id );
+			q3AABB aabb;
+			q3Box *box = (q3Box *)broadPhase->GetUserData( id );
 
-			if ( box->TestPoint( box->body->GetTransform( ), m_point ) )
-			{
+			box->ComputeAABB( box->body->GetTransform( ), &aabb );
+
+			if ( q3AABBtoAABB( aabbs[ queryIndex ], aabb ) )
+			{
+				hits[ hitCount ].queryIndex = queryIndex;
+				hits[ hitCount ].box = box;
+				++hitCount;
+			}
+
+			return hitCount < hitCapacity;
+		}
+
+		bool IsActive( i32 queryIndex )
+		{
+			Q3_UNUSED( queryIndex );
+			return true;
+		}
+
+		const q3BroadPhase *broadPhase;
+		const q3AABB *aabbs;
+		q3QueryHit *hits;
+		i32 hitCount;
+		i32 hitCapacity;
+	};
+
+	if ( count <= 0 || hitCapacity <= 0 )
+		return 0;
+
+	const q3BroadPhase& broadPhase = m_contactManager.m_broadphase;
+	i32 localScratch[ q3k_batchQueryScratch ];
+	i32 scratchSize = broadPhase.GetBatchScratchSize( count );
+	i32 *scratch = scratchSize <= q3k_batchQueryScratch ? localScratch : (i32 *)q3Alloc( sizeof( i32 ) * scratchSize );
+
+	SceneQueryWrapper wrapper;
+	wrapper.broadPhase = &broadPhase;
+	wrapper.aabbs = aabbs;
+	wrapper.hits = hits;
+	wrapper.hitCount = 0;
+	wrapper.hitCapacity = hitCapacity;
+	broadPhase.Query( &wrapper, aabbs, count, scratch );
+
+	if ( scratch != localScratch )
+		q3Free( scratch );
+
+	return wrapper.hitCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::CountAABBs( const q3AABB *aabbs, i32 count, i32 *counts, i32 limit ) const
+{
+	struct SceneQueryWrapper
+	{
+		bool TreeCallBack( i32 queryIndex, i32 id )
+		{
+			q3AABB aabb;
+			q3Box *box = (q3Box *)broadPhase->GetUserData( id );
+
+			box->ComputeAABB( box->body->GetTransform( ), &aabb );
+
+			if ( q3AABBtoAABB( aabbs[ queryIndex ], aabb ) )
+			{
+				if ( ++counts[ queryIndex ] == limit )
+					--remaining;
+			}
+
+			return remaining > 0;
+		}
+
+		bool IsActive( i32 queryIndex )
+		{
+			return counts[ queryIndex ] < limit;
+		}
+
+		const q3BroadPhase *broadPhase;
+		const q3AABB *aabbs;
+		i32 *counts;
+		i32 limit;
+		i32 remaining;
+	};
+
+	for ( i32 i = 0; i < count; ++i )
+		counts[ i ] = 0;
+
+	if ( count <= 0 || limit <= 0 )
+		return;
+
+	const q3BroadPhase& broadPhase = m_contactManager.m_broadphase;
+	i32 localScratch[ q3k_batchQueryScratch ];
+	i32 scratchSize = broadPhase.GetBatchScratchSize( count );
+	i32 *scratch = scratchSize <= q3k_batchQueryScratch ? localScratch : (i32 *)q3Alloc( sizeof( i32 ) * scratchSize );
+
+	SceneQueryWrapper wrapper;
+	wrapper.broadPhase = &broadPhase;
+	wrapper.aabbs = aabbs;
+	wrapper.counts = counts;
+	wrapper.limit = limit;
+	wrapper.remaining = count;
+	broadPhase.Query( &wrapper, aabbs, count, scratch );
+
+	if ( scratch != localScratch )
+		q3Free( scratch );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::QueryPoint( q3QueryCallback *cb, const q3Vec3& point ) const
+{
+	struct SceneQueryWrapper
+	{
+		bool TreeCallBack( i32 id )
+		{
+			q3Box *box = (q3Box *)broadPhase->GetUserData( id );
+
+			if ( box->TestPoint( box->body->GetTransform( ), m_point ) )
+			{
 				cb->ReportShape( box );
 			}
 
@@ -405,7 +1069,7 @@ void q3Scene::QueryPoint( q3QueryCallback *cb, const q3Vec3& point ) const
 	q3AABB aabb;
 	aabb.min = point - v;
 	aabb.max = point + v;
-	m_contactManager.m_broadphase.m_tree.Query( &wrapper, aabb );
+	m_contactManager.m_broadphase.Query( &wrapper, aabb );
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -415,7 +1079,7 @@ void q3Scene::RayCast( q3QueryCallback *cb, q3RaycastData& rayCast ) const
 	{
 		bool TreeCallBack( i32 id )
 		{
-			q3Box *box = (q3Box *)broadPhase->m_tree.GetUserData( id );
+			q3Box *box = (q3Box *)broadPhase->GetUserData( id );
 
 			if ( box->Raycast( box->body->GetTransform( ), m_rayCast ) )
 			{
@@ -434,7 +1098,899 @@ void q3Scene::RayCast( q3QueryCallback *cb, q3RaycastData& rayCast ) const
 	wrapper.m_rayCast = &rayCast;
 	wrapper.broadPhase = &m_contactManager.m_broadphase;
 	wrapper.cb = cb;
-	m_contactManager.m_broadphase.m_tree.Query( &wrapper, rayCast );
+	m_contactManager.m_broadphase.Query( &wrapper, rayCast );
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3Scene::GetStaticProxyCount( ) const
+{
+	return m_contactManager.m_broadphase.GetStaticProxyCount( );
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3Scene::GetDynamicProxyCount( ) const
+{
+	return m_contactManager.m_broadphase.GetDynamicProxyCount( );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::RebuildBroadPhase( )
+{
+	SynchronizeTransforms( );
+
+	m_contactManager.m_broadphase.Rebuild( );
+
+	if ( m_querySnapshots )
+		m_contactManager.m_broadphase.UpdateSnapshots( );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3Scene::SetQuerySnapshots( bool enabled )
+{
+	m_querySnapshots = enabled;
+
+	if ( enabled )
+		m_contactManager.m_broadphase.UpdateSnapshots( );
+	else
+		m_contactManager.m_broadphase.ClearSnapshots( );
+}
+
+//--------------------------------------------------------------------------------------------------
+r32 q3Scene::GetBroadPhaseQueryVisits( ) const
+{
+	return m_contactManager.m_broadphase.ComputeAverageQueryVisits( );
+}
+
+//--------------------------------------------------------------------------------------------------
+// Scene state records, copied in and out of the state buffer with memcpy
+// since the buffer carries no alignment guarantees
+const u32 q3k_sceneStateMagic = 0x53335133;
+const i32 q3k_sceneStateVersion = 5;
+
+struct q3SceneStateHeader
+{
+	u32 magic;
+	i32 version;
+	i32 size;	// Bytes written, header included
+	i32 bodyCount;
+	i32 boxCount;
+	i32 contactCount;
+	i32 moveCount;
+	i32 islandCount;
+	i32 bodySerial;
+	i32 boxSerial;
+	i32 newBox;
+};
+
+// q3Mat3 declares its own assignment, which rules out memcpy for any
+// record holding one. Records keep matrices as plain columns instead.
+struct q3Mat3Record
+{
+	q3Vec3 ex;
+	q3Vec3 ey;
+	q3Vec3 ez;
+};
+
+struct q3TransformRecord
+{
+	q3Vec3 position;
+	q3Mat3Record rotation;
+};
+
+struct q3BodyRecord
+{
+	q3Mat3Record invInertiaModel;
+	q3Mat3Record invInertiaWorld;
+	q3Mat3Record boxInertia;
+	q3TransformRecord tx;
+	q3Quaternion q;
+	q3Vec3 linearVelocity;
+	q3Vec3 angularVelocity;
+	q3Vec3 force;
+	q3Vec3 torque;
+	q3Vec3 localCenter;
+	q3Vec3 worldCenter;
+	q3Vec3 boxMoment;
+	void* userData;
+	r32 mass;
+	r32 invMass;
+	r32 boxMass;
+	r32 sleepTime;
+	r32 gravityScale;
+	r32 linearDamping;
+	r32 angularDamping;
+	i32 layers;
+	i32 flags;
+	i32 serial;
+	i32 massRemovals;
+	i32 boxCount;	// The body's boxes follow the previous body's boxes
+};
+
+struct q3BoxRecord
+{
+	q3TransformRecord local;
+	q3Vec3 e;
+	q3AABB fatAABB;
+	void* userData;
+	r32 friction;
+	r32 restitution;
+	r32 density;
+	i32 serial;
+	bool sensor;
+};
+
+// Followed by the manifold's contactCount contacts
+struct q3ContactRecord
+{
+	q3Vec3 normal;
+	q3Vec3 tangentVectors[ 2 ];
+	q3Mat3Record cacheRotation;
+	q3Vec3 cacheTranslation;
+	q3Vec3 cacheNormal;
+	r32 friction;
+	r32 restitution;
+	i32 flags;
+	i32 serialA;
+	i32 serialB;
+	i32 contactCount;
+	i32 cacheAxis;
+	i32 cacheCount;
+	i32 sensor;
+};
+
+// Followed by the serials of the island's bodies, then the serials of the
+// two boxes of each of its contacts
+struct q3IslandRecord
+{
+	i32 bodyCount;
+	i32 contactCount;
+	i32 removedCount;
+};
+
+//--------------------------------------------------------------------------------------------------
+static inline void q3StoreState( const q3Mat3& m, q3Mat3Record* record )
+{
+	record->ex = m.ex;
+	record->ey = m.ey;
+	record->ez = m.ez;
+}
+
+//--------------------------------------------------------------------------------------------------
+static inline void q3StoreState( const q3Transform& tx, q3TransformRecord* record )
+{
+	record->position = tx.position;
+	q3StoreState( tx.rotation, &record->rotation );
+}
+
+//--------------------------------------------------------------------------------------------------
+static inline const q3Mat3 q3LoadState( const q3Mat3Record& record )
+{
+	return q3Mat3( record.ex, record.ey, record.ez );
+}
+
+//--------------------------------------------------------------------------------------------------
+static inline const q3Transform q3LoadState( const q3TransformRecord& record )
+{
+	q3Transform tx;
+	tx.position = record.position;
+	tx.rotation = q3LoadState( record.rotation );
+	return tx;
+}
+
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+static inline void q3WriteState( u8*& cursor, const T& value )
+{
+	memcpy( cursor, &value, sizeof( T ) );
+	cursor += sizeof( T );
+}
+
+//--------------------------------------------------------------------------------------------------
+template <typename T>
+static inline void q3ReadState( const u8*& cursor, T* value )
+{
+	memcpy( value, cursor, sizeof( T ) );
+	cursor += sizeof( T );
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3Scene::GetStateSize( ) const
+{
+	const q3BroadPhase& broadPhase = m_contactManager.m_broadphase;
+	i32 boxCount = 0;
+
+	for ( const q3Body* body = m_bodyList; body; body = body->m_next )
+	{
+		for ( const q3Box* box = body->m_boxes; box; box = box->next )
+			++boxCount;
+	}
+
+	i32 pointCount = 0;
+	for ( const q3ContactConstraint* contact = m_contactManager.m_contactList; contact; contact = contact->next )
+		pointCount += contact->manifold.contactCount;
+
+	const q3IslandGraph& graph = m_contactManager.m_islandGraph;
+	i32 islandSize = graph.m_islandCount * sizeof( q3IslandRecord );
+
+	for ( const q3IslandGroup* island = graph.m_islandList; island; island = island->next )
+		islandSize += (island->bodyCount + 2 * island->contactCount) * sizeof( i32 );
+
+	return sizeof( q3SceneStateHeader )
+		+ m_bodyCount * sizeof( q3BodyRecord )
+		+ boxCount * sizeof( q3BoxRecord )
+		+ m_contactManager.m_contactCount * sizeof( q3ContactRecord )
+		+ pointCount * sizeof( q3Contact )
+		+ broadPhase.m_moveCount * sizeof( i32 )
+		+ islandSize;
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3Scene::SaveState( void* buffer ) const
+{
+	const q3BroadPhase& broadPhase = m_contactManager.m_broadphase;
+	u8* cursor = (u8*)buffer;
+
+	q3SceneStateHeader header;
+	header.magic = q3k_sceneStateMagic;
+	header.version = q3k_sceneStateVersion;
+	header.bodyCount = m_bodyCount;
+	header.boxCount = 0;
+	header.contactCount = m_contactManager.m_contactCount;
+	header.moveCount = 0;
+	header.islandCount = 0;
+	header.bodySerial = m_bodySerial;
+	header.boxSerial = m_boxSerial;
+	header.newBox = m_newBox ? 1 : 0;
+
+	// The header is written last, once the counts are known
+	cursor += sizeof( q3SceneStateHeader );
+
+	for ( const q3Body* body = m_bodyList; body; body = body->m_next )
+	{
+		assert( !(body->m_flags & q3Body::eShapeEdit) );
+
+		q3BodyRecord state;
+		q3StoreState( body->m_invInertiaModel, &state.invInertiaModel );
+		q3StoreState( body->m_invInertiaWorld, &state.invInertiaWorld );
+		q3StoreState( body->m_boxInertia, &state.boxInertia );
+		q3StoreState( body->m_tx, &state.tx );
+		state.q = body->m_q;
+		state.linearVelocity = body->m_linearVelocity;
+		state.angularVelocity = body->m_angularVelocity;
+		state.force = body->m_force;
+		state.torque = body->m_torque;
+		state.localCenter = body->m_localCenter;
+		state.worldCenter = body->m_worldCenter;
+		state.boxMoment = body->m_boxMoment;
+		state.userData = body->m_userData;
+		state.mass = body->m_mass;
+		state.invMass = body->m_invMass;
+		state.boxMass = body->m_boxMass;
+		state.massRemovals = body->m_massRemovals;
+		state.sleepTime = body->m_sleepTime;
+		state.gravityScale = body->m_gravityScale;
+		state.linearDamping = body->m_linearDamping;
+		state.angularDamping = body->m_angularDamping;
+		state.layers = body->m_layers;
+		state.flags = body->m_flags;
+		state.serial = body->m_serial;
+		state.boxCount = 0;
+
+		for ( const q3Box* box = body->m_boxes; box; box = box->next )
+			++state.boxCount;
+
+		q3WriteState( cursor, state );
+		header.boxCount += state.boxCount;
+	}
+
+	for ( const q3Body* body = m_bodyList; body; body = body->m_next )
+	{
+		for ( const q3Box* box = body->m_boxes; box; box = box->next )
+		{
+			q3BoxRecord state;
+			q3StoreState( box->local, &state.local );
+			state.e = box->e;
+			state.fatAABB = broadPhase.GetFatAABB( box->broadPhaseIndex );
+			state.userData = box->userData;
+			state.friction = box->friction;
+			state.restitution = box->restitution;
+			state.density = box->density;
+			state.serial = box->serial;
+			state.sensor = box->sensor;
+
+			q3WriteState( cursor, state );
+		}
+	}
+
+	for ( const q3ContactConstraint* contact = m_contactManager.m_contactList; contact; contact = contact->next )
+	{
+		const q3Manifold& manifold = contact->manifold;
+
+		q3ContactRecord state;
+		state.normal = manifold.normal;
+		state.tangentVectors[ 0 ] = manifold.tangentVectors[ 0 ];
+		state.tangentVectors[ 1 ] = manifold.tangentVectors[ 1 ];
+		q3StoreState( manifold.cacheRotation, &state.cacheRotation );
+		state.cacheTranslation = manifold.cacheTranslation;
+		state.cacheNormal = manifold.cacheNormal;
+		state.friction = contact->friction;
+		state.restitution = contact->restitution;
+		state.flags = contact->m_flags;
+		state.serialA = contact->A->serial;
+		state.serialB = contact->B->serial;
+		state.contactCount = manifold.contactCount;
+		state.cacheAxis = manifold.cacheAxis;
+		state.cacheCount = manifold.cacheCount;
+		state.sensor = manifold.sensor ? 1 : 0;
+
+		q3WriteState( cursor, state );
+
+		memcpy( cursor, manifold.contacts, manifold.contactCount * sizeof( q3Contact ) );
+		cursor += manifold.contactCount * sizeof( q3Contact );
+	}
+
+	for ( i32 i = 0; i < broadPhase.m_moveCount; ++i )
+	{
+		i32 key = broadPhase.m_moveBuffer[ i ];
+
+		if ( key == q3k_nullProxyKey )
+			continue;
+
+		q3WriteState( cursor, ((const q3Box*)broadPhase.GetUserData( key ))->serial );
+		++header.moveCount;
+	}
+
+	// Islands decide the order the solver sees bodies and contacts in
+	const q3IslandGraph& graph = m_contactManager.m_islandGraph;
+	assert( !graph.m_mergedList );
+
+	for ( const q3IslandGroup* island = graph.m_islandList; island; island = island->next )
+	{
+		q3IslandRecord state;
+		state.bodyCount = island->bodyCount;
+		state.contactCount = island->contactCount;
+		state.removedCount = island->removedCount;
+
+		q3WriteState( cursor, state );
+
+		for ( const q3Body* body = island->bodyList; body; body = body->m_islandNext )
+			q3WriteState( cursor, body->m_serial );
+
+		for ( const q3ContactConstraint* contact = island->contactList; contact; contact = contact->islandNext )
+		{
+			q3WriteState( cursor, contact->A->serial );
+			q3WriteState( cursor, contact->B->serial );
+		}
+
+		++header.islandCount;
+	}
+
+	header.size = i32( cursor - (u8*)buffer );
+	memcpy( buffer, &header, sizeof( q3SceneStateHeader ) );
+
+	return header.size;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Marks of q3Scene::CheckState
+const u8 q3k_stateSaved = 0x1;
+const u8 q3k_stateDynamic = 0x2;	// Body that may join an island
+const u8 q3k_stateIsland = 0x4;	// Body already listed by an island
+
+//--------------------------------------------------------------------------------------------------
+static inline bool q3StateFits( const u8* cursor, const u8* end, i64 count, i64 size )
+{
+	return count >= 0 && count * size <= i64( end - cursor );
+}
+
+//--------------------------------------------------------------------------------------------------
+// Every count must fit in the bytes the header claims, and every serial
+// must name an object of the state itself, so LoadState can follow them
+// blindly. bodyMarks and boxMarks hold bodySerial and boxSerial zeroed
+// bytes of the header.
+bool q3Scene::CheckState( const u8* buffer, u8* bodyMarks, u8* boxMarks )
+{
+	const u8* cursor = buffer;
+
+	q3SceneStateHeader header;
+	q3ReadState( cursor, &header );
+
+	const u8* end = buffer + header.size;
+
+	if ( !q3StateFits( cursor, end, header.bodyCount, sizeof( q3BodyRecord ) ) )
+		return false;
+
+	const u8* boxCursor = cursor + header.bodyCount * sizeof( q3BodyRecord );
+
+	if ( !q3StateFits( boxCursor, end, header.boxCount, sizeof( q3BoxRecord ) ) )
+		return false;
+
+	i32 boxCount = 0;
+
+	for ( i32 i = 0; i < header.bodyCount; ++i )
+	{
+		q3BodyRecord state;
+		q3ReadState( cursor, &state );
+
+		if ( state.serial < 0 || state.serial >= header.bodySerial || bodyMarks[ state.serial ] )
+			return false;
+
+		if ( state.boxCount < 0 || state.boxCount > header.boxCount - boxCount )
+			return false;
+
+		bodyMarks[ state.serial ] = q3k_stateSaved;
+
+		if ( !(state.flags & q3Body::eStatic) )
+			bodyMarks[ state.serial ] |= q3k_stateDynamic;
+
+		boxCount += state.boxCount;
+	}
+
+	if ( boxCount != header.boxCount )
+		return false;
+
+	for ( i32 i = 0; i < header.boxCount; ++i )
+	{
+		q3BoxRecord state;
+		q3ReadState( cursor, &state );
+
+		if ( state.serial < 0 || state.serial >= header.boxSerial || boxMarks[ state.serial ] )
+			return false;
+
+		boxMarks[ state.serial ] = q3k_stateSaved;
+	}
+
+	for ( i32 i = 0; i < header.contactCount; ++i )
+	{
+		if ( !q3StateFits( cursor, end, 1, sizeof( q3ContactRecord ) ) )
+			return false;
+
+		q3ContactRecord state;
+		q3ReadState( cursor, &state );
+
+		if ( state.serialA < 0 || state.serialA >= header.boxSerial || !boxMarks[ state.serialA ] )
+			return false;
+
+		if ( state.serialB < 0 || state.serialB >= header.boxSerial || !boxMarks[ state.serialB ] )
+			return false;
+
+		if ( state.contactCount < 0 || state.contactCount > 8 || !q3StateFits( cursor, end, state.contactCount, sizeof( q3Contact ) ) )
+			return false;
+
+		cursor += state.contactCount * sizeof( q3Contact );
+	}
+
+	if ( !q3StateFits( cursor, end, header.moveCount, sizeof( i32 ) ) )
+		return false;
+
+	for ( i32 i = 0; i < header.moveCount; ++i )
+	{
+		i32 serial;
+		q3ReadState( cursor, &serial );
+
+		if ( serial < 0 || serial >= header.boxSerial || !boxMarks[ serial ] )
+			return false;
+	}
+
+	for ( i32 i = 0; i < header.islandCount; ++i )
+	{
+		if ( !q3StateFits( cursor, end, 1, sizeof( q3IslandRecord ) ) )
+			return false;
+
+		q3IslandRecord state;
+		q3ReadState( cursor, &state );
+
+		if ( !q3StateFits( cursor, end, state.bodyCount, sizeof( i32 ) ) )
+			return false;
+
+		for ( i32 j = 0; j < state.bodyCount; ++j )
+		{
+			i32 serial;
+			q3ReadState( cursor, &serial );
+
+			if ( serial < 0 || serial >= header.bodySerial || bodyMarks[ serial ] != (q3k_stateSaved | q3k_stateDynamic) )
+				return false;
+
+			bodyMarks[ serial ] |= q3k_stateIsland;
+		}
+
+		if ( !q3StateFits( cursor, end, state.contactCount, 2 * sizeof( i32 ) ) )
+			return false;
+
+		for ( i32 j = 0; j < 2 * state.contactCount; ++j )
+		{
+			i32 serial;
+			q3ReadState( cursor, &serial );
+
+			if ( serial < 0 || serial >= header.boxSerial || !boxMarks[ serial ] )
+				return false;
+		}
+	}
+
+	return cursor == end;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool q3Scene::LoadState( const void* buffer, i32 size )
+{
+	q3BroadPhase& broadPhase = m_contactManager.m_broadphase;
+	const u8* cursor = (const u8*)buffer;
+
+	if ( size < i32( sizeof( q3SceneStateHeader ) ) )
+		return false;
+
+	q3SceneStateHeader header;
+	q3ReadState( cursor, &header );
+
+	if ( header.magic != q3k_sceneStateMagic || header.version != q3k_sceneStateVersion )
+		return false;
+
+	if ( header.size < i32( sizeof( q3SceneStateHeader ) ) || header.size > size )
+		return false;
+
+	if ( header.bodyCount < 0 || header.boxCount < 0 || header.contactCount < 0 || header.moveCount < 0 || header.islandCount < 0 )
+		return false;
+
+	if ( header.bodySerial < 0 || header.boxSerial < 0 )
+		return false;
+
+	// Bodies and boxes are looked up by serial. Serials of both the current
+	// and the saved objects are below the larger of the two counters.
+	i32 bodySlots = q3Max( m_bodySerial, header.bodySerial );
+	i32 boxSlots = q3Max( m_boxSerial, header.boxSerial );
+	i64 lookupSize = i64( sizeof( void* ) ) * (i64( bodySlots ) + boxSlots + header.bodyCount + header.boxCount + 2 * i64( header.contactCount ));
+
+	if ( lookupSize > i64( 0x7fffffff ) )
+		return false;
+
+	m_stack.Reserve( header.bodySerial + header.boxSerial );
+	u8* bodyMarks = (u8*)m_stack.Allocate( header.bodySerial );
+	u8* boxMarks = (u8*)m_stack.Allocate( header.boxSerial );
+	memset( bodyMarks, 0, header.bodySerial );
+	memset( boxMarks, 0, header.boxSerial );
+
+	bool valid = CheckState( (const u8*)buffer, bodyMarks, boxMarks );
+
+	m_stack.Free( boxMarks );
+	m_stack.Free( bodyMarks );
+
+	if ( !valid )
+		return false;
+
+	const u8* bodyStates = cursor;
+	const u8* boxStates = bodyStates + header.bodyCount * sizeof( q3BodyRecord );
+	const u8* contactStates = boxStates + header.boxCount * sizeof( q3BoxRecord );
+
+	m_stack.Reserve( u32( lookupSize ) );
+	q3Body** bodies = (q3Body**)m_stack.Allocate( sizeof( q3Body* ) * bodySlots );
+	q3Box** boxes = (q3Box**)m_stack.Allocate( sizeof( q3Box* ) * boxSlots );
+	q3Body** loadedBodies = (q3Body**)m_stack.Allocate( sizeof( q3Body* ) * header.bodyCount );
+	q3Box** loadedBoxes = (q3Box**)m_stack.Allocate( sizeof( q3Box* ) * header.boxCount );
+	const u8** contactRecords = (const u8**)m_stack.Allocate( sizeof( const u8* ) * header.contactCount );
+	q3ContactConstraint** contacts = (q3ContactConstraint**)m_stack.Allocate( sizeof( q3ContactConstraint* ) * header.contactCount );
+
+	memset( bodies, 0, sizeof( q3Body* ) * bodySlots );
+	memset( boxes, 0, sizeof( q3Box* ) * boxSlots );
+
+	for ( q3Body* body = m_bodyList; body; body = body->m_next )
+	{
+		bodies[ body->m_serial ] = body;
+
+		for ( q3Box* box = body->m_boxes; box; box = box->next )
+			boxes[ box->serial ] = box;
+	}
+
+	const i32 typeFlags = q3Body::eStatic | q3Body::eDynamic | q3Body::eKinematic;
+
+	// Match up bodies and boxes with the ones that still exist and create
+	// the missing ones. Matches are cleared from the lookups, whatever is
+	// left in them afterwards was created after the save.
+	const u8* boxCursor = boxStates;
+	q3Box** bodyBoxes = loadedBoxes;
+
+	for ( i32 i = 0; i < header.bodyCount; ++i )
+	{
+		q3BodyRecord state;
+		q3ReadState( bodyStates, &state );
+
+		q3Body* body = bodies[ state.serial ];
+
+		if ( body && (body->m_flags & typeFlags) == (state.flags & typeFlags) )
+			bodies[ state.serial ] = NULL;
+
+		else
+		{
+			q3BodyDef def;
+
+			if ( state.flags & q3Body::eStatic )
+				def.bodyType = eStaticBody;
+
+			else if ( state.flags & q3Body::eKinematic )
+				def.bodyType = eKinematicBody;
+
+			else
+				def.bodyType = eDynamicBody;
+
+			body = CreateBody( def );
+			body->m_serial = state.serial;
+		}
+
+		loadedBodies[ i ] = body;
+
+		const u8* bodyBoxStates = boxCursor;
+
+		for ( i32 j = 0; j < state.boxCount; ++j )
+		{
+			q3BoxRecord boxState;
+			q3ReadState( boxCursor, &boxState );
+
+			q3Box* box = boxes[ boxState.serial ];
+			bodyBoxes[ j ] = NULL;
+
+			if ( box && box->body == body )
+			{
+				bodyBoxes[ j ] = box;
+				boxes[ boxState.serial ] = NULL;
+			}
+		}
+
+		q3Box* box = body->m_boxes;
+		while ( box )
+		{
+			q3Box* next = box->next;
+
+			if ( boxes[ box->serial ] == box )
+				body->RemoveBox( box );
+
+			box = next;
+		}
+
+		// Relink the box list in the saved order
+		body->m_boxes = NULL;
+
+		for ( i32 j = state.boxCount - 1; j >= 0; --j )
+		{
+			const u8* boxRecord = bodyBoxStates + j * sizeof( q3BoxRecord );
+			q3BoxRecord boxState;
+			q3ReadState( boxRecord, &boxState );
+
+			box = bodyBoxes[ j ];
+
+			if ( !box )
+			{
+				q3BoxDef def;
+				def.Set( q3LoadState( boxState.local ), boxState.e );
+				box = (q3Box*)body->AddBox( def );
+				bodyBoxes[ j ] = box;
+
+				// Linked again below
+				body->m_boxes = box->next;
+			}
+
+			box->local = q3LoadState( boxState.local );
+			box->e = boxState.e;
+			box->userData = boxState.userData;
+			box->friction = boxState.friction;
+			box->restitution = boxState.restitution;
+			box->density = boxState.density;
+			box->serial = boxState.serial;
+			box->sensor = boxState.sensor;
+			box->next = body->m_boxes;
+			body->m_boxes = box;
+
+			if ( memcmp( &broadPhase.GetFatAABB( box->broadPhaseIndex ), &boxState.fatAABB, sizeof( q3AABB ) ) )
+				broadPhase.SetFatAABB( box->broadPhaseIndex, boxState.fatAABB );
+		}
+
+		bodyBoxes += state.boxCount;
+	}
+
+	q3Body* body = m_bodyList;
+	while ( body )
+	{
+		q3Body* next = body->m_next;
+
+		if ( bodies[ body->m_serial ] == body )
+			RemoveBody( body );
+
+		body = next;
+	}
+
+	for ( i32 i = 0; i < header.boxCount; ++i )
+		boxes[ loadedBoxes[ i ]->serial ] = loadedBoxes[ i ];
+
+	// Contacts that still exist are kept, the others are dropped. Contact
+	// records vary in size.
+	const u8* moveStates = contactStates;
+	for ( i32 i = 0; i < header.contactCount; ++i )
+	{
+		const u8* record = moveStates;
+		q3ContactRecord state;
+		q3ReadState( record, &state );
+
+		const q3Box* A = boxes[ state.serialA ];
+		const q3Box* B = boxes[ state.serialB ];
+		q3ContactConstraint* contact = (q3ContactConstraint*)m_contactManager.m_pairTable.Find( A->broadPhaseIndex, B->broadPhaseIndex );
+
+		// The manifold is stored from A's side, a contact of the same pair
+		// created the other way round is replaced
+		if ( contact && contact->A != A )
+			contact = NULL;
+
+		if ( contact )
+			contact->m_flags |= q3ContactConstraint::eRestored;
+
+		contacts[ i ] = contact;
+		contactRecords[ i ] = moveStates;
+		moveStates += sizeof( q3ContactRecord ) + state.contactCount * sizeof( q3Contact );
+	}
+
+	q3ContactConstraint* contact = m_contactManager.m_contactList;
+	while ( contact )
+	{
+		q3ContactConstraint* next = contact->next;
+
+		if ( !(contact->m_flags & q3ContactConstraint::eRestored) )
+			m_contactManager.RemoveContact( contact );
+
+		contact = next;
+	}
+
+	m_contactManager.m_contactList = NULL;
+
+	for ( body = m_bodyList; body; body = body->m_next )
+		body->m_contactList = NULL;
+
+	// Contacts are pushed to the front of every list they join, so linking
+	// them back to front restores the order of the contact list and of
+	// each body's contact list
+	for ( i32 i = header.contactCount - 1; i >= 0; --i )
+	{
+		const u8* record = contactRecords[ i ];
+
+		q3ContactRecord state;
+		q3ReadState( record, &state );
+
+		contact = contacts[ i ];
+
+		if ( contact )
+			m_contactManager.LinkContact( contact );
+
+		else
+			contact = m_contactManager.CreateContact( boxes[ state.serialA ], boxes[ state.serialB ] );
+
+		q3Manifold& manifold = contact->manifold;
+		manifold.normal = state.normal;
+		manifold.tangentVectors[ 0 ] = state.tangentVectors[ 0 ];
+		manifold.tangentVectors[ 1 ] = state.tangentVectors[ 1 ];
+		manifold.cacheRotation = q3LoadState( state.cacheRotation );
+		manifold.cacheTranslation = state.cacheTranslation;
+		manifold.cacheNormal = state.cacheNormal;
+		manifold.contactCount = state.contactCount;
+		manifold.cacheAxis = state.cacheAxis;
+		manifold.cacheCount = state.cacheCount;
+		manifold.sensor = state.sensor != 0;
+		memcpy( manifold.contacts, record, state.contactCount * sizeof( q3Contact ) );
+
+		contact->friction = state.friction;
+		contact->restitution = state.restitution;
+		contact->m_flags = state.flags;
+	}
+
+	// Body state goes last, creating and removing contacts wakes bodies up
+	bodyStates = cursor;
+	m_bodyList = NULL;
+	m_transformCount = 0;
+	q3Body* last = NULL;
+
+	for ( i32 i = 0; i < header.bodyCount; ++i )
+	{
+		q3BodyRecord state;
+		q3ReadState( bodyStates, &state );
+
+		body = loadedBodies[ i ];
+		body->m_invInertiaModel = q3LoadState( state.invInertiaModel );
+		body->m_invInertiaWorld = q3LoadState( state.invInertiaWorld );
+		body->m_boxInertia = q3LoadState( state.boxInertia );
+		body->m_tx = q3LoadState( state.tx );
+		body->m_q = state.q;
+		body->m_prevTx = body->m_tx;
+		body->m_prevQ = state.q;
+		body->m_linearVelocity = state.linearVelocity;
+		body->m_angularVelocity = state.angularVelocity;
+		body->m_force = state.force;
+		body->m_torque = state.torque;
+		body->m_localCenter = state.localCenter;
+		body->m_worldCenter = state.worldCenter;
+		body->m_boxMoment = state.boxMoment;
+		body->m_userData = state.userData;
+		body->m_mass = state.mass;
+		body->m_invMass = state.invMass;
+		body->m_boxMass = state.boxMass;
+		body->m_massRemovals = state.massRemovals;
+		body->m_sleepTime = state.sleepTime;
+		body->m_gravityScale = state.gravityScale;
+		body->m_linearDamping = state.linearDamping;
+		body->m_angularDamping = state.angularDamping;
+		body->m_layers = state.layers;
+		body->m_flags = state.flags;
+
+		// Saved before its proxies caught up with SetTransforms
+		if ( body->m_flags & q3Body::eUnsynced )
+			AddUnsynced( body );
+
+		body->m_prev = last;
+		body->m_next = NULL;
+
+		if ( last )
+			last->m_next = body;
+
+		else
+			m_bodyList = body;
+
+		last = body;
+	}
+
+	m_bodyCount = header.bodyCount;
+
+	broadPhase.m_moveCount = 0;
+	for ( i32 i = 0; i < header.moveCount; ++i )
+	{
+		i32 serial;
+		q3ReadState( moveStates, &serial );
+		broadPhase.BufferMove( boxes[ serial ]->broadPhaseIndex );
+	}
+
+	// Islands are built again in the saved order, contacts were given the
+	// island flag of their record
+	q3IslandGraph& graph = m_contactManager.m_islandGraph;
+	graph.Clear( );
+
+	for ( i32 i = 0; i < header.bodyCount; ++i )
+		bodies[ loadedBodies[ i ]->m_serial ] = loadedBodies[ i ];
+
+	for ( i32 i = 0; i < header.islandCount; ++i )
+	{
+		q3IslandRecord state;
+		q3ReadState( moveStates, &state );
+
+		q3IslandGroup* island = graph.CreateIsland( );
+		island->removedCount = state.removedCount;
+
+		for ( i32 j = 0; j < state.bodyCount; ++j )
+		{
+			i32 serial;
+			q3ReadState( moveStates, &serial );
+			graph.AddToIsland( island, bodies[ serial ] );
+		}
+
+		for ( i32 j = 0; j < state.contactCount; ++j )
+		{
+			i32 serialA;
+			i32 serialB;
+			q3ReadState( moveStates, &serialA );
+			q3ReadState( moveStates, &serialB );
+
+			contact = (q3ContactConstraint*)m_contactManager.m_pairTable.Find( boxes[ serialA ]->broadPhaseIndex, boxes[ serialB ]->broadPhaseIndex );
+
+			// Only a state that was tampered with lists a pair without a contact
+			if ( contact )
+				graph.AddToIsland( island, contact );
+		}
+	}
+
+	m_bodySerial = header.bodySerial;
+	m_boxSerial = header.boxSerial;
+	m_newBox = header.newBox != 0;
+
+	m_stack.Free( contacts );
+	m_stack.Free( contactRecords );
+	m_stack.Free( loadedBoxes );
+	m_stack.Free( loadedBodies );
+	m_stack.Free( boxes );
+	m_stack.Free( bodies );
+
+	return true;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -445,6 +2001,13 @@ void q3Scene::Dump( FILE* file ) const
 	fprintf( file, "scene.SetGravity( q3Vec3( %.15lf, %.15lf, %.15lf ) );\n", m_gravity.x, m_gravity.y, m_gravity.z );
 	fprintf( file, "scene.SetAllowSleep( %s );\n", m_allowSleep ? "true" : "false" );
 	fprintf( file, "scene.SetEnableFriction( %s );\n", m_enableFriction ? "true" : "false" );
+	fprintf( file, "scene.SetIterations( %d );\n", m_iterations );
+	fprintf( file, "scene.SetAdaptiveIterations( %d, %.15lf );\n", m_minIterations, m_iterationTolerance );
+	fprintf( file, "scene.SetRelaxation( %.15lf );\n", m_relaxation );
+	fprintf( file, "scene.SetEnableSIMD( %s );\n", m_enableSIMD ? "true" : "false" );
+	fprintf( file, "scene.SetDeterministic( %s );\n", m_deterministic ? "true" : "false" );
+	fprintf( file, "scene.SetQuerySnapshots( %s );\n", m_querySnapshots ? "true" : "false" );
+	fprintf( file, "scene.SetMaxSubSteps( %d );\n", m_maxSubSteps );
 
 	fprintf( file, "q3Body** bodies = (q3Body**)q3Alloc( sizeof( q3Body* ) * %d );\n", m_bodyCount );
 
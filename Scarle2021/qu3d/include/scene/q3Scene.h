@@ -7,6 +7,8 @@
 
 	Copyright (c) 2014 Randy Gaul http://www.randygaul.net
 
+	Altered for the Scarle2021 fork of qu3e, this is not the original source.
+
 	This software is provided 'as-is', without any express or implied
 	warranty. In no event will the authors be held liable for any damages
 	arising from the use of this software.
@@ -41,6 +43,7 @@ struct q3BodyDef;
 struct q3ContactConstraint;
 class q3Render;
 struct q3Island;
+class q3ThreadPool;
 
 // This listener is used to gather information about two shapes colliding. This
 // can be used for game logic and sounds. Physics objects created in these
@@ -72,16 +75,95 @@ public:
 	virtual bool ReportShape( q3Box *box ) = 0;
 };
 
+// One result of q3Scene::QueryAABBs, box overlaps aabbs[ queryIndex ]
+struct q3QueryHit
+{
+	i32 queryIndex;
+	q3Box *box;
+};
+
+// Island counts of the last q3Scene::Step, see q3Scene::GetIslandStats
+struct q3IslandStats
+{
+	i32 islandCount;	// Islands in the scene, awake or asleep
+	i32 rebuiltCount;	// Solved islands that were merged or split since last solved
+	i32 reusedCount;	// Solved islands carried over as they were
+	i32 splitCount;		// Islands searched for parts that came apart, at most one
+};
+
+// Phase timings in milliseconds and counts of the last q3Scene::Step, see
+// q3Scene::GetStepStats
+struct q3StepStats
+{
+	r32 updatePairs;		// Pairs for boxes added since the last step
+	r32 testCollisions;		// Narrowphase of the existing contacts
+	r32 islandBuild;		// Gathering awake islands and their contact states
+	r32 islandSolve;		// Solver and integration
+	r32 synchronizeProxies;	// Broadphase bounds of the bodies that moved
+	r32 islandSplit;		// Splitting an island that came apart
+	r32 findNewContacts;	// Pairs for boxes that moved
+	r32 total;				// The whole step
+	i32 pairCount;			// Pairs reported by the broadphase, duplicates included
+	i32 contactCount;		// Contacts held by the scene after the step
+	i32 solvedContactCount;	// Touching contacts in the solved islands
+	i32 islandCount;		// Islands solved
+	i32 iterations;			// Solver iterations run, summed over the solved islands
+	i32 treeVisits;			// Broadphase index nodes visited looking for pairs
+};
+
+// Up front sizes of the per step memory, see q3Scene::SetFrameArena
+struct q3FrameArenaDef
+{
+	i32 bytes;			// Scratch for islands, solver states and contact lists
+	i32 pairCapacity;	// Broadphase pairs found by one pair update
+	i32 moveCapacity;	// Boxes moved between two pair updates
+};
+
+// See q3Scene::GetFrameArenaStats
+struct q3FrameArenaStats
+{
+	q3FrameArenaDef capacity;	// Currently reserved
+	q3FrameArenaDef peak;		// Largest use since SetFrameArena
+	i32 overflowCount;			// Times any of them had to grow since SetFrameArena
+};
+
+// Scenes share no mutable global state. Everything a scene uses lives in the
+// scene, its bodies and its own thread pool, and memory comes from malloc,
+// so separate scenes can be built and stepped on separate threads at the
+// same time, see q3ScenePool. A scene and its bodies must only be used by
+// one thread at a time. A deterministic Step only changes the floating point
+// state of the thread running it, and restores it before returning.
 class q3Scene
 {
 public:
-	q3Scene( r32 dt, const q3Vec3& gravity = q3Vec3( r32( 0.0 ), r32( -9.8 ), r32( 0.0 ) ), i32 iterations = 20 );
+	// broadPhase picks the spatial structure used to find overlapping boxes,
+	// see q3ProxyIndex. All of them find the same pairs and query hits.
+	q3Scene( r32 dt, const q3Vec3& gravity = q3Vec3( r32( 0.0 ), r32( -9.8 ), r32( 0.0 ) ), i32 iterations = 20,
+		q3BroadPhaseType broadPhase = eBroadPhaseTree );
 	~q3Scene( );
 
 	// Run the simulation forward in time by dt (fixed timestep). Variable
 	// timestep is not supported.
 	void Step( );
 
+	// Adds realDt, the real time since the last call, to an accumulator and
+	// runs as many fixed steps of dt as it holds. Frame time the steps did
+	// not use carries over to the next call, so the simulation keeps pace
+	// with real time whatever the frame rate. Returns the number of steps
+	// taken, never more than the sub step cap. Time owed beyond the cap is
+	// dropped: a long stall slows the simulation down rather than making
+	// the following frames take even longer to catch up.
+	i32 Advance( r32 realDt );
+
+	// Fraction of a step left in the accumulator after Advance, in [0, 1].
+	// Draw bodies at their previous transform blended towards the current
+	// one by this amount, see q3Body::GetPreviousTransform.
+	r32 GetInterpolationAlpha( ) const;
+
+	// Most steps a single Advance call may take. The default is 4,
+	// non-positive inputs set the cap to one.
+	void SetMaxSubSteps( i32 maxSubSteps );
+
 	// Construct a new rigid body. The BodyDef can be reused at the user's
 	// discretion, as no reference to the BodyDef is kept.
 	q3Body* CreateBody( const q3BodyDef& def );
@@ -91,6 +173,16 @@ public:
 	void RemoveBody( q3Body* body );
 	void RemoveAllBodies( );
 
+	// Moves count bodies like q3Body::SetTransform, but their broadphase
+	// proxies are brought up to date together at the start of the next
+	// Step, or by SynchronizeTransforms. Each box AABB is then computed
+	// once however often its body moved, and the tree is refit in a
+	// single pass. Positions are body origins as in q3Body::GetTransform,
+	// rotations must be orthonormal. Until then queries and raycasts see
+	// the boxes where they were.
+	void SetTransforms( q3Body** bodies, const q3Transform* transforms, i32 count );
+	void SynchronizeTransforms( );
+
 	// Enables or disables rigid body sleeping. Sleeping is an effective CPU
 	// optimization where bodies are put to sleep if they don't move much.
 	// Sleeping bodies sit in memory without being updated, until the are
@@ -104,10 +196,69 @@ public:
 	// inputs set the iteration count to 1.
 	void SetIterations( i32 iterations );
 
+	// Lets islands stop iterating early once they have converged. After
+	// minIterations, an island stops as soon as an iteration changes no
+	// contact's relative velocity by tolerance (m/s) or more, with the
+	// count set by SetIterations as the upper bound. Resting stacks then
+	// finish in a few iterations while crashes still get all of them.
+	// Results stay identical across thread counts and SIMD. A tolerance
+	// of zero, the default, always runs every iteration.
+	void SetAdaptiveIterations( i32 minIterations, r32 tolerance );
+
+	// Successive over-relaxation factor applied to every impulse change.
+	// Values above one can converge in fewer iterations, values below one
+	// damp jittery stacks. Clamped to [0.1, 1.9], the default is 1.
+	void SetRelaxation( r32 relaxation );
+
+	// Islands never share dynamic bodies or contacts, so they can be solved
+	// at the same time. A thread count above one solves islands on a pool
+	// of worker threads (the calling thread counts as one of them). The
+	// narrowphase runs on the same pool, contact listener events are still
+	// reported from the calling thread in a fixed order. The results are
+	// bit-identical to the single threaded path. The default
+	// is one, and non-positive inputs also set the thread count to one.
+	void SetThreadCount( i32 threadCount );
+	i32 GetThreadCount( ) const;
+
+	// A single island gains nothing from the above, e.g. a vehicle resting
+	// on the ground. Islands with at least this many contact constraints
+	// are solved one after the other, with the constraints of each island
+	// spread over the thread pool. Constraints are grouped so that no two
+	// running at once share a dynamic body, and results stay bit-identical.
+	// Constraints that all touch the same dynamic body cannot be spread.
+	// Smaller islands are solved serially, several islands at once. The
+	// default is 128, non-positive inputs set the threshold to one.
+	void SetParallelSolveThreshold( i32 contactCount );
+
 	// Friction occurs when two rigid bodies have shapes that slide along one
 	// another. The friction force resists this sliding motion.
 	void SetEnableFriction( bool enabled );
 
+	// Solves contact constraints that share no dynamic body four at a time
+	// with SSE2. Each body still sees its constraints in the same order,
+	// so the result matches the scalar solver bit for bit. Has no effect
+	// on targets without SSE2. Enabled by default.
+	void SetEnableSIMD( bool enabled );
+
+	// Thread count and SIMD already leave the results unchanged. Two more
+	// things can still make the same scene diverge between runs or machines:
+	// the order the broadphase reports new pairs in, which depends on the
+	// broadphase type and on proxy ids reused after removals, and the
+	// floating point state of the calling thread (rounding, flush-to-zero)
+	// which host code may have changed. Deterministic mode creates the new
+	// contacts of a step sorted by the creation order of their boxes, the
+	// earlier created box first, and runs each step with the default
+	// floating point state, restoring the caller's state afterwards. Bodies
+	// and the boxes of a body are always visited in a fixed order (reverse
+	// creation order) and no hashed container is ever iterated. Disabled by
+	// default.
+	void SetDeterministic( bool enabled );
+
+	// 64-bit FNV-1a hash of the position, orientation and velocities of
+	// every body, in body list order. Two runs that agree on this after
+	// each step simulated the same thing bit for bit.
+	u64 ComputeStateHash( ) const;
+
 	// Render the scene with an interpolated time between the last frame and
 	// the current simulation step.
 	void Render( q3Render* render ) const;
@@ -134,12 +285,77 @@ public:
 	// user might use lmDistance as fine-grained collision detection.
 	void QueryAABB( q3QueryCallback *cb, const q3AABB& aabb ) const;
 
+	// Batched QueryAABB for count AABBs at once. The broadphase is walked a
+	// single time for the whole batch, and every ( queryIndex, box ) pair
+	// that passes the same test as QueryAABB is written to hits without any
+	// callbacks. The query stops once hitCapacity hits were written. Returns
+	// the number of hits written. Hits are not sorted by queryIndex.
+	i32 QueryAABBs( const q3AABB *aabbs, i32 count, q3QueryHit *hits, i32 hitCapacity ) const;
+
+	// Count-only variant of QueryAABBs. counts[ i ] receives the number of
+	// boxes overlapping aabbs[ i ], counting stops for an entry once it
+	// reaches limit. The walk ends early when every entry reached limit.
+	void CountAABBs( const q3AABB *aabbs, i32 count, i32 *counts, i32 limit ) const;
+
 	// Query the world to find any shapes intersecting a world space point.
 	void QueryPoint( q3QueryCallback *cb, const q3Vec3& point ) const;
 
 	// Query the world to find any shapes intersecting a ray.
 	void RayCast( q3QueryCallback *cb, q3RaycastData& rayCast ) const;
 
+	// Number of boxes held by the static and dynamic broadphase indices.
+	// Boxes of static bodies live in the static index, which is never
+	// queried against itself.
+	i32 GetStaticProxyCount( ) const;
+	i32 GetDynamicProxyCount( ) const;
+
+	// Rebuilds the broadphase from the boxes currently in the scene. Adding
+	// boxes one at a time, e.g. while loading a level, leaves the tree in a
+	// shape that depends on the order they came in. Call this once loading
+	// is done. It costs about as much as inserting every box again.
+	void RebuildBroadPhase( );
+
+	// Keeps a compact, read-only copy of each broadphase tree for queries
+	// and raycasts, updated at the end of Step and by RebuildBroadPhase. A
+	// copy is used only while its tree is unchanged, so it mostly helps the
+	// static tree and scenes that are queried far more often than boxes
+	// move. Results are the same with it on or off. Off by default.
+	void SetQuerySnapshots( bool enabled );
+
+	// Average number of broadphase nodes a box visits when looking for
+	// overlaps, lower is better. Compare before and after a rebuild.
+	r32 GetBroadPhaseQueryVisits( ) const;
+
+	// Memory held by the scene's body, box, contact and island pools.
+	// Bodies, boxes and contacts come from fixed size pools that chain on
+	// new pages as needed. The peak is the sum of the peaks of each
+	// allocator, so it can overestimate the true combined peak.
+	void GetMemoryStats( q3MemoryStats* stats ) const;
+
+	// By default the per step scratch is reallocated whenever a step needs
+	// more than any step before. A frame arena reserves it once instead:
+	// steps carve their temporaries out of it and reset it at the end.
+	// Anything that does not fit grows the arena and counts as an
+	// overflow, so once the sizes cover the scene's high-water mark steps
+	// allocate nothing. Run a scene and read the peaks from
+	// GetFrameArenaStats to pick the sizes. Zero bytes turns the arena off.
+	void SetFrameArena( const q3FrameArenaDef& def );
+	void GetFrameArenaStats( q3FrameArenaStats* stats ) const;
+
+	// Islands are kept from step to step instead of being searched for
+	// again every step. Contacts that start touching merge islands right
+	// away. Islands that lost a contact are only split once part of them
+	// has come to rest, so that part can sleep, and only one island is
+	// split per step. With sleeping disabled
+	// they are never split, which costs parallelism but not accuracy.
+	// Sleeping islands are not visited by Step at all.
+	void GetIslandStats( q3IslandStats* stats ) const;
+
+	// Where the time of the last step went. Timers cost a few clock reads
+	// per step. Building with Q3_NO_PROFILE compiles them and the counters
+	// out of Step, and the stats then read as zero.
+	void GetStepStats( q3StepStats* stats ) const;
+
 	// Dump all rigid bodies and shapes into a log file. The log can be
 	// used as C++ code to re-create an initial scene setup. Contacts
 	// are *not* logged, meaning any cached resolution solutions will
@@ -148,23 +364,70 @@ public:
 	// simulation.
 	void Dump( FILE* file ) const;
 
+	// Binary checkpoint of everything a step depends on: bodies, boxes and
+	// their broadphase bounds, contacts with their warm start impulses and
+	// sleep state. Unlike Dump this is a flat copy meant to be taken and
+	// restored every frame, e.g. to reset a vehicle or rewind an edit.
+	// buffer must hold GetStateSize( ) bytes. Returns the bytes written.
+	// Listeners and settings such as gravity are not part of the state.
+	// Do not save while a body is in a shape edit.
+	i32 GetStateSize( ) const;
+	i32 SaveState( void* buffer ) const;
+
+	// Puts the scene back into the state saved in buffer. Bodies and boxes
+	// that still exist are updated in place, so pointers to them stay
+	// valid. Anything created after the save is removed, and anything
+	// removed since comes back as a new object with the saved user data.
+	// No contact listener events are reported. In deterministic mode the
+	// steps that follow match the steps that followed the save bit for
+	// bit. size is the number of bytes in buffer. Returns false, leaving
+	// the scene untouched, if buffer does not hold a complete scene state.
+	bool LoadState( const void* buffer, i32 size );
+
 private:
 	q3ContactManager m_contactManager;
 	q3PagedAllocator m_boxAllocator;
+	q3PagedAllocator m_bodyAllocator;
 
 	i32 m_bodyCount;
 	q3Body* m_bodyList;
 
 	q3Stack m_stack;
-	q3Heap m_heap;
+
+	// Bodies moved by SetTransforms whose proxies are not updated yet
+	q3Body** m_transformBodies;
+	i32 m_transformCount;
+	i32 m_transformCapacity;
 
 	q3Vec3 m_gravity;
 	r32 m_dt;
+	r32 m_accumulator;
 	i32 m_iterations;
+	i32 m_minIterations;
+	r32 m_iterationTolerance;
+	r32 m_relaxation;
+	i32 m_maxSubSteps;
 
 	bool m_newBox;
 	bool m_allowSleep;
 	bool m_enableFriction;
+	bool m_enableSIMD;
+	bool m_deterministic;
+	bool m_querySnapshots;
+	i32 m_bodySerial;
+	i32 m_boxSerial;
+
+	q3ThreadPool* m_threadPool;
+	i32 m_parallelSolveThreshold;
+
+	// Only filled in when Q3_PROFILE is defined, but always present so the
+	// layout does not depend on it
+	q3StepStats m_stepStats;
+
+	void AddUnsynced( q3Body* body );
+
+	// Walks a state buffer for LoadState without touching the scene
+	static bool CheckState( const u8* buffer, u8* bodyMarks, u8* boxMarks );
 
 	friend class q3Body;
 };
@@ -0,0 +1,167 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3ScenePool.cpp
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#include <chrono>
+#include <string.h>
+
+#include "q3ScenePool.h"
+
+//--------------------------------------------------------------------------------------------------
+// q3ScenePool
+//--------------------------------------------------------------------------------------------------
+q3ScenePool::q3ScenePool( i32 threadCount )
+	: m_threadPool( threadCount )
+	, m_scenes( NULL )
+	, m_stats( NULL )
+	, m_count( 0 )
+	, m_capacity( 0 )
+	, m_steps( 0 )
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+q3ScenePool::~q3ScenePool( )
+{
+	q3Free( m_scenes );
+	q3Free( m_stats );
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3ScenePool::Add( q3Scene* scene )
+{
+	for ( i32 i = 0; i < m_count; ++i )
+	{
+		// Stepping a scene twice at once would race
+		assert( m_scenes[ i ] != scene );
+	}
+
+	if ( m_count == m_capacity )
+	{
+		m_capacity = m_capacity ? m_capacity * 2 : 16;
+
+		q3Scene** scenes = (q3Scene**)q3Alloc( sizeof( q3Scene* ) * m_capacity );
+		q3ScenePoolStats* stats = (q3ScenePoolStats*)q3Alloc( sizeof( q3ScenePoolStats ) * m_capacity );
+
+		if ( m_count )
+		{
+			memcpy( scenes, m_scenes, sizeof( q3Scene* ) * m_count );
+			memcpy( stats, m_stats, sizeof( q3ScenePoolStats ) * m_count );
+		}
+
+		q3Free( m_scenes );
+		q3Free( m_stats );
+		m_scenes = scenes;
+		m_stats = stats;
+	}
+
+	m_scenes[ m_count ] = scene;
+	memset( m_stats + m_count, 0, sizeof( q3ScenePoolStats ) );
+
+	return m_count++;
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ScenePool::Remove( q3Scene* scene )
+{
+	for ( i32 i = 0; i < m_count; ++i )
+	{
+		if ( m_scenes[ i ] != scene )
+			continue;
+
+		i32 after = m_count - i - 1;
+		memmove( m_scenes + i, m_scenes + i + 1, sizeof( q3Scene* ) * after );
+		memmove( m_stats + i, m_stats + i + 1, sizeof( q3ScenePoolStats ) * after );
+		--m_count;
+		return;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ScenePool::RemoveAll( )
+{
+	m_count = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3ScenePool::GetSceneCount( ) const
+{
+	return m_count;
+}
+
+//--------------------------------------------------------------------------------------------------
+q3Scene* q3ScenePool::GetScene( i32 index ) const
+{
+	assert( index >= 0 && index < m_count );
+
+	return m_scenes[ index ];
+}
+
+//--------------------------------------------------------------------------------------------------
+const q3ScenePoolStats& q3ScenePool::GetStats( i32 index ) const
+{
+	assert( index >= 0 && index < m_count );
+
+	return m_stats[ index ];
+}
+
+//--------------------------------------------------------------------------------------------------
+i32 q3ScenePool::GetThreadCount( ) const
+{
+	return m_threadPool.GetThreadCount( );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ScenePool::Step( i32 steps )
+{
+	if ( steps <= 0 )
+		return;
+
+	// Scenes are handed out one at a time, so threads that drew cheap
+	// scenes move on to the next ones instead of waiting
+	m_steps = steps;
+	m_threadPool.ParallelFor( StepTask, this, m_count );
+}
+
+//--------------------------------------------------------------------------------------------------
+void q3ScenePool::StepTask( void* param, i32 index )
+{
+	typedef std::chrono::steady_clock clock;
+
+	q3ScenePool* pool = (q3ScenePool*)param;
+	q3Scene* scene = pool->m_scenes[ index ];
+	q3ScenePoolStats* stats = pool->m_stats + index;
+
+	clock::time_point start = clock::now( );
+
+	for ( i32 i = 0; i < pool->m_steps; ++i )
+		scene->Step( );
+
+	stats->milliseconds = std::chrono::duration<r32, std::milli>( clock::now( ) - start ).count( );
+	stats->stepCount += pool->m_steps;
+	scene->GetStepStats( &stats->lastStep );
+}
@@ -0,0 +1,87 @@
+//--------------------------------------------------------------------------------------------------
+/**
+@file	q3ScenePool.h
+
+@author	Scarle2021 contributors
+
+	Written for the Scarle2021 fork of qu3e, this file is not part of the
+	original qu3e by Randy Gaul. It is distributed under the same license.
+
+	Copyright (c) the Scarle2021 contributors
+
+	This software is provided 'as-is', without any express or implied
+	warranty. In no event will the authors be held liable for any damages
+	arising from the use of this software.
+
+	Permission is granted to anyone to use this software for any purpose,
+	including commercial applications, and to alter it and redistribute it
+	freely, subject to the following restrictions:
+	  1. The origin of this software must not be misrepresented; you must not
+	     claim that you wrote the original software. If you use this software
+	     in a product, an acknowledgment in the product documentation would be
+	     appreciated but is not required.
+	  2. Altered source versions must be plainly marked as such, and must not
+	     be misrepresented as being the original software.
+	  3. This notice may not be removed or altered from any source distribution.
+*/
+//--------------------------------------------------------------------------------------------------
+
+#ifndef Q3SCENEPOOL_H
+#define Q3SCENEPOOL_H
+
+#include "q3Scene.h"
+#include "../common/q3ThreadPool.h"
+
+//--------------------------------------------------------------------------------------------------
+// q3ScenePool
+//--------------------------------------------------------------------------------------------------
+// Results of one scene in the last q3ScenePool::Step
+struct q3ScenePoolStats
+{
+	q3StepStats lastStep;	// q3Scene::GetStepStats after the scene's last step
+	r32 milliseconds;		// Wall time of all the scene's steps in the call
+	i32 stepCount;			// Steps taken through the pool since the scene was added
+};
+
+// Steps many independent scenes at once, e.g. to score a batch of vehicle
+// designs. Scenes share no mutable state, so each one is stepped start to
+// finish by whichever pool thread picks it up, and a scene gives the same
+// results as stepping it on its own. The pool does not own the scenes.
+// Scenes should keep their own thread count at one, the pool already keeps
+// every thread busy. Contact listeners are called from the thread stepping
+// their scene.
+class q3ScenePool
+{
+public:
+	// The calling thread counts as one of the threads
+	q3ScenePool( i32 threadCount );
+	~q3ScenePool( );
+
+	// Returns the scene's index. Removing a scene moves the ones added
+	// after it down by one.
+	i32 Add( q3Scene* scene );
+	void Remove( q3Scene* scene );
+	void RemoveAll( );
+
+	i32 GetSceneCount( ) const;
+	q3Scene* GetScene( i32 index ) const;
+	const q3ScenePoolStats& GetStats( i32 index ) const;
+	i32 GetThreadCount( ) const;
+
+	// Steps every scene steps times and returns once all are done. No scene
+	// may be touched by another thread until then.
+	void Step( i32 steps = 1 );
+
+private:
+	static void StepTask( void* param, i32 index );
+
+	q3ThreadPool m_threadPool;
+
+	q3Scene** m_scenes;
+	q3ScenePoolStats* m_stats;
+	i32 m_count;
+	i32 m_capacity;
+	i32 m_steps;	// Of the Step in progress
+};
+
+#endif // Q3SCENEPOOL_H